@@ -0,0 +1,170 @@
+/* mmap(), madvise() and posix_memalign() aren't C90, mremap() is Linux */
+#define _GNU_SOURCE
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+#include "../../../ADTs/General/general.h"
+
+/* The three heap_allocator functions */
+static void* heap_alloc(void* ctx, size_t bytes);
+static void* heap_realloc(void* ctx, void* p, size_t old_bytes,
+                          size_t new_bytes);
+static void heap_free(void* ctx, void* p, size_t bytes);
+
+/* Rounds 'bytes' up to a whole number of huge pages */
+static size_t huge_round(size_t bytes);
+
+/* Maps a huge page aligned block, asking for huge pages */
+static void* huge_alloc(size_t bytes);
+
+const assoc_allocator heap_allocator = {
+    heap_alloc, heap_realloc, heap_free, NULL
+};
+
+void* mem_alloc(const assoc_allocator* al, size_t bytes)
+{
+    return al->alloc(al->ctx, bytes);
+}
+
+void* mem_realloc(const assoc_allocator* al, void* p,
+                  size_t old_bytes, size_t new_bytes)
+{
+    return al->realloc(al->ctx, p, old_bytes, new_bytes);
+}
+
+void mem_free(const assoc_allocator* al, void* p, size_t bytes)
+{
+    al->free(al->ctx, p, bytes);
+}
+
+char* mem_strdup(const assoc_allocator* al, const char* original)
+{
+    char *clone;
+    size_t length;
+
+    length = strlen(original) + 1;
+    clone = mem_alloc(al, length);
+    memcpy(clone, original, length);
+    return clone;
+}
+/*
+   Small blocks (cloned keys etc.) come straight from
+   ncalloc(), only arrays pay for cache line alignment.
+*/
+static void* heap_alloc(void* ctx, size_t bytes)
+{
+    void *p;
+
+    (void) ctx;
+    if(bytes >= HUGETHRESHOLD){
+        return huge_alloc(bytes);
+    }
+    if(bytes < CACHELINE){
+        return ncalloc(1, bytes);
+    }
+    if(posix_memalign(&p, CACHELINE, bytes) != 0){
+        on_error("Cannot allocate aligned space");
+    }
+    memset(p, 0, bytes);
+    return p;
+}
+
+/*
+   Huge blocks are mappings, so mremap() can grow them by
+   moving page table entries rather than copying: the new
+   pages come zeroed, and the old and new copies never exist
+   side by side. The result may lose its huge page alignment.
+   Smaller blocks go to realloc(), which grows them where
+   they are when it can; if it moves an array off a cache
+   line boundary, it's copied once more to an aligned block.
+   Only a block crossing HUGETHRESHOLD is always copied.
+*/
+static void* heap_realloc(void* ctx, void* p, size_t old_bytes,
+                          size_t new_bytes)
+{
+    void *n;
+
+#ifdef MREMAP_MAYMOVE
+    if(old_bytes >= HUGETHRESHOLD && new_bytes >= HUGETHRESHOLD){
+        n = mremap(p, huge_round(old_bytes), huge_round(new_bytes),
+                   MREMAP_MAYMOVE);
+        if(n == MAP_FAILED){
+            on_error("Cannot mremap() space");
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(n, huge_round(new_bytes), MADV_HUGEPAGE);
+#endif
+        return n;
+    }
+#endif
+    if(old_bytes < HUGETHRESHOLD && new_bytes < HUGETHRESHOLD){
+        p = realloc(p, new_bytes ? new_bytes : 1);
+        if(p == NULL){
+            on_error("Cannot realloc() space");
+        }
+        if(new_bytes > old_bytes){
+            memset((char *) p + old_bytes, 0, new_bytes - old_bytes);
+        }
+        if(new_bytes < CACHELINE ||
+           ((unsigned long) p & (CACHELINE - 1)) == 0){
+            return p;
+        }
+        old_bytes = new_bytes;
+    }
+    n = heap_alloc(ctx, new_bytes);
+    memcpy(n, p, old_bytes < new_bytes ? old_bytes : new_bytes);
+    heap_free(ctx, p, old_bytes);
+    return n;
+}
+
+static void heap_free(void* ctx, void* p, size_t bytes)
+{
+    (void) ctx;
+    if(bytes >= HUGETHRESHOLD){
+        munmap(p, huge_round(bytes));
+    }
+    else{
+        free(p);
+    }
+}
+
+static size_t huge_round(size_t bytes)
+{
+    return (bytes + HUGEPAGE - 1) & ~(HUGEPAGE - 1);
+}
+/*
+   Anonymous mappings are already zeroed. Map one huge page
+   too many and trim both ends, so the block starts on a
+   huge page boundary. If huge pages are disabled madvise()
+   fails and we simply keep the ordinary pages.
+*/
+static void* huge_alloc(size_t bytes)
+{
+    char *raw, *aligned;
+    size_t size, head, tail;
+
+    size = huge_round(bytes);
+    raw = mmap(NULL, size + HUGEPAGE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED){
+        on_error("Cannot mmap() space");
+    }
+    aligned = (char *) (((unsigned long) raw + HUGEPAGE - 1) &
+                        ~(HUGEPAGE - 1));
+    head = aligned - raw;
+    tail = HUGEPAGE - head;
+    if(head > 0){
+        munmap(raw, head);
+    }
+    if(tail > 0){
+        munmap(aligned + size, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
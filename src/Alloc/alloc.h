@@ -0,0 +1,61 @@
+/*
+   Where the tables get their memory from. Everything a
+   table allocates (the table itself, its slot arrays, cloned
+   keys, filters and resize buffers) goes through an
+   assoc_allocator, so a table can live in a pool, an arena
+   or any other heap the caller likes.
+
+   The default, heap_allocator, zeroes every block and aligns
+   blocks of a cache line or more to a cache line; blocks of
+   at least HUGETHRESHOLD bytes are mapped directly and backed
+   by transparent huge pages where the kernel allows it, to cut
+   TLB misses on very large tables. Its realloc zeroes any new
+   bytes too, and grows a block where it is when it can: huge
+   ones by mremap(), smaller ones by realloc(). A block that
+   grows past HUGETHRESHOLD, or that realloc() moves off a
+   cache line boundary, is copied, so old and new coexist.
+*/
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdlib.h>
+
+/* Size of a cache line */
+#define CACHELINE 64
+/* Size of a (transparent) huge page on x86-64 */
+#define HUGEPAGE (1UL << 21)
+/* Blocks this big or bigger are mmap()'d */
+#define HUGETHRESHOLD HUGEPAGE
+
+/*
+   alloc   : zeroed block of 'bytes' bytes, aligned for any type
+   realloc : grows/shrinks 'p', keeping the first old bytes
+             (any new bytes are not necessarily zeroed)
+   free    : 'bytes' is the size the block was allocated with
+   ctx     : passed back as the first argument of each call
+   None of them may return NULL.
+*/
+typedef struct assoc_allocator {
+
+    void* (*alloc)(void* ctx, size_t bytes);
+    void* (*realloc)(void* ctx, void* p, size_t old_bytes,
+                     size_t new_bytes);
+    void (*free)(void* ctx, void* p, size_t bytes);
+    void *ctx;
+
+} assoc_allocator;
+
+/* Plain heap, with the huge page handling described above */
+extern const assoc_allocator heap_allocator;
+
+/* Shorthands for calling through an allocator */
+void* mem_alloc(const assoc_allocator* al, size_t bytes);
+void* mem_realloc(const assoc_allocator* al, void* p,
+                  size_t old_bytes, size_t new_bytes);
+void mem_free(const assoc_allocator* al, void* p, size_t bytes);
+
+/* A copy of the string 'original', freed as strlen() + 1 bytes */
+char* mem_strdup(const assoc_allocator* al, const char* original);
+
+#endif
@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "arena.h"
+#include "../../../ADTs/General/general.h"
+
+/* Small blocks are aligned to this, large ones to a cache line */
+#define ARENAALIGN 16
+
+/* The three allocator functions */
+static void* arena_alloc(void* ctx, size_t bytes);
+static void* arena_realloc(void* ctx, void* p, size_t old_bytes,
+                           size_t new_bytes);
+static void arena_release(void* ctx, void* p, size_t bytes);
+
+/* Start of the usable space in 'chunk' */
+static char* chunk_base(arena_chunk* chunk);
+
+/* Offset of the next block of 'bytes' bytes in 'chunk' */
+static size_t chunk_offset(arena_chunk* chunk, size_t bytes);
+
+arena* arena_init(size_t chunksize)
+{
+    arena *ar;
+
+    ar = ncalloc(1, sizeof(*ar));
+    ar->chunksize = chunksize;
+    ar->chunks = NULL;
+    ar->last = NULL;
+    return ar;
+}
+
+assoc_allocator arena_allocator(arena* ar)
+{
+    assoc_allocator al;
+
+    al.alloc = arena_alloc;
+    al.realloc = arena_realloc;
+    al.free = arena_release;
+    al.ctx = ar;
+    return al;
+}
+
+void arena_free(arena* ar)
+{
+    arena_chunk *chunk, *next;
+
+    for(chunk = ar->chunks; chunk != NULL; chunk = next){
+        next = chunk->next;
+        free(chunk);
+    }
+    free(ar);
+}
+
+static char* chunk_base(arena_chunk* chunk)
+{
+    return (char *) chunk + sizeof(*chunk);
+}
+
+static size_t chunk_offset(arena_chunk* chunk, size_t bytes)
+{
+    unsigned long align, address;
+
+    align = bytes >= CACHELINE ? CACHELINE : ARENAALIGN;
+    address = (unsigned long) chunk_base(chunk) + chunk->used;
+    address = (address + align - 1) & ~(align - 1);
+    return address - (unsigned long) chunk_base(chunk);
+}
+/*
+   Chunks come from calloc() and blocks are never reused,
+   so every block is already zeroed.
+*/
+static void* arena_alloc(void* ctx, size_t bytes)
+{
+    arena *ar;
+    arena_chunk *chunk;
+    size_t offset, size;
+
+    ar = (arena *) ctx;
+    chunk = ar->chunks;
+    if(chunk == NULL || chunk_offset(chunk, bytes) + bytes > chunk->size){
+        size = ar->chunksize;
+        if(size < bytes + CACHELINE){
+            size = bytes + CACHELINE;
+        }
+        chunk = ncalloc(1, sizeof(*chunk) + size);
+        chunk->size = size;
+        chunk->used = 0;
+        chunk->next = ar->chunks;
+        ar->chunks = chunk;
+    }
+    offset = chunk_offset(chunk, bytes);
+    chunk->used = offset + bytes;
+    ar->last = chunk_base(chunk) + offset;
+    return ar->last;
+}
+
+static void* arena_realloc(void* ctx, void* p, size_t old_bytes,
+                           size_t new_bytes)
+{
+    arena *ar;
+    arena_chunk *chunk;
+    char *n;
+    size_t offset;
+
+    ar = (arena *) ctx;
+    chunk = ar->chunks;
+    /* The newest block can simply be extended */
+    if(p == ar->last && chunk != NULL){
+        offset = (char *) p - chunk_base(chunk);
+        if(offset + new_bytes <= chunk->size){
+            if(new_bytes > old_bytes){
+                memset((char *) p + old_bytes, 0, new_bytes - old_bytes);
+            }
+            chunk->used = offset + new_bytes;
+            return p;
+        }
+    }
+    n = arena_alloc(ctx, new_bytes);
+    memcpy(n, p, old_bytes < new_bytes ? old_bytes : new_bytes);
+    return n;
+}
+
+static void arena_release(void* ctx, void* p, size_t bytes)
+{
+    (void) ctx;
+    (void) p;
+    (void) bytes;
+}
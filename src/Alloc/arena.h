@@ -0,0 +1,39 @@
+/*
+   A bump arena: allocation is a pointer increment, free()
+   does nothing, and everything is released at once by
+   arena_free(). Good for short lived (e.g. per request)
+   tables that would otherwise churn the global heap.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "alloc.h"
+
+typedef struct arena_chunk {
+
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+
+} arena_chunk;
+
+typedef struct arena {
+
+    arena_chunk *chunks;
+    size_t chunksize;
+    /* The most recent block, which realloc can grow in place */
+    char *last;
+
+} arena;
+
+/* New chunks are at least 'chunksize' bytes */
+arena* arena_init(size_t chunksize);
+
+/* An allocator handing out memory from 'ar' */
+assoc_allocator arena_allocator(arena* ar);
+
+/* Releases every block ever allocated from 'ar' */
+void arena_free(arena* ar);
+
+#endif
@@ -0,0 +1,137 @@
+#include "bloom.h"
+#include "../Hash/hash.h"
+
+/* Bits in one block (a 64 byte cache line) */
+#define BLOCKBITS 512
+/* Bits in one word of the block */
+#define WORDBITS (sizeof(unsigned long) * 8)
+/* Optimal hashes ~ 0.69 * bits per key, in hundredths */
+#define LN2PERCENT 69
+#define PERCENT 100
+/* Never probe more than this many bits per key */
+#define MAXHASHES 8
+/* High bits of the hash choose the bit offsets */
+#define SHIFTFIRST 32
+#define SHIFTSTEP 41
+
+/* Size of the bit array */
+static size_t bloom_bytes(bloom* b);
+
+bloom* bloom_init(unsigned long capacity, int bits_per_key,
+                  const assoc_allocator* al)
+{
+    bloom *b;
+    unsigned long wanted;
+
+    b = mem_alloc(al, sizeof(*b));
+    b->alloc = *al;
+    wanted = capacity * bits_per_key;
+    b->blocks = 1;
+    while(b->blocks * BLOCKBITS < wanted){
+        b->blocks *= 2;
+    }
+    b->bits = mem_alloc(al, bloom_bytes(b));
+    b->hashes = (bits_per_key * LN2PERCENT + PERCENT / 2) / PERCENT;
+    if(b->hashes < 1){
+        b->hashes = 1;
+    }
+    if(b->hashes > MAXHASHES){
+        b->hashes = MAXHASHES;
+    }
+    return b;
+}
+bloom* bloom_build(pairs_walk walk, void* table, unsigned long capacity,
+                   int bits_per_key, size_t keysize,
+                   const assoc_allocator* al)
+{
+    bloom *b;
+    pairs p;
+    unsigned long index;
+
+    b = bloom_init(capacity, bits_per_key, al);
+    pairs_collect(&p, walk, table, capacity, al);
+    for(index = 0; index < p.count; index += 1){
+        bloom_add(b, hash_key(keysize, p.keys[index]));
+    }
+    pairs_free(&p);
+    return b;
+}
+/*
+   The low bits pick the block, the rest are split into
+   two halves and combined (Kirsch-Mitzenmacher) to give
+   the bit offsets within it.
+*/
+void bloom_add(bloom* b, unsigned long hash)
+{
+    unsigned long *block, offset, step;
+    int index;
+
+    block = &b->bits[(hash & (b->blocks - 1)) * (BLOCKBITS / WORDBITS)];
+    offset = hash >> SHIFTFIRST;
+    step = (hash >> SHIFTSTEP) | 1;
+
+    for(index = 0; index < b->hashes; index += 1){
+        offset = (offset + step) % BLOCKBITS;
+        block[offset / WORDBITS] |= 1UL << (offset % WORDBITS);
+    }
+}
+
+int bloom_maybe(bloom* b, unsigned long hash)
+{
+    unsigned long *block, offset, step;
+    int index;
+
+    block = &b->bits[(hash & (b->blocks - 1)) * (BLOCKBITS / WORDBITS)];
+    offset = hash >> SHIFTFIRST;
+    step = (hash >> SHIFTSTEP) | 1;
+
+    for(index = 0; index < b->hashes; index += 1){
+        offset = (offset + step) % BLOCKBITS;
+        if((block[offset / WORDBITS] & (1UL << (offset % WORDBITS))) == 0){
+            return 0;
+        }
+    }
+    return 1;
+}
+/*
+   A query passes if all its bits are set, so the rate is
+   roughly (fraction of bits set) ^ hashes.
+*/
+double bloom_fpr(bloom* b)
+{
+    unsigned long index, words, set;
+    double fill, rate;
+    int hash;
+
+    if(b == NULL){
+        return 0.0;
+    }
+    words = b->blocks * (BLOCKBITS / WORDBITS);
+    set = 0;
+    for(index = 0; index < words; index += 1){
+        set += bits_count(b->bits[index]);
+    }
+    fill = (double) set / (double) (words * WORDBITS);
+    rate = 1.0;
+    for(hash = 0; hash < b->hashes; hash += 1){
+        rate *= fill;
+    }
+    return rate;
+}
+
+void bloom_free(bloom* b)
+{
+    assoc_allocator al;
+
+    if(b == NULL){
+        return;
+    }
+    al = b->alloc;
+    mem_free(&al, b->bits, bloom_bytes(b));
+    mem_free(&al, b, sizeof(*b));
+}
+
+static size_t bloom_bytes(bloom* b)
+{
+    return b->blocks * (BLOCKBITS / 8);
+}
@@ -0,0 +1,56 @@
+/*
+   A blocked Bloom filter: every key sets its bits inside
+   a single 64 byte block, so a query costs one cache miss.
+   No false negatives; false positives at a rate set by the
+   number of bits per key (8 bits => roughly 2%).
+*/
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdlib.h>
+
+#include "../Alloc/alloc.h"
+#include "../Pairs/pairs.h"
+
+typedef struct bloom {
+
+    unsigned long *bits;
+    unsigned long blocks;
+    int hashes;
+    assoc_allocator alloc;
+
+} bloom;
+
+/*
+   Room for 'capacity' keys at 'bits_per_key' bits each,
+   all memory coming from 'al'
+*/
+bloom* bloom_init(unsigned long capacity, int bits_per_key,
+                  const assoc_allocator* al);
+
+/*
+   Room for 'capacity' keys, holding every key that 'walk'
+   finds in 'table' (no more than 'capacity' of them), each
+   hashed by hash_key() with 'keysize'
+*/
+bloom* bloom_build(pairs_walk walk, void* table, unsigned long capacity,
+                   int bits_per_key, size_t keysize,
+                   const assoc_allocator* al);
+
+/* Records the key whose hash is 'hash' */
+void bloom_add(bloom* b, unsigned long hash);
+
+/* 0 => key definitely absent, 1 => key might be present */
+int bloom_maybe(bloom* b, unsigned long hash);
+
+/*
+   Estimated chance that an absent key is reported present,
+   0.0 for no filter (NULL)
+*/
+double bloom_fpr(bloom* b);
+
+/* Does nothing for no filter (NULL) */
+void bloom_free(bloom* b);
+
+#endif
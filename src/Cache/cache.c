@@ -0,0 +1,105 @@
+/* clock_gettime() isn't C90 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <time.h>
+
+#include "cache.h"
+
+#define MSPERSEC 1000UL
+#define NSPERMS 1000000UL
+/* The expiry time sits above the reference bit */
+#define EXPIRYSHIFT 1
+
+unsigned long cache_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * MSPERSEC +
+           (unsigned long) ts.tv_nsec / NSPERMS;
+}
+
+unsigned long cache_fresh(const cache* c)
+{
+    if(c->ttl == 0){
+        return 0;
+    }
+    return (cache_now() + c->ttl) << EXPIRYSHIFT;
+}
+/*
+   Only pairs given an expiry time pay for reading the
+   clock, so a cache without a ttl never does
+*/
+int cache_stale(unsigned long word)
+{
+    word >>= EXPIRYSHIFT;
+    return word != 0 && word <= cache_now();
+}
+/* Only sets the reference bit if it isn't already, sparing a write */
+int cache_touch(unsigned long* word)
+{
+    if(cache_stale(*word)){
+        return 0;
+    }
+    if(!(*word & CACHEREF)){
+        *word |= CACHEREF;
+    }
+    return 1;
+}
+
+int cache_hit(const cache* c, unsigned long* word, int overwrite)
+{
+    if(cache_stale(*word)){
+        *word = cache_fresh(c);
+        return 1;
+    }
+    if(overwrite){
+        *word = cache_fresh(c) | CACHEREF;
+    }
+    else{
+        *word |= CACHEREF;
+    }
+    return overwrite;
+}
+
+int cache_forget(cache* c)
+{
+    c->evicted += 1;
+    if(c->evicted < c->capacity){
+        return 0;
+    }
+    c->evicted = 0;
+    return 1;
+}
+/*
+   Terminates: after one full turn every reference bit the
+   hand passed has been cleared, so it stops on its second.
+*/
+unsigned long cache_victim(cache* c, const unsigned char* ctrl,
+                           unsigned char full, char* slots,
+                           size_t slotsize, unsigned long length)
+{
+    unsigned long index, now, word;
+
+    now = 0;
+    while(1){
+        index = c->hand;
+        c->hand = (c->hand + 1) % length;
+        if(ctrl[index] != full){
+            continue;
+        }
+        word = CACHEWORD(slots, slotsize, index);
+        if(word >> EXPIRYSHIFT != 0){
+            if(now == 0){
+                now = cache_now();
+            }
+            if(word >> EXPIRYSHIFT <= now){
+                return index;
+            }
+        }
+        if(!(word & CACHEREF)){
+            return index;
+        }
+        CACHEWORD(slots, slotsize, index) = word & ~CACHEREF;
+    }
+}
@@ -0,0 +1,83 @@
+/*
+   Bookkeeping for tables in cache mode: a fixed number of
+   pairs, with CLOCK (second chance) eviction once full. Each
+   slot carries one extra word at its end, holding a
+   reference bit, set when the pair is looked up, and an
+   optional expiry time, so both move with the slot whenever
+   a table moves slots about. The clock hand sweeps the slot
+   array, clearing reference bits as it goes, and stops at
+   the first pair that has expired or not been used since
+   the hand last passed.
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdlib.h>
+
+/* Set in a slot's cache word when the pair is used */
+#define CACHEREF 1UL
+
+/* Bytes per slot once a cache word is added to 'size' */
+#define CACHESLOT(size) \
+    ((((size) + sizeof(unsigned long) - 1) & \
+      ~(sizeof(unsigned long) - 1)) + sizeof(unsigned long))
+
+/* The cache word of slot 'i' */
+#define CACHEWORD(slots, slotsize, i) \
+    (*(unsigned long *) &(slots)[((size_t) (i) + 1) * (slotsize) - \
+                                 sizeof(unsigned long)])
+
+typedef struct cache {
+
+    size_t capacity;
+    /* Milliseconds each new pair lives, 0 => forever */
+    unsigned long ttl;
+    unsigned long hand;
+    /* Pairs evicted since the table's filter was rebuilt */
+    size_t evicted;
+
+} cache;
+
+/* Milliseconds on a clock that never goes backwards */
+unsigned long cache_now(void);
+
+/* The cache word for a pair inserted (or replaced) now */
+unsigned long cache_fresh(const cache* c);
+
+/* Non-zero if the pair with cache word 'word' has expired */
+int cache_stale(unsigned long word);
+
+/*
+   A lookup found the pair with cache word *word: returns 0
+   if it has expired, to be evicted and reported missing,
+   otherwise marks it used
+*/
+int cache_touch(unsigned long* word);
+
+/*
+   An insert found the pair with cache word *word: marks it
+   used, and returns non-zero if its data is to be replaced.
+   A hit on an expired pair counts as inserting it afresh,
+   and replacing the data restarts its time to live.
+*/
+int cache_hit(const cache* c, unsigned long* word, int overwrite);
+
+/*
+   Counts one more pair gone from a table with a filter,
+   returning non-zero when the filter is due to be rebuilt:
+   Bloom filters can't forget, so start afresh now and then
+*/
+int cache_forget(cache* c);
+
+/*
+   Moves the hand round 'ctrl' (slots in use are 'full')
+   to the next pair to evict, giving each pair it passes
+   with its reference bit set a second chance. There must
+   be at least one pair in use.
+*/
+unsigned long cache_victim(cache* c, const unsigned char* ctrl,
+                           unsigned char full, char* slots,
+                           size_t slotsize, unsigned long length);
+
+#endif
@@ -0,0 +1,300 @@
+#include <string.h>
+
+#include "compact.h"
+#include "../Hash/hash.h"
+
+/* Slots are at most 80% full */
+#define LOADNUM 4
+#define LOADDEN 5
+/* Smallest slot array */
+#define MINSLOTS 16
+/* Slot layout: 24 bit tag above a 40 bit index */
+#define TAGSHIFT 40
+#define INDEXMASK ((1UL << TAGSHIFT) - 1)
+
+/* A key and its value while sorting */
+typedef struct pair {
+
+    const unsigned char *key;
+    size_t length;
+    void *value;
+
+} pair;
+
+/* Orders pairs by key bytes, shorter first on a common prefix */
+static int pair_compare(const void* a, const void* b);
+
+/* Length of a key, as a string or as 'keysize' bytes */
+static size_t key_length(size_t keysize, void* key);
+
+/* Front-codes the sorted pairs into blocks */
+static void build_blocks(compact* c, pair* pairs);
+
+/* Fills the hash slots with each key's sorted index */
+static void build_slots(compact* c, pair* pairs);
+
+/* Decodes key 'index' into scratch, returning its length */
+static size_t decode(compact* c, unsigned long index);
+
+compact* compact_build(void** keys, void** values, unsigned long count,
+                       size_t keysize, const assoc_allocator* al)
+{
+    compact *c;
+    pair *pairs;
+    unsigned long index;
+
+    c = mem_alloc(al, sizeof(*c));
+    c->alloc = *al;
+    c->count = count;
+    c->keysize = keysize;
+
+    pairs = mem_alloc(al, (count + 1) * sizeof(*pairs));
+    c->maxlen = 0;
+    for(index = 0; index < count; index += 1){
+        pairs[index].key = keys[index];
+        pairs[index].length = key_length(keysize, keys[index]);
+        pairs[index].value = values[index];
+        if(pairs[index].length > c->maxlen){
+            c->maxlen = pairs[index].length;
+        }
+    }
+    qsort(pairs, count, sizeof(*pairs), pair_compare);
+
+    c->scratch = mem_alloc(al, c->maxlen + 1);
+    c->decoded = NULL;
+    c->decodedsize = 0;
+    c->values = mem_alloc(al, (count + 1) * sizeof(void *));
+    for(index = 0; index < count; index += 1){
+        c->values[index] = pairs[index].value;
+    }
+    build_blocks(c, pairs);
+    build_slots(c, pairs);
+
+    mem_free(al, pairs, (count + 1) * sizeof(*pairs));
+    return c;
+}
+compact* compact_copy(pairs_walk walk, void* table, unsigned long most,
+                      size_t keysize, const assoc_allocator* al)
+{
+    compact *c;
+    pairs p;
+
+    pairs_collect(&p, walk, table, most, al);
+    c = compact_build(p.keys, p.values, p.count, keysize, al);
+    pairs_free(&p);
+    return c;
+}
+/*
+   The first key of each block is stored whole so a block
+   can be decoded without looking at the one before it.
+*/
+static void build_blocks(compact* c, pair* pairs)
+{
+    unsigned long index;
+    size_t bound, used, shared, limit;
+    unsigned char *out;
+
+    c->nblocks = (c->count + BLOCKKEYS - 1) / BLOCKKEYS;
+    c->blocks = mem_alloc(&c->alloc, (c->nblocks + 1) * sizeof(size_t));
+
+    bound = 1;
+    for(index = 0; index < c->count; index += 1){
+        bound += pairs[index].length + 2 * VARINTMAX;
+    }
+    c->data = mem_alloc(&c->alloc, bound);
+    out = c->data;
+    used = 0;
+
+    for(index = 0; index < c->count; index += 1){
+        shared = 0;
+        if(index % BLOCKKEYS == 0){
+            c->blocks[index / BLOCKKEYS] = used;
+        }
+        else{
+            limit = pairs[index].length < pairs[index - 1].length ?
+                    pairs[index].length : pairs[index - 1].length;
+            while(shared < limit &&
+                  pairs[index].key[shared] == pairs[index - 1].key[shared]){
+                shared += 1;
+            }
+        }
+        used += varint_put(&out[used], shared);
+        used += varint_put(&out[used], pairs[index].length - shared);
+        memcpy(&out[used], &pairs[index].key[shared],
+               pairs[index].length - shared);
+        used += pairs[index].length - shared;
+    }
+    c->data = mem_realloc(&c->alloc, c->data, bound, used + 1);
+    c->datasize = used + 1;
+}
+
+static void build_slots(compact* c, pair* pairs)
+{
+    unsigned long index, size, hash, pos;
+
+    size = MINSLOTS;
+    while(size * LOADNUM < c->count * LOADDEN){
+        size *= 2;
+    }
+    c->mask = size - 1;
+    c->slots = mem_alloc(&c->alloc, size * sizeof(unsigned long));
+
+    for(index = 0; index < c->count; index += 1){
+        hash = hash_bytes(pairs[index].key, pairs[index].length);
+        pos = hash & c->mask;
+        while(c->slots[pos] != 0){
+            pos = (pos + 1) & c->mask;
+        }
+        c->slots[pos] = ((hash >> TAGSHIFT) << TAGSHIFT) | (index + 1);
+    }
+}
+/*
+   A slot whose tag differs can't hold the key, so blocks
+   are only decoded on a tag match (1 in 2^24 false).
+*/
+void* compact_lookup(compact* c, void* key)
+{
+    unsigned long hash, tag, pos, slot, index;
+    size_t length;
+
+    length = key_length(c->keysize, key);
+    hash = hash_bytes(key, length);
+    tag = (hash >> TAGSHIFT) << TAGSHIFT;
+    pos = hash & c->mask;
+
+    while((slot = c->slots[pos]) != 0){
+        if((slot & ~INDEXMASK) == tag){
+            index = (slot & INDEXMASK) - 1;
+            if(decode(c, index) == length &&
+               memcmp(c->scratch, key, length) == 0){
+                return c->values[index];
+            }
+        }
+        pos = (pos + 1) & c->mask;
+    }
+    return NULL;
+}
+
+void* compact_key(compact* c, unsigned long index)
+{
+    decode(c, index);
+    return c->scratch;
+}
+
+/*
+   The blocks lie back to back in sorted order, so each key
+   is built on the one decoded just before it
+*/
+unsigned long compact_walk(void* table, void** keys, void** values)
+{
+    compact *c;
+    const unsigned char *in;
+    char *out, *previous;
+    unsigned long index;
+    size_t shared, rest;
+
+    c = (compact *) table;
+    if(c->decoded == NULL){
+        in = c->data;
+        for(index = 0; index < c->count; index += 1){
+            shared = (size_t) varint_get(&in);
+            rest = (size_t) varint_get(&in);
+            in += rest;
+            c->decodedsize += shared + rest + 1;
+        }
+        c->decoded = mem_alloc(&c->alloc, c->decodedsize + 1);
+    }
+    in = c->data;
+    out = c->decoded;
+    previous = out;
+    for(index = 0; index < c->count; index += 1){
+        shared = (size_t) varint_get(&in);
+        rest = (size_t) varint_get(&in);
+        memcpy(out, previous, shared);
+        memcpy(out + shared, in, rest);
+        in += rest;
+        out[shared + rest] = '\0';
+        keys[index] = out;
+        values[index] = c->values[index];
+        previous = out;
+        out += shared + rest + 1;
+    }
+    return c->count;
+}
+
+double compact_bytes_per_key(compact* c)
+{
+    size_t total;
+
+    if(c == NULL || c->count == 0){
+        return 0.0;
+    }
+    total = (c->mask + 1) * sizeof(unsigned long) + c->datasize +
+            c->nblocks * sizeof(size_t) + c->count * sizeof(void *);
+    return (double) total / (double) c->count;
+}
+
+void compact_free(compact* c)
+{
+    assoc_allocator al;
+
+    al = c->alloc;
+    mem_free(&al, c->slots, (c->mask + 1) * sizeof(unsigned long));
+    mem_free(&al, c->data, c->datasize);
+    mem_free(&al, c->blocks, (c->nblocks + 1) * sizeof(size_t));
+    mem_free(&al, c->values, (c->count + 1) * sizeof(void *));
+    mem_free(&al, c->scratch, c->maxlen + 1);
+    if(c->decoded != NULL){
+        mem_free(&al, c->decoded, c->decodedsize + 1);
+    }
+    mem_free(&al, c, sizeof(*c));
+}
+/*
+   Each key rebuilds on top of the previous one, so walk
+   from the start of the block up to the wanted offset.
+*/
+static size_t decode(compact* c, unsigned long index)
+{
+    const unsigned char *in;
+    size_t shared, rest, length;
+    unsigned long offset;
+
+    in = &c->data[c->blocks[index / BLOCKKEYS]];
+    length = 0;
+    for(offset = 0; offset <= index % BLOCKKEYS; offset += 1){
+        shared = (size_t) varint_get(&in);
+        rest = (size_t) varint_get(&in);
+        memcpy(&c->scratch[shared], in, rest);
+        in += rest;
+        length = shared + rest;
+    }
+    c->scratch[length] = '\0';
+    return length;
+}
+
+static int pair_compare(const void* a, const void* b)
+{
+    const pair *pa, *pb;
+    size_t limit;
+    int order;
+
+    pa = (const pair *) a;
+    pb = (const pair *) b;
+    limit = pa->length < pb->length ? pa->length : pb->length;
+    order = memcmp(pa->key, pb->key, limit);
+    if(order != 0){
+        return order;
+    }
+    if(pa->length == pb->length){
+        return 0;
+    }
+    return pa->length < pb->length ? -1 : 1;
+}
+
+static size_t key_length(size_t keysize, void* key)
+{
+    if(keysize == 0){
+        return strlen((char *) key);
+    }
+    return keysize;
+}
@@ -0,0 +1,84 @@
+/*
+   A read-only table for large key sets. Keys are sorted
+   and cut into blocks of BLOCKKEYS; within a block each key
+   is front-coded as (bytes shared with the previous key,
+   the rest). A hash slot array maps each key to its sorted
+   index, i.e. its block and offset, plus a tag from the hash
+   so that almost every probe decodes exactly one block.
+*/
+
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include "../Alloc/alloc.h"
+#include "../Pairs/pairs.h"
+
+/* Keys per front-coded block */
+#define BLOCKKEYS 16
+
+typedef struct compact {
+
+    /* Hash slots: tag in the top bits, sorted index + 1 below */
+    unsigned long *slots;
+    unsigned long mask;
+
+    /* Front-coded blocks back to back, and where each starts */
+    unsigned char *data;
+    size_t datasize;
+    size_t *blocks;
+    unsigned long nblocks;
+
+    /* Values in sorted key order */
+    void **values;
+    unsigned long count;
+    size_t keysize;
+
+    /* Holds a decoded key, as long as the longest key */
+    char *scratch;
+    size_t maxlen;
+    /* Every key decoded back to back, once something walks them */
+    char *decoded;
+    size_t decodedsize;
+
+    assoc_allocator alloc;
+
+} compact;
+
+/*
+   Builds from 'count' keys and their values. 'keysize' as
+   for assoc_init(), 0 => '\0' terminated strings. The keys
+   are copied, so the originals can be freed afterwards.
+*/
+compact* compact_build(void** keys, void** values, unsigned long count,
+                       size_t keysize, const assoc_allocator* al);
+
+/*
+   Builds from every pair 'walk' finds in 'table', which
+   holds at most 'most', as frozen_copy() does
+*/
+compact* compact_copy(pairs_walk walk, void* table, unsigned long most,
+                      size_t keysize, const assoc_allocator* al);
+
+/* The value stored against 'key', NULL => not found */
+void* compact_lookup(compact* c, void* key);
+
+/*
+   Decodes the key with sorted index 'index'. The result is
+   only valid until the next call on 'c'.
+*/
+void* compact_key(compact* c, unsigned long index);
+
+/*
+   A pairs_walk over the compact* 'table', in sorted order.
+   The keys must all stay valid at once, so unlike
+   compact_key() they're decoded into a copy of their own,
+   kept until compact_free().
+*/
+unsigned long compact_walk(void* table, void** keys, void** values);
+
+/* Total bytes used per key, including slots and values, 0.0 for NULL */
+double compact_bytes_per_key(compact* c);
+
+void compact_free(compact* c);
+
+#endif
@@ -12,244 +12,852 @@
    Private functions:
 */
 
-/* Creates copy of the 'original' string given as argument */
-static char* clone_string(char* original);
+/*
+   Bytes in one slot: with a value, the key rounded up to
+   pointer alignment; a set's keys are packed
+*/
+static size_t slot_size(size_t keysize, size_t valuesize);
+
+/* Shared by maps and sets, 'valuesize' 0 => set */
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc);
+
+/* What a lookup returns for slot 'index': its data, or for a set the key */
+static void* found_data(assoc* assocs, assoc_size index, void* key);
 
 /* Doubles the length of the internal arrays */
 static void expand_assoc(assoc* assocs);
 
-/* Two hashes required to overcome collisions */
-static int hash_key_a(int keysize, void* key);
+/* Index of 'key' among a small table's pairs, or NOTFOUND */
+static assoc_size small_find(assoc* assocs, void* key);
+
+/* Moves a small table's pairs out into nests of their own */
+static void spill(assoc* assocs);
+
+/* Sizes a new filter for the current length and adds every key */
+static void filter_build(assoc* assocs);
 
-/* Two hashes required to overcome collisions */
-static int hash_key_b(int keysize, void* key);
 /*
    Inserts one key-value pair into the assocs object.
    Uses flag "count" to decide whether or not
    a call to this will affect assocs->count.
+   Returns the index the key ended up at.
 */
-static void insert_one(assoc* assocs, void* key, void* value,
-                       int count_this);
+static assoc_size insert_one(assoc* assocs, void* key, void* value,
+                      int count_this);
 
-/* Looks to see if equal key found */
-static void* lookup_strings(assoc* assocs, char* key);
+/* Looks to see if equal key found, in the nests of its 'hash' */
+static void* lookup_strings(assoc* assocs, char* key, unsigned long hash);
 
-/* Looks to see if equal key found */
-static void* lookup_general(assoc* assocs, void* key);
+/* Looks to see if equal key found, in the nests of its 'hash' */
+static void* lookup_general(assoc* assocs, void* key, unsigned long hash);
 
-/* Fills memory with value and passes to insert_one */
-static void expand_strings(assoc* assocs, void **old_values,
-                           char **old_keys, int old_length);
-
-/* Fills memory with value and passes to insert_one */
-static void expand_general(assoc* assocs, void **old_values,
-                           void *old_keys, int old_length);
+/* Passes every occupied old slot to insert_one */
+static void expand_slots(assoc* assocs, char *old_slots,
+                         unsigned char *old_ctrl, assoc_size old_length);
 
 /* Inserts one key-value pair into the assocs object. */
 static void insert_string(assoc* assocs, char* key,
-                          int index, int copy_this);
+                          assoc_size index, int copy_this);
 
 /* Inserts one key-value pair into the assocs object. */
-static void insert_general(assoc* assocs, void* key, int index);
+static void insert_general(assoc* assocs, void* key, assoc_size index);
 
 /* Passes key-value pairs to insert_string and insert_general */
 static void insert_one_index(assoc* assocs, void* key, void* value,
-                             int index, int count_this);
+                             assoc_size index, int count_this);
 /*
    Function responsible for kicking other keys away
-   until every key has its own 'nest'.
+   until every key has its own 'nest'. Returns false if
+   the chain got too long and the table had to grow.
 */
-static void kick_out(assoc* assocs, int index);
+static bool kick_out(assoc* assocs, assoc_size index);
+
+/* The key stored in a slot (for strings, the string itself) */
+static void* slot_key(assoc* assocs, char* slot);
+
+/* The nest of the key in 'slot' that isn't 'index' */
+static assoc_size other_nest(assoc* assocs, char* slot,
+                             assoc_size index);
 
-/* Function responsible for 'kicking' other keys away */
-static void kick_out_general(assoc* assocs, int index_m);
+/* Places a key whose nests are 'index_a' and 'index_b' */
+static assoc_size insert_nests(assoc* assocs, void* key, void* value,
+                        int count_this, assoc_size index_a,
+                               assoc_size index_b);
 
-/* Function responsible for 'kicking' other keys away */
-static void kick_out_string(assoc* assocs, int index_m);
+/* True if the key held in slot 'index' equals 'key' */
+static bool key_equal(assoc* assocs, assoc_size index, void* key);
 
+/* Index of the nest holding 'key', or NOTFOUND */
+static assoc_size find_nest(assoc* assocs, void* key,
+                            assoc_size* index_a, assoc_size* index_b);
 /*
-    Removes repeated values but failed to work properly.
-    I've kept it and commented it out to show that an
-    attempt was made.
+   Single probe of both nests for 'key'. If the key isn't
+   there it's inserted with 'value'; if it is, the value is
+   replaced only when 'overwrite' is set.
 */
-/*static int repeated_insert(assoc* assocs, void *key,
-                              void *value, int index);*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite);
+
+/* Fills 'keys' and 'values' from the slots, returns the number */
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values);
+
+/* wal_replay() callback: redoes one logged change, unlogged */
+static void replay_change(void* table, int op, void* key, void* data);
+
+/* load_words() callback: inserts one word, as assoc_insert() */
+static void insert_word(void* table, char* word);
+
+/* Frees the slot array and any keys cloned into it */
+static void release_slots(assoc* assocs);
+
+/* Takes the pair in slot 'index' out of the table, freeing its key */
+static void remove_slot(assoc* assocs, assoc_size index);
+
+/* Frees the key held in 'slot', which has left the table */
+static void forget_key(assoc* assocs, char* slot);
+
+/* An empty set already big enough for 'n' keys */
+static assoc* sized_set(size_t keysize, size_t n);
+
+/* sets_probe: looks up one batch of keys in the table 'table' */
+static void probe_batch(void* table, void** keys, int n, int* found);
+
+/* sets_add: puts 'key' into the set 'out' */
+static void add_key(void* out, void* key);
+
+/* This backend's part in the set operations */
+static const sets_ops set_ops = {collect_pairs, probe_batch, add_key};
 
 /* Testing on the private functions */
 void assoc_test();
 
-assoc* assoc_init(int keysize)
+assoc* assoc_init(size_t keysize)
+{
+    return assoc_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, sizeof(void *), alloc);
+}
+
+assoc* assoc_set_init(size_t keysize)
+{
+    return assoc_set_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_set_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, 0, alloc);
+}
+
+/*
+   One allocation: the struct with the small slots and their
+   control bytes after it, so a table that never holds more
+   than a handful of pairs costs a single malloc() and free()
+*/
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc)
 {
-    int full_keysize;
     assoc* assocs;
 
-    assocs = malloc(sizeof(*assocs));
+    if(alloc == NULL){
+        alloc = &heap_allocator;
+    }
+    assocs = mem_alloc(alloc, sizeof(*assocs) +
+                              SMALLBYTES(slot_size(keysize, valuesize)));
+    assocs->alloc = *alloc;
     assocs->keysize = keysize;
-    assocs->length = SIZE;
+    assocs->valuesize = valuesize;
+    assocs->borrowed = false;
+    assocs->words = NULL;
+    assocs->slotsize = slot_size(keysize, valuesize);
+    assocs->length = SMALLMAX;
     assocs->count = 0;
+    assocs->slots = INLINESLOTS(assocs);
+    assocs->ctrl = (unsigned char *) assocs->slots +
+                   (size_t) assocs->slotsize * SMALLMAX;
+    assocs->spare = NULL;
+    assocs->filter = NULL;
+    assocs->filter_bits = 0;
+    assocs->frozen = NULL;
+    assocs->compact = NULL;
+    assocs->shared = NULL;
+    assocs->cache = NULL;
+    assocs->log = NULL;
 
-    if(keysize == 0){ /* Special case of (char *) */
-        full_keysize = sizeof(char *) * assocs->length;
-    }
-    else{
-        full_keysize = keysize * assocs->length;
-    }
-    assocs->keys = malloc(full_keysize);
-    memset(assocs->keys, 0, full_keysize);
+    return assocs;
+}
 
-    assocs->values = malloc(sizeof(void *) * assocs->length);
-    memset(assocs->values, 0, sizeof(*assocs->values) * assocs->length);
+/*
+   Sized so that 'capacity' pairs keep the table no fuller
+   than a growing one would get, each slot one word longer
+   for its reference bit and expiry
+*/
+assoc* assoc_cache_init(size_t keysize, size_t capacity)
+{
+    assoc* assocs;
 
+    if(capacity == 0){
+        on_error("A cache needs room for at least one pair");
+    }
+    assocs = make_assoc(keysize, sizeof(void *), NULL);
+    release_slots(assocs);
+    assocs->slotsize = CACHESLOT(assocs->slotsize);
+    assocs->length = SIZE;
+    while(assocs->length / RESIZE < capacity){
+        if(assocs->length > ASSOCMAX / DOUBLE){
+            on_error("Cache capacity is too big for its index type");
+        }
+        assocs->length *= DOUBLE;
+    }
+    assocs->slots = mem_alloc(&assocs->alloc, (size_t) assocs->slotsize *
+                                              assocs->length);
+    assocs->ctrl = mem_alloc(&assocs->alloc, assocs->length);
+    assocs->spare = mem_alloc(&assocs->alloc, assocs->slotsize * SPARES);
+    assocs->cache = mem_alloc(&assocs->alloc, sizeof(cache));
+    assocs->cache->capacity = capacity;
     return assocs;
 }
 
-void assoc_insert(assoc** a, void* key, void* data)
+void assoc_cache_ttl(assoc* assocs, unsigned long ms)
 {
-    assoc* assocs;
-    assocs = *a;
-    /* If the array is 25% filled, resize it (log2(16))*/
-    if(assocs->count == assocs->length / RESIZE){
-        expand_assoc(assocs);
+    if(assocs->cache == NULL){
+        on_error("Only a cache has a time to live");
     }
-    /* count_this = true */
-    insert_one(assocs, key, data, true);
+    assocs->cache->ttl = ms;
 }
 
-unsigned int assoc_count(assoc* assocs)
+void assoc_insert(assoc** a, void* key, void* data)
 {
-    return assocs->count;
+    find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
 }
 
-static void* lookup_strings(assoc* assocs, char* key)
+void** assoc_upsert(assoc** a, void* key, void* data)
 {
-    char **string_keys;
-    int index_a, index_b;
+    void **stored;
 
-    string_keys = (char **) assocs->keys;
-    index_a = hash_key_a(assocs->keysize, key) % assocs->length;
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    stored = find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+    return stored;
+}
 
-    if(string_keys[index_a] != NULL){
-        if(strcmp(string_keys[index_a], key) == 0){
-            return assocs->values[index_a];
-        }
+/* Only a new key changes the table, so only that is logged */
+void** assoc_get_or_insert(assoc** a, void* key, void* data)
+{
+    void **stored;
+    assoc_size count;
+
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    count = (*a)->count;
+    stored = find_or_insert(*a, key, data, false);
+    if((*a)->log != NULL && (*a)->count != count){
+        wal_append((*a)->log, WALINSERT, key, data);
     }
-    index_b = hash_key_b(assocs->keysize, key) % assocs->length;
+    return stored;
+}
 
-    if(string_keys[index_b] != NULL){
-        if(strcmp(string_keys[index_b], key) == 0){
-            return assocs->values[index_b];
-        }
+int assoc_remove(assoc* assocs, void* key)
+{
+    assoc_size index, index_a, index_b;
+
+    if(assocs->slots == NULL){
+        on_error("Cannot remove from a read-only table");
     }
-    return NULL;
+    if(SMALL(assocs)){
+        index = small_find(assocs, key);
+    }
+    else{
+        index = find_nest(assocs, key, &index_a, &index_b);
+    }
+    if(index == NOTFOUND){
+        return 0;
+    }
+    remove_slot(assocs, index);
+    if(assocs->log != NULL){
+        wal_append(assocs->log, WALREMOVE, key, NULL);
+    }
+    return 1;
 }
 
-static void* lookup_general(assoc* assocs, void* key)
+size_t assoc_count(assoc* assocs)
 {
-    char *buffer;
-    int memory_index, index_a, index_b, comparison;
+    return assocs->count;
+}
 
-    buffer = (char *) assocs->keys;
-    index_a = hash_key_a(assocs->keysize, key) % assocs->length;
+size_t assoc_capacity(assoc* assocs)
+{
+    /* Read-only tables never grow */
+    if(assocs->slots == NULL){
+        return assocs->count;
+    }
+    /* Nor do caches, they evict */
+    if(assocs->cache != NULL){
+        return assocs->cache->capacity;
+    }
+    if(SMALL(assocs)){
+        return SMALLMAX;
+    }
+    /* A failed chain of kicks can grow the table sooner */
+    return assocs->length / RESIZE;
+}
 
-    memory_index = index_a * assocs->keysize;
-    comparison = memcmp(&buffer[memory_index], key, assocs->keysize);
+void assoc_borrow_keys(assoc* assocs)
+{
+    if(assocs->count != 0 || assocs->slots == NULL){
+        on_error("Keys can only be borrowed by an empty table");
+    }
+    assocs->borrowed = true;
+}
 
-    if(comparison == 0){
-        return assocs->values[index_a];
+size_t assoc_load_words(assoc** a, const char* path)
+{
+    if((*a)->keysize != 0){
+        on_error("Words can only go into a table of strings");
     }
+    return load_words(path, insert_word, a,
+                      (*a)->borrowed ? &(*a)->words : NULL);
+}
 
-    index_b = hash_key_b(assocs->keysize, key) % assocs->length;
-    memory_index = index_b * assocs->keysize;
+static void insert_word(void* table, char* word)
+{
+    assoc_insert((assoc **) table, word, NULL);
+}
+
+/*
+   The second nest is prefetched before the first is read,
+   so a miss on it overlaps the first's rather than starting
+   once the first compare is done
+*/
+static void* lookup_strings(assoc* assocs, char* key, unsigned long hash)
+{
+    assoc_size index_a, index_b;
 
-    comparison = memcmp(&buffer[memory_index], key, assocs->keysize);
+    index_a = NESTA(hash, assocs->length);
+    index_b = index_a ^ NESTXOR(hash, assocs->length);
+    PREFETCH(&assocs->slots[(size_t) index_b * assocs->slotsize]);
 
-    if(comparison == 0){
-        return assocs->values[index_b];
+    if(assocs->ctrl[index_a] == SLOTFULL &&
+       strcmp(SLOTSTRING(assocs, index_a), key) == 0){
+        return found_data(assocs, index_a, key);
+    }
+    if(assocs->ctrl[index_b] == SLOTFULL &&
+       strcmp(SLOTSTRING(assocs, index_b), key) == 0){
+        return found_data(assocs, index_b, key);
     }
-
     return NULL;
 }
+/*
+   An empty slot is all zero bytes, so it can equal a key;
+   both nests are compared regardless, and the results
+   combined without branching on the first
+*/
+static void* lookup_general(assoc* assocs, void* key, unsigned long hash)
+{
+    assoc_size index_a, index_b;
+    int found_a, found_b;
+
+    index_a = NESTA(hash, assocs->length);
+    index_b = index_a ^ NESTXOR(hash, assocs->length);
+    PREFETCH(&assocs->slots[(size_t) index_b * assocs->slotsize]);
+
+    found_a = (memcmp(SLOTKEY(assocs, index_a), key,
+                      assocs->keysize) == 0) &
+              (assocs->ctrl[index_a] == SLOTFULL);
+    found_b = (memcmp(SLOTKEY(assocs, index_b), key,
+                      assocs->keysize) == 0) &
+              (assocs->ctrl[index_b] == SLOTFULL);
+    if(!(found_a | found_b)){
+        return NULL;
+    }
+    return found_data(assocs, found_a ? index_a : index_b, key);
+}
 
 void* assoc_lookup(assoc* assocs, void* key)
 {
+    void *value;
+    assoc_size index;
+    unsigned long hash;
+
+    /*
+       Definite miss, don't touch the table. The filter is
+       keyed on the same hash as the table, so a key that gets
+       past it isn't hashed again.
+    */
+    hash = 0;
+    if(assocs->filter != NULL){
+        hash = hash_key(assocs->keysize, key);
+        if(!bloom_maybe(assocs->filter, hash)){
+            return NULL;
+        }
+    }
+    if(assocs->frozen != NULL){
+        value = frozen_lookup(assocs->frozen, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->compact != NULL){
+        value = compact_lookup(assocs->compact, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->shared != NULL){
+        value = shm_lookup(assocs->shared, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(SMALL(assocs)){
+        index = small_find(assocs, key);
+        return index == NOTFOUND ? NULL : found_data(assocs, index, key);
+    }
+    if(assocs->filter == NULL){
+        hash = hash_key(assocs->keysize, key);
+    }
     if(assocs->keysize == 0){
-        return lookup_strings(assocs, (char *) key);
+        return lookup_strings(assocs, (char *) key, hash);
     }
     else{
-        return lookup_general(assocs, key);
+        return lookup_general(assocs, key, hash);
     }
 }
 
 void assoc_free(assoc* assocs)
 {
-    int index;
-    char **string_keys;
+    assoc_allocator alloc;
 
-    if(assocs->keysize == 0){
-        string_keys = (char **) assocs->keys;
+    release_slots(assocs);
+    if(assocs->frozen != NULL){
+        frozen_free(assocs->frozen);
+    }
+    if(assocs->compact != NULL){
+        compact_free(assocs->compact);
+    }
+    if(assocs->shared != NULL){
+        shm_detach(assocs->shared);
+    }
+    if(assocs->filter != NULL){
+        bloom_free(assocs->filter);
+    }
+    if(assocs->cache != NULL){
+        mem_free(&assocs->alloc, assocs->cache, sizeof(cache));
+    }
+    if(assocs->log != NULL){
+        wal_close(assocs->log);
+    }
+    wordfile_close(assocs->words);
+    alloc = assocs->alloc;
+    if(assocs->spare != NULL){
+        mem_free(&alloc, assocs->spare, assocs->slotsize * SPARES);
+    }
+    mem_free(&alloc, assocs,
+             sizeof(*assocs) +
+             SMALLBYTES(slot_size(assocs->keysize, assocs->valuesize)));
+}
+
+static void release_slots(assoc* assocs)
+{
+    assoc_size index;
 
+    if(assocs->slots == NULL){
+        return;
+    }
+    if(assocs->keysize == 0 && !assocs->borrowed){
         for(index = 0; index < assocs->length; index += 1){
-            if (string_keys[index] != NULL){
-                free(string_keys[index]);
+            if(assocs->ctrl[index] == SLOTFULL){
+                mem_free(&assocs->alloc, SLOTSTRING(assocs, index),
+                         strlen(SLOTSTRING(assocs, index)) + ADDONE);
+            }
+        }
+    }
+    /* The small slots go with the struct */
+    if(!SMALL(assocs)){
+        mem_free(&assocs->alloc, assocs->slots,
+                 (size_t) assocs->slotsize * assocs->length);
+        mem_free(&assocs->alloc, assocs->ctrl, assocs->length);
+    }
+    assocs->slots = NULL;
+    assocs->ctrl = NULL;
+    assocs->length = 0;
+}
+/*
+   Lists every key (for strings, the string itself) and
+   its value, returning how many there were. Keys of a set
+   get PRESENT, so a read-only lookup can tell they're there.
+   A read-only table is listed by its own walk.
+*/
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values)
+{
+    assoc* assocs;
+    unsigned long found;
+    assoc_size index;
+
+    assocs = (assoc *) table;
+    if(assocs->frozen != NULL){
+        return frozen_walk(assocs->frozen, keys, values);
+    }
+    if(assocs->compact != NULL){
+        return compact_walk(assocs->compact, keys, values);
+    }
+    if(assocs->shared != NULL){
+        return shm_walk(assocs->shared, keys, values);
+    }
+    found = 0;
+    for(index = 0; index < assocs->length; index += 1){
+        if(assocs->ctrl[index] == SLOTFULL){
+            if(assocs->keysize == 0){
+                keys[found] = SLOTSTRING(assocs, index);
             }
+            else{
+                keys[found] = SLOTKEY(assocs, index);
+            }
+            values[found] = assocs->valuesize ? SLOTVALUE(assocs, index)
+                                              : PRESENT;
+            found += 1;
         }
     }
-    free(assocs->keys);
-    free(assocs->values);
-    free(assocs);
+    return found;
+}
+/*
+   The frozen copy owns its keys, so the slots (and any
+   cloned string keys) can go straight away.
+*/
+void assoc_freeze(assoc* assocs)
+{
+    if(assocs->slots == NULL){
+        on_error("Table is already read-only");
+    }
+    assocs->frozen = frozen_copy(collect_pairs, assocs, assocs->count,
+                                 assocs->keysize, &assocs->alloc);
+    release_slots(assocs);
 }
 
-static char* clone_string(char* original)
+void assoc_compact(assoc* assocs)
 {
-    char *clone;
-    int length;
+    if(assocs->slots == NULL){
+        on_error("Table is already read-only");
+    }
+    assocs->compact = compact_copy(collect_pairs, assocs, assocs->count,
+                                   assocs->keysize, &assocs->alloc);
+    release_slots(assocs);
+}
 
-    length = strlen(original) + ADDONE;
-    clone = malloc(length);
+/*
+   Data is copied as 'datasize' bytes from where each value
+   points, since the pointers mean nothing in another process
+*/
+void assoc_publish(assoc* assocs, const char* name, size_t datasize)
+{
+    if(assocs->slots == NULL){
+        on_error("Only a live table can be published");
+    }
+    shm_publish_walk(name, collect_pairs, assocs, assocs->count,
+                     assocs->keysize, assocs->valuesize ? datasize : 0,
+                     &assocs->alloc);
+}
+
+assoc* assoc_attach(const char* name)
+{
+    assoc* assocs;
+    shm_table* t;
+
+    t = shm_attach(name);
+    assocs = make_assoc(shm_keysize(t),
+                        shm_datasize(t) ? sizeof(void *) : 0, NULL);
+    release_slots(assocs);
+    assocs->shared = t;
+    assocs->count = (assoc_size) shm_count(t);
+    return assocs;
+}
 
-    strcpy(clone, original);
+int assoc_refresh(assoc* assocs)
+{
+    if(assocs->shared == NULL || !shm_refresh(assocs->shared)){
+        return 0;
+    }
+    assocs->count = (assoc_size) shm_count(assocs->shared);
+    if(assocs->filter != NULL){
+        filter_build(assocs);
+    }
+    return 1;
+}
 
-    return clone;
+void assoc_unpublish(const char* name)
+{
+    shm_unpublish(name);
 }
 
-static void expand_strings(assoc* assocs, void **old_values,
-                                 char **old_keys, int old_length)
+/*
+   Pairs are replayed through the same inserts and removes
+   as ever, but only once the log is attached do they get
+   logged, so replaying writes nothing
+*/
+size_t assoc_log(assoc** a, const char* path, size_t datasize,
+                 unsigned int group)
 {
-    int index;
-    memset(assocs->keys, 0, sizeof(char *) * assocs->length);
+    wal* w;
 
-    for(index = 0; index < old_length; index += 1){
-        if(old_values[index] != NULL){
-            insert_one(
-                assocs,
-                old_keys[index],
-                old_values[index],
-                /* Count_this = false */
-                false
-            );
+    if((*a)->slots == NULL || (*a)->count != 0 || (*a)->log != NULL){
+        on_error("Only an empty live table can start a log");
+    }
+    if((*a)->cache != NULL){
+        on_error("A cache drops pairs by itself, so can't be logged");
+    }
+    w = wal_open(path, (*a)->keysize, (*a)->valuesize ? datasize : 0,
+                 group);
+    wal_replay(w, replay_change, *a);
+    (*a)->log = w;
+    return (*a)->count;
+}
+
+static void replay_change(void* table, int op, void* key, void* data)
+{
+    if(op == WALINSERT){
+        find_or_insert((assoc *) table, key, data, true);
+    }
+    else{
+        assoc_remove((assoc *) table, key);
+    }
+}
+
+void assoc_checkpoint(assoc* assocs)
+{
+    if(assocs->log == NULL || assocs->slots == NULL){
+        on_error("Only a live table with a log can be checkpointed");
+    }
+    wal_checkpoint(assocs->log, collect_pairs, assocs, assocs->count,
+                   assocs->valuesize != 0, &assocs->alloc);
+}
+
+void assoc_sync(assoc* assocs)
+{
+    if(assocs->log == NULL){
+        on_error("Table has no log to sync");
+    }
+    wal_sync(assocs->log);
+}
+
+/*
+   Slots change in place, so there is nothing to share: the
+   snapshot is an O(n) copy, a frozen one owning its keys
+*/
+assoc* assoc_snapshot(assoc* assocs)
+{
+    assoc* snap;
+
+    if(assocs->slots == NULL){
+        on_error("Only a live table can be snapshotted");
+    }
+    snap = make_assoc(assocs->keysize, assocs->valuesize, &assocs->alloc);
+    release_slots(snap);
+    snap->frozen = frozen_copy(collect_pairs, assocs, assocs->count,
+                               assocs->keysize, &snap->alloc);
+    snap->count = (assoc_size) snap->frozen->count;
+    return snap;
+}
+
+/*
+   The smaller table's keys are the ones probed, so the work
+   is proportional to the smaller of the two
+*/
+assoc* assoc_intersect(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    if(b->count < a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = sized_set(a->keysize, a->count);
+    sets_probe_into(&set_ops, out, a, a->count, b, true, &a->alloc);
+    return out;
+}
+
+assoc* assoc_union(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    if(b->count > a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = sized_set(a->keysize, (size_t) a->count + b->count);
+    sets_add_all(&set_ops, out, a, a->count, &a->alloc);
+    sets_probe_into(&set_ops, out, b, b->count, a, false, &b->alloc);
+    return out;
+}
+
+assoc* assoc_difference(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    out = sized_set(a->keysize, a->count);
+    sets_probe_into(&set_ops, out, a, a->count, b, false, &a->alloc);
+    return out;
+}
+
+/*
+   Growing an empty table costs next to nothing, and
+   afterwards filling it never has to grow it again
+*/
+static assoc* sized_set(size_t keysize, size_t n)
+{
+    assoc* out;
+
+    out = make_assoc(keysize, 0, NULL);
+    while(assoc_capacity(out) < n){
+        expand_assoc(out);
+    }
+    return out;
+}
+
+/*
+   Both nests of every key are prefetched before any of them
+   is probed, so the batch's cache misses overlap rather than
+   each waiting for the one before
+*/
+static void probe_batch(void* table, void** keys, int n, int* found)
+{
+    assoc *against;
+    assoc_size nests_a[SETBATCH], nests_b[SETBATCH];
+    unsigned long hash;
+    int k;
+
+    against = (assoc *) table;
+    if(SMALL(against)){
+        for(k = 0; k < n; k += 1){
+            found[k] = small_find(against, keys[k]) != NOTFOUND;
         }
+        return;
+    }
+    for(k = 0; k < n; k += 1){
+        hash = hash_key(against->keysize, keys[k]);
+        nests_a[k] = NESTA(hash, against->length);
+        nests_b[k] = nests_a[k] ^ NESTXOR(hash, against->length);
+        PREFETCH(&against->slots[(size_t) nests_a[k] * against->slotsize]);
+        PREFETCH(&against->slots[(size_t) nests_b[k] * against->slotsize]);
     }
+    for(k = 0; k < n; k += 1){
+        found[k] = (against->ctrl[nests_a[k]] == SLOTFULL &&
+                    key_equal(against, nests_a[k], keys[k])) ||
+                   (against->ctrl[nests_b[k]] == SLOTFULL &&
+                    key_equal(against, nests_b[k], keys[k]));
+    }
+}
+
+static void add_key(void* out, void* key)
+{
+    find_or_insert((assoc *) out, key, NULL, true);
+}
+
+double assoc_compact_bytes(assoc* assocs)
+{
+    return compact_bytes_per_key(assocs->compact);
+}
+
+double assoc_frozen_bits(assoc* assocs)
+{
+    return frozen_bits_per_key(assocs->frozen);
+}
+
+void assoc_filter(assoc* assocs, int bits)
+{
+    bloom_free(assocs->filter);
+    assocs->filter = NULL;
+    assocs->filter_bits = bits;
+    if(bits > 0){
+        filter_build(assocs);
+    }
+}
+
+double assoc_filter_fpr(assoc* assocs)
+{
+    return bloom_fpr(assocs->filter);
+}
+
+/*
+   Sized for the most keys the table holds before its
+   next resize, so the filter is rebuilt on each resize.
+   A read-only table never grows, so size it for its keys.
+*/
+static void filter_build(assoc* assocs)
+{
+    bloom_free(assocs->filter);
+    assocs->filter = bloom_build(collect_pairs, assocs, assoc_capacity(assocs),
+                                 assocs->filter_bits, assocs->keysize,
+                                 &assocs->alloc);
 }
 
-static void expand_general(assoc* assocs, void **old_values,
-                                 void *old_keys, int old_length)
+static size_t slot_size(size_t keysize, size_t valuesize)
 {
-    char *buffer;
-    int index, memory_index, full_keysize;
+    size_t aligned;
 
-    memset(assocs->keys, 0, assocs->keysize * assocs->length);
-    full_keysize = assocs->keysize * assocs->length;
-    memset(assocs->keys, 0, full_keysize);
+    /* Special case of (char *) */
+    if(keysize == 0){
+        keysize = sizeof(char *);
+    }
+    if(valuesize == 0){
+        return keysize;
+    }
+    aligned = (keysize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    return valuesize + aligned;
+}
 
-    buffer = (char *) old_keys;
+/*
+   An expired pair in a cache is evicted as it is found
+   and reported missing; otherwise it's marked as used
+*/
+static void* found_data(assoc* assocs, assoc_size index, void* key)
+{
+    if(assocs->cache != NULL && !cache_touch(&SLOTCACHE(assocs, index))){
+        remove_slot(assocs, index);
+        return NULL;
+    }
+    if(assocs->valuesize == 0){
+        return key;
+    }
+    return SLOTVALUE(assocs, index);
+}
+/*
+   String keys are moved across as pointers, not cloned
+   again, since the old slots are about to be freed.
+*/
+static void expand_slots(assoc* assocs, char *old_slots,
+                         unsigned char *old_ctrl, assoc_size old_length)
+{
+    char *slot;
+    void *value, *key;
+    assoc_size index;
 
     for(index = 0; index < old_length; index += 1){
-        if(old_values[index] != NULL){
-            memory_index = index * assocs->keysize;
+        if(old_ctrl[index] == SLOTFULL){
+            slot = &old_slots[(size_t) index * assocs->slotsize];
+            value = assocs->valuesize ? *(void **) slot : NULL;
+            key = slot + assocs->valuesize;
+            if(assocs->keysize == 0){
+                key = *(char **) key;
+            }
             insert_one(
                 assocs,
-                &buffer[memory_index],
-                old_values[index],
+                key,
+                value,
                 /* Count_this = false */
                 false
             );
@@ -263,106 +871,121 @@ static void expand_general(assoc* assocs, void **old_values,
 */
 static void expand_assoc(assoc* assocs)
 {
-    void **old_values;
-    void *old_keys;
-    int old_length;
+    char *old_slots;
+    unsigned char *old_ctrl;
+    assoc_size old_length;
 
-    old_values = assocs->values;
-    old_keys = assocs->keys;
+    if(SMALL(assocs)){
+        spill(assocs);
+        return;
+    }
+    if(assocs->length > ASSOCMAX / DOUBLE){
+        on_error("Table has outgrown its index type");
+    }
+    old_slots = assocs->slots;
+    old_ctrl = assocs->ctrl;
     old_length = assocs->length;
 
-    assocs->length = assocs->length * 2;
-    assocs->values = malloc(sizeof(*assocs->values) * assocs->length);
-    memset(assocs->values, 0, sizeof(*assocs->values) * assocs->length);
-
-    if(assocs->keysize == 0){
-        assocs->keys = malloc(sizeof(char *) * assocs->length);
-        expand_strings(assocs, old_values, (char **) old_keys, old_length);
+    assocs->length = assocs->length * DOUBLE;
+    assocs->slots = mem_alloc(&assocs->alloc, (size_t) assocs->slotsize *
+                                              assocs->length);
+    assocs->ctrl = mem_alloc(&assocs->alloc, assocs->length);
+    expand_slots(assocs, old_slots, old_ctrl, old_length);
+
+    mem_free(&assocs->alloc, old_slots,
+             (size_t) assocs->slotsize * old_length);
+    mem_free(&assocs->alloc, old_ctrl, old_length);
+    if(assocs->filter != NULL){
+        filter_build(assocs);
     }
-    else{
-        assocs->keys = malloc(assocs->keysize * assocs->length);
-        expand_general(assocs, old_values, old_keys, old_length);
-    }
-    free(old_values);
-    free(old_keys);
 }
 
-static int hash_key_a(int keysize, void* key)
+/*
+   Up to SMALLMAX pairs, one after another, compared in turn:
+   cheaper than hashing the key twice over, and all of them
+   share a cache line or two with the struct. Strings are
+   told apart by their first character before strcmp().
+*/
+static assoc_size small_find(assoc* assocs, void* key)
 {
-    unsigned char* buffer;
-    int hash_a, hash_b, hash_c, index;
-    unsigned long value_a, value_b;
+    assoc_size index;
+    char *s;
 
-    if(keysize == 0){
-        keysize = strlen((char *) key);
+    if(assocs->keysize == 0){
+        s = (char *) key;
+        for(index = 0; index < assocs->count; index += 1){
+            if(SLOTSTRING(assocs, index)[0] == s[0] &&
+               strcmp(SLOTSTRING(assocs, index), s) == 0){
+                return index;
+            }
+        }
+        return NOTFOUND;
     }
-    hash_a = HASHVALUE; hash_b = 0; keysize -= keysize & 1;
-
-    buffer = (unsigned char *) key;
-    for(index = 0; index < keysize; index += 1){
-        value_a = ((unsigned int) buffer[index]) + ADDBUFFER;
-        value_b = ((int) buffer[index]);
-        hash_a *= value_a;
-        hash_b -= value_b;
+    for(index = 0; index < assocs->count; index += 1){
+        if(memcmp(SLOTKEY(assocs, index), key, assocs->keysize) == 0){
+            return index;
+        }
     }
-    hash_c = (hash_a - hash_b);
-    return hash_c < 0 ? -hash_c : hash_c;
+    return NOTFOUND;
 }
-
-static int hash_key_b(int keysize, void* key)
+/*
+   Pairs are inserted into nests with room for the one about
+   to be added, as on a resize. Only now is there any kicking
+   to do, so the spare slots are allocated here. The small
+   slots stay part of the struct's block, unused from now on.
+*/
+static void spill(assoc* assocs)
 {
-    char* buffer;
-    int hash_a, hash_b, hash_c, index;
-    unsigned long value_a, value_b;
+    char *small;
+    unsigned char *ctrl;
+    assoc_size length;
 
-    if(keysize == 0){
-        keysize = strlen((char *) key);
+    small = assocs->slots;
+    ctrl = assocs->ctrl;
+    length = assocs->length;
+    assocs->length = SIZE;
+    while(assocs->length / RESIZE <= SMALLMAX){
+        assocs->length *= DOUBLE;
     }
-    hash_a = HASHVALUE; hash_b = 0; keysize -= keysize & HASHVALUE;
-
-    buffer = (char *) key;
-    for(index = 0; index < keysize; index += 2){
-        value_a = (int) (buffer[index + 0] ^ buffer[index + ADDONE]);
-        value_b = (int) (buffer[index + 0] - buffer[index + ADDONE]);
-        hash_a *= value_a;
-        hash_b -= value_b;
+    assocs->slots = mem_alloc(&assocs->alloc, (size_t) assocs->slotsize *
+                                              assocs->length);
+    assocs->ctrl = mem_alloc(&assocs->alloc, assocs->length);
+    assocs->spare = mem_alloc(&assocs->alloc, assocs->slotsize * SPARES);
+    expand_slots(assocs, small, ctrl, length);
+    if(assocs->filter != NULL){
+        filter_build(assocs);
     }
-    hash_c = (hash_a ^ hash_b);
-    return hash_c < 0 ? -hash_c : hash_c;
 }
 
 static void insert_string(assoc* assocs, char* key,
-                              int index, int copy_this)
+                              assoc_size index, int copy_this)
 {
-    char **string_keys;
-    string_keys = (char **) assocs->keys;
-
-    if(copy_this){
-        string_keys[index] = clone_string(key);
+    if(copy_this && !assocs->borrowed){
+        SLOTSTRING(assocs, index) = mem_strdup(&assocs->alloc, key);
     }
     else{
-        string_keys[index] = key;
+        SLOTSTRING(assocs, index) = key;
     }
 }
 
-static void insert_general(assoc* assocs, void* key, int index)
+static void insert_general(assoc* assocs, void* key, assoc_size index)
 {
-    char *buffer;
-    int memory_index;
-
-    buffer = (char *) assocs->keys;
-    memory_index = index * assocs->keysize;
-
-    memcpy(&buffer[memory_index], key, assocs->keysize);
+    memcpy(SLOTKEY(assocs, index), key, assocs->keysize);
 }
 
 static void insert_one_index(assoc* assocs, void* key,
-                             void* value, int index, int count_this)
+                             void* value, assoc_size index, int count_this)
 {
     if(count_this){
         assocs->count += ADDONE;
+        if(assocs->filter != NULL){
+            bloom_add(assocs->filter, hash_key(assocs->keysize, key));
+        }
     }
-    assocs->values[index] = value;
+    if(assocs->valuesize){
+        SLOTVALUE(assocs, index) = value;
+    }
+    assocs->ctrl[index] = SLOTFULL;
 
     if(assocs->keysize == 0){
         insert_string(assocs, key, index, count_this);
@@ -377,111 +1000,261 @@ static void insert_one_index(assoc* assocs, void* key,
    newer arrays. These insertions in "expand_assoc" should
    not be counted.
 */
-static void insert_one(assoc* assocs, void* key, void* value,
-                       int count_this)
+static assoc_size insert_one(assoc* assocs, void* key, void* value,
+                      int count_this)
 {
-    int index_a, index_b;
-    index_a = hash_key_a(assocs->keysize, key) % assocs->length;
+    assoc_size index_a, index_b;
+    unsigned long hash;
 
-    if(assocs->values[index_a] == NULL){
-        insert_one_index(assocs, key, value, index_a, count_this);
-        return;
+    if(SMALL(assocs)){
+        spill(assocs);
     }
+    hash = hash_key(assocs->keysize, key);
+    index_a = NESTA(hash, assocs->length);
+    index_b = index_a ^ NESTXOR(hash, assocs->length);
+    return insert_nests(assocs, key, value, count_this,
+                        index_a, index_b);
+}
 
-    index_b = hash_key_b(assocs->keysize, key) % assocs->length;
+static assoc_size insert_nests(assoc* assocs, void* key, void* value,
+                        int count_this, assoc_size index_a,
+                               assoc_size index_b)
+{
+    unsigned long hash;
 
-    if(assocs->values[index_b] == NULL){
-        insert_one_index(assocs, key, value, index_b, count_this);
-        return;
+    while(true){
+        if(assocs->ctrl[index_a] == SLOTEMPTY){
+            insert_one_index(assocs, key, value, index_a, count_this);
+            return index_a;
+        }
+        if(assocs->ctrl[index_b] == SLOTEMPTY){
+            insert_one_index(assocs, key, value, index_b, count_this);
+            return index_b;
+        }
+        /* At this point, both indexes are occupied. Kick one
+           index away from its nest, like a cuckoo does */
+        if(kick_out(assocs, index_b)){
+            insert_one_index(assocs, key, value, index_b, count_this);
+            return index_b;
+        }
+        /* The table grew while kicking, so the nests moved */
+        hash = hash_key(assocs->keysize, key);
+        index_a = NESTA(hash, assocs->length);
+        index_b = index_a ^ NESTXOR(hash, assocs->length);
     }
-    /* At this point, both indexes are occupied. Kick one
-       index away from its nest, like a cuckoo does */
-    kick_out(assocs, index_b);
-    insert_one_index(assocs, key, value, index_b, count_this);
 }
 
-static void kick_out_string(assoc* assocs, int index_m)
+static bool key_equal(assoc* assocs, assoc_size index, void* key)
 {
-    char **string_keys;
-    int index_a, index_b, index_n;
-
-    string_keys = (char **) assocs->keys;
-
-    index_a = hash_key_a(assocs->keysize,
-                         string_keys[index_m]) % assocs->length;
-    index_b = hash_key_b(assocs->keysize,
-                         string_keys[index_m]) % assocs->length;
-
-    index_n = index_a == index_m ? index_b : index_a;
-    /* The other index is also occupied! */
-    if(assocs->values[index_n] != NULL){
-    /* Commenting this out leads to a memory leak. This
-       was leading to an infinite but not anymore.
-       kick_out_string(assocs, index_n) */
+    if(assocs->keysize == 0){
+        return strcmp(SLOTSTRING(assocs, index), (char *) key) == 0;
     }
-    /* Kicks the value out of its nest into somewhere else */
-    string_keys[index_n] = string_keys[index_m];
-    assocs->values[index_n] = assocs->values[index_m];
-
-    string_keys[index_m] = NULL;
-    assocs->values[index_m] = NULL;
+    return memcmp(SLOTKEY(assocs, index), key, assocs->keysize) == 0;
 }
 
-static void kick_out_general(assoc* assocs, int index_m)
+static void* slot_key(assoc* assocs, char* slot)
 {
-    char *buffer;
-    int index_a, index_b, index_n, memory_index_m, memory_index_n;
-
-    buffer = (char *) assocs->keys;
-    memory_index_m = assocs->keysize * index_m;
-
-    index_a = hash_key_a(assocs->keysize,
-                         &buffer[memory_index_m]) % assocs->length;
-    index_b = hash_key_b(assocs->keysize,
-                         &buffer[memory_index_m]) % assocs->length;
-
-    index_n = index_a == index_m ? index_b : index_a;
-    memory_index_n = assocs->keysize * index_n;
-    /* The other index is also occupied */
-    if(assocs->values[index_n] != NULL){
-        kick_out_general(assocs, index_n);
+    if(assocs->keysize == 0){
+        return *(char **) (slot + assocs->valuesize);
     }
-    /* Kicks the value out of its nest into somewhere else */
-    memcpy(&buffer[memory_index_n], &buffer[memory_index_m],
-           assocs->keysize);
-    assocs->values[index_n] = assocs->values[index_m];
+    return slot + assocs->valuesize;
+}
 
-    memset(&buffer[memory_index_m], 0, assocs->keysize);
-    assocs->values[index_m] = NULL;
+/* The nests are an xor apart, so one hash finds the other */
+static assoc_size other_nest(assoc* assocs, char* slot,
+                             assoc_size index)
+{
+    return index ^ NESTXOR(hash_key(assocs->keysize,
+                                    slot_key(assocs, slot)),
+                           assocs->length);
+}
+/*
+   The occupant of 'index' is lifted out and carried to its
+   other nest, evicting whoever lives there, and so on until
+   someone lands in an empty nest. A chain that is too long,
+   or that comes back for 'index', means the table is too
+   crowded: grow it and rehome the key still being carried.
+   A cache drops that key instead, carrying on a while
+   longer if need be to find one that hasn't been used.
+*/
+static bool kick_out(assoc* assocs, assoc_size index)
+{
+    char *homeless, *swap, *slot, *rehome;
+    assoc_size nest;
+    int kicks;
+
+    homeless = assocs->spare;
+    swap = assocs->spare + assocs->slotsize;
+    slot = &assocs->slots[(size_t) index * assocs->slotsize];
+    memcpy(homeless, slot, assocs->slotsize);
+    memset(slot, 0, assocs->slotsize);
+    assocs->ctrl[index] = SLOTEMPTY;
+
+    nest = index;
+    for(kicks = 0; kicks < MAXKICKS || (assocs->cache != NULL &&
+                   kicks < MAXKICKS * DOUBLE &&
+                   (CACHEWORD(homeless, assocs->slotsize, 0) & CACHEREF));
+        kicks += 1){
+        nest = other_nest(assocs, homeless, nest);
+        if(nest == index){
+            /* A cache keeps going, 'index' is for the new key */
+            if(assocs->cache != NULL){
+                continue;
+            }
+            break;
+        }
+        slot = &assocs->slots[(size_t) nest * assocs->slotsize];
+        if(assocs->ctrl[nest] == SLOTEMPTY){
+            memcpy(slot, homeless, assocs->slotsize);
+            assocs->ctrl[nest] = SLOTFULL;
+            return true;
+        }
+        /* Kicks the value out of its nest into somewhere else */
+        memcpy(swap, slot, assocs->slotsize);
+        memcpy(slot, homeless, assocs->slotsize);
+        memcpy(homeless, swap, assocs->slotsize);
+    }
+    /* A cache can't grow, but it can forget the key it carries */
+    if(assocs->cache != NULL){
+        forget_key(assocs, homeless);
+        return true;
+    }
+    /* Growing reuses the spare slots, so take a copy first */
+    rehome = mem_alloc(&assocs->alloc, assocs->slotsize);
+    memcpy(rehome, homeless, assocs->slotsize);
+    expand_assoc(assocs);
+    insert_one(assocs, slot_key(assocs, rehome),
+               assocs->valuesize ? *(void **) rehome : NULL,
+               /* count_this = false */
+               false);
+    /* It was out of the table while the filter was rebuilt */
+    if(assocs->filter != NULL){
+        bloom_add(assocs->filter,
+                  hash_key(assocs->keysize, slot_key(assocs, rehome)));
+    }
+    mem_free(&assocs->alloc, rehome, assocs->slotsize);
+    return false;
 }
 
-static void kick_out(assoc *assocs, int index)
+static assoc_size find_nest(assoc* assocs, void* key,
+                            assoc_size* index_a, assoc_size* index_b)
 {
-    if(assocs->keysize == 0){
-        kick_out_string(assocs, index);
+    unsigned long hash;
+
+    hash = hash_key(assocs->keysize, key);
+    *index_a = NESTA(hash, assocs->length);
+    *index_b = *index_a ^ NESTXOR(hash, assocs->length);
+    PREFETCH(&assocs->slots[(size_t) *index_b * assocs->slotsize]);
+    if(assocs->ctrl[*index_a] == SLOTFULL &&
+       key_equal(assocs, *index_a, key)){
+        return *index_a;
     }
-    else{
-        kick_out_general(assocs, index);
+    if(assocs->ctrl[*index_b] == SLOTFULL &&
+       key_equal(assocs, *index_b, key)){
+        return *index_b;
     }
+    return NOTFOUND;
 }
+
 /*
-static int repeated_insert(assoc* assocs, void *key,
-                           void *value, int index)
+   A small table appends new keys until it's full, then
+   spills and carries on as a hashed one
+*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite)
 {
-    char *buffer;
-    int memory_index;
+    assoc_size index, index_a, index_b;
 
-    buffer = (char *) assocs->keys;
-    memory_index = index * assocs->keysize;
+    if(assocs->slots == NULL){
+        on_error("Cannot insert into a read-only table");
+    }
+    if(SMALL(assocs)){
+        index = small_find(assocs, key);
+        if(index == NOTFOUND && assocs->count < SMALLMAX){
+            index = assocs->count;
+            insert_one_index(assocs, key, value, index, true);
+            overwrite = false;
+        }
+        if(index != NOTFOUND){
+            if(assocs->valuesize == 0){
+                return NULL;
+            }
+            if(overwrite){
+                SLOTVALUE(assocs, index) = value;
+            }
+            return &SLOTVALUE(assocs, index);
+        }
+        spill(assocs);
+    }
 
-    if(memcmp(&buffer[memory_index], key, assocs->keysize) == 0){
-        assocs->values[index] = value;
-        return true;
+    index = find_nest(assocs, key, &index_a, &index_b);
+    if(index != NOTFOUND){
+        if(assocs->cache != NULL){
+            overwrite = cache_hit(assocs->cache, &SLOTCACHE(assocs, index),
+                                  overwrite);
+        }
+        if(assocs->valuesize == 0){
+            return NULL;
+        }
+        if(overwrite){
+            SLOTVALUE(assocs, index) = value;
+        }
+        return &SLOTVALUE(assocs, index);
     }
-    return false;
-}*/
+    /* Nothing else moves when a cache evicts, so the nests hold */
+    if(assocs->cache != NULL){
+        if(assocs->count == assocs->cache->capacity){
+            remove_slot(assocs,
+                        (assoc_size) cache_victim(assocs->cache, assocs->ctrl,
+                                                  SLOTFULL, assocs->slots,
+                                                  assocs->slotsize,
+                                                  assocs->length));
+        }
+        index = insert_nests(assocs, key, value, true, index_a, index_b);
+        SLOTCACHE(assocs, index) = cache_fresh(assocs->cache);
+    }
+    /* If the array is 25% filled, resize it (log2(16))*/
+    else if(assocs->count == assocs->length / RESIZE){
+        expand_assoc(assocs);
+        index = insert_one(assocs, key, value, true);
+    }
+    else{
+        index = insert_nests(assocs, key, value, true, index_a, index_b);
+    }
+    if(assocs->valuesize == 0){
+        return NULL;
+    }
+    return &SLOTVALUE(assocs, index);
+}
+
+/* A small table stays dense: its last pair fills the gap */
+static void remove_slot(assoc* assocs, assoc_size index)
+{
+    assocs->ctrl[index] = SLOTEMPTY;
+    forget_key(assocs, &assocs->slots[(size_t) index * assocs->slotsize]);
+    if(SMALL(assocs) && index != assocs->count){
+        memcpy(&assocs->slots[(size_t) index * assocs->slotsize],
+               &assocs->slots[(size_t) assocs->count * assocs->slotsize],
+               assocs->slotsize);
+        assocs->ctrl[index] = SLOTFULL;
+        assocs->ctrl[assocs->count] = SLOTEMPTY;
+    }
+}
+
+static void forget_key(assoc* assocs, char* slot)
+{
+    if(assocs->keysize == 0 && !assocs->borrowed){
+        mem_free(&assocs->alloc, slot_key(assocs, slot),
+                 strlen((char *) slot_key(assocs, slot)) + ADDONE);
+    }
+    assocs->count -= ADDONE;
+    if(assocs->filter != NULL && assocs->cache != NULL &&
+       cache_forget(assocs->cache)){
+        filter_build(assocs);
+    }
+}
 
-/* Testing on clone_string, insert_one and expand_assoc */
+/* Testing on mem_strdup(), insert_one and expand_assoc */
 
 void assoc_test()
 {
@@ -494,29 +1267,29 @@ void assoc_test()
     char *string_p, *string_q, *string_r;
     char *string_s, *string_t, *string_v;
 
-    int old_length;
-
-    string_a = clone_string("abc");
-    string_b = clone_string("def");
-    string_c = clone_string("ghi");
-    string_d = clone_string("jkl");
-    string_e = clone_string("mno");
-    string_f = clone_string("pqr");
-    string_g = clone_string("stv");
-    string_h = clone_string("uwx");
-    string_i = clone_string("dance");
-    string_j = clone_string("woodland");
-    string_k = clone_string("wizard");
-    string_l = clone_string("lizard");
-    string_m = clone_string("fiver");
-    string_n = clone_string("household");
-    string_o = clone_string("lockdown");
-    string_p = clone_string("jumping");
-    string_q = clone_string("turkey");
-    string_r = clone_string("fireplace");
-    string_s = clone_string("snowman");
-    string_t = clone_string("dancing");
-    string_v = clone_string("whiskey");
+    assoc_size old_length;
+
+    string_a = mem_strdup(&heap_allocator, "abc");
+    string_b = mem_strdup(&heap_allocator, "def");
+    string_c = mem_strdup(&heap_allocator, "ghi");
+    string_d = mem_strdup(&heap_allocator, "jkl");
+    string_e = mem_strdup(&heap_allocator, "mno");
+    string_f = mem_strdup(&heap_allocator, "pqr");
+    string_g = mem_strdup(&heap_allocator, "stv");
+    string_h = mem_strdup(&heap_allocator, "uwx");
+    string_i = mem_strdup(&heap_allocator, "dance");
+    string_j = mem_strdup(&heap_allocator, "woodland");
+    string_k = mem_strdup(&heap_allocator, "wizard");
+    string_l = mem_strdup(&heap_allocator, "lizard");
+    string_m = mem_strdup(&heap_allocator, "fiver");
+    string_n = mem_strdup(&heap_allocator, "household");
+    string_o = mem_strdup(&heap_allocator, "lockdown");
+    string_p = mem_strdup(&heap_allocator, "jumping");
+    string_q = mem_strdup(&heap_allocator, "turkey");
+    string_r = mem_strdup(&heap_allocator, "fireplace");
+    string_s = mem_strdup(&heap_allocator, "snowman");
+    string_t = mem_strdup(&heap_allocator, "dancing");
+    string_v = mem_strdup(&heap_allocator, "whiskey");
 
     assert(strcmp(string_a, "abc") == 0);
     assert(strcmp(string_b, "def") == 0);
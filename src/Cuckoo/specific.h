@@ -1,37 +1,149 @@
+/* Backend names of its own when built into libassoc */
+#include "../Lib/rename.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <time.h>
 #include <string.h>
+#include <limits.h>
+
+#include "../Hash/hash.h"
+#include "../Bloom/bloom.h"
+#include "../Alloc/alloc.h"
+#include "../Alloc/arena.h"
+#include "../Pairs/pairs.h"
+#include "../Frozen/frozen.h"
+#include "../Compact/compact.h"
+#include "../Shm/shm.h"
+#include "../Cache/cache.h"
+#include "../Load/load.h"
+#include "../Wal/wal.h"
+#include "../Sets/sets.h"
+
+/* Tables kept in a file are Realloc's alone: no assoc_file_init() */
+#define ASSOC_NOFILE
+/* As are heavy-hitter tables: no assoc_topk_init(), assoc_topk() */
+#define ASSOC_NOTOPK
 
-/* Buffer for hashing */
-#define ADDBUFFER 3
 /* Resize is equivalent to log2(16) */
 #define RESIZE 4
-/* Comparison required for hashing */
-#define COMPARE -1
+/* No such nest */
+#define NOTFOUND ((assoc_size) -1)
+/* Longest chain of evictions before the table grows */
+#define MAXKICKS 64
+/* Scratch slots used while kicking keys between nests */
+#define SPARES 2
 /* Increase value by one */
 #define ADDONE 1
-/* Initial value for hash_a */
-#define HASHVALUE 1
+/* Doubles the length of the internal arrays */
+#define DOUBLE 2
 /*
-   This pointer is used to indicate places that had
-   elements, but are now vacant. Places that never
-   had elements have NULL pointers.
+   One control byte per slot says whether it is in use, so
+   any data (NULL included) can be stored, and sets need no
+   value at all.
 */
-#define VACANT ((void *) -1)
+#define SLOTEMPTY 0
+#define SLOTFULL 1
+/* What a read-only set stores for each key */
+#define PRESENT ((void *) 1)
 /* The assignment requires this size */
 #define SIZE 16
+/*
+   A new table is small: up to SMALLMAX pairs, kept in order
+   in slots allocated in the same block as the table itself,
+   and found by comparing keys one by one rather than by
+   hashing. The pair after that moves them out into nests of
+   their own for good.
+*/
+#define SMALLMAX 8
+/* Bytes the small slots and their control bytes take */
+#define SMALLBYTES(slotsize) (SMALLMAX * ((slotsize) + 1))
+/* The small slots, straight after the table's struct */
+#define INLINESLOTS(a) ((char *) ((a) + 1))
+/* Whether a table is still using them */
+#define SMALL(a) ((a)->slots == INLINESLOTS(a))
+
+/*
+   Each slot holds the value pointer followed by the key
+   (or, for strings, the pointer to the key), so a probe
+   touches one cache line rather than one in each of two
+   separate arrays. A set has no value pointer.
+*/
+#define SLOTVALUE(a, i) \
+    (*(void **) &(a)->slots[(size_t) (i) * (a)->slotsize])
+#define SLOTKEY(a, i) \
+    (&(a)->slots[(size_t) (i) * (a)->slotsize + (a)->valuesize])
+#define SLOTSTRING(a, i) (*(char **) SLOTKEY(a, i))
+/* In cache mode, the reference bit and expiry of slot 'i' */
+#define SLOTCACHE(a, i) CACHEWORD((a)->slots, (a)->slotsize, i)
+
+/*
+   Both nests come from one hash of the key. Lengths are
+   powers of two: the low bits pick the first nest, and the
+   high bits, made odd, are xored with it to give the second.
+   So the two never coincide, and either leads to the other.
+*/
+#define NESTA(h, len) ((assoc_size) (h) & ((len) - 1))
+#define NESTXOR(h, len) ((assoc_size) ((h) >> NESTSHIFT | 1) & ((len) - 1))
+#define NESTSHIFT 32
+
+/* Hints that memory is about to be read */
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+/*
+   Slot counts and indices. Tables known to stay small can be
+   built with -DASSOC32, which keeps them in 32 bits and makes
+   growing past 2^32 slots an error rather than a wrap.
+*/
+#ifdef ASSOC32
+typedef unsigned int assoc_size;
+#define ASSOCMAX ((assoc_size) UINT_MAX)
+#else
+typedef size_t assoc_size;
+#define ASSOCMAX ((assoc_size) -1)
+#endif
 
 typedef enum bool {false, true} bool;
 /* Structure for hashing */
 typedef struct assoc {
 
-    void **values;
-    void *keys;
+    char *slots;
+    unsigned char *ctrl;
+    size_t slotsize;
+    /* sizeof(void *), or 0 for a set */
+    size_t valuesize;
+    /* Kicking's scratch slots, NULL until the table spills */
+    char *spare;
+
+    size_t keysize;
+    /* String keys are the caller's: never copied, never freed */
+    bool borrowed;
+    /* Mapped files that borrowed keys point into */
+    wordfile *words;
+    assoc_size length;
+    assoc_size count;
+
+    /* Optional membership filter, NULL => none */
+    bloom *filter;
+    int filter_bits;
+
+    /* Read-only perfect hash copy, NULL => not frozen */
+    frozen *frozen;
+    /* Read-only front-coded copy, NULL => not compacted */
+    compact *compact;
+    /* Attached shared-memory copy, NULL => not attached */
+    shm_table *shared;
+    /* Fixed capacity and eviction state, NULL => grows as needed */
+    cache *cache;
+    /* Write-ahead log of every change, NULL => not durable */
+    wal *log;
 
-    int keysize;
-    int length;
-    int count;
+    /* Where all of the table's memory comes from */
+    assoc_allocator alloc;
 
 } assoc;
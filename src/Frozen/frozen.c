@@ -0,0 +1,331 @@
+#include <string.h>
+
+#include "frozen.h"
+#include "../Hash/hash.h"
+
+/* Bits in one word */
+#define WORDBITS (sizeof(unsigned long) * 8)
+/* A line is one rank word followed by BITWORDS words of bits */
+#define LINEWORDS 8
+#define BITWORDS (LINEWORDS - 1)
+#define LINEBITS (BITWORDS * WORDBITS)
+/*
+   Bits per remaining key at each level. 2 places ~60% of
+   the keys at every level, so lookups average ~1.6 probes
+   for ~3.7 bits per key including the rank words.
+*/
+#define GAMMA 2
+/* Top and bottom halves of a hash */
+#define HALFBITS 32
+#define HALFMASK 0xFFFFFFFFUL
+/* Mixed into the key's hash to get an independent one per level */
+#define LEVELSEED 0x9E3779B97F4A7C15UL
+
+/* Position of a key within the bit array of level 'level' */
+static unsigned long level_pos(frozen* f, unsigned long hash, int level);
+
+/* True if global bit 'bit' is set */
+static int bit_test(frozen* f, unsigned long bit);
+
+/* Number of set bits before global bit 'bit' */
+static unsigned long bit_rank(frozen* f, unsigned long bit);
+
+/* Runs the cascade, filling 'position' with each key's bit */
+static void build_levels(frozen* f, unsigned long* hashes,
+                         unsigned long* position, unsigned long* todo);
+
+/* Copies the keys and values into their dense positions */
+static void build_store(frozen* f, void** keys, void** values,
+                        unsigned long* dense);
+
+/* Value at dense index 'index' if its key is 'key', else NULL */
+static void* match(frozen* f, unsigned long index, void* key);
+
+frozen* frozen_build(void** keys, void** values, unsigned long count,
+                     size_t keysize, const assoc_allocator* al)
+{
+    frozen *f;
+    unsigned long *hashes, *position, *todo, index, rest;
+
+    f = mem_alloc(al, sizeof(*f));
+    f->alloc = *al;
+    f->count = count;
+    f->keysize = keysize;
+
+    hashes = mem_alloc(al, (count + 1) * sizeof(*hashes));
+    position = mem_alloc(al, (count + 1) * sizeof(*position));
+    todo = mem_alloc(al, (count + 1) * sizeof(*todo));
+    for(index = 0; index < count; index += 1){
+        hashes[index] = hash_key(keysize, keys[index]);
+    }
+    build_levels(f, hashes, position, todo);
+
+    /* The rank of a key's bit is its dense index */
+    for(index = 0; index < count; index += 1){
+        if(position[index] != (unsigned long) -1){
+            position[index] = bit_rank(f, position[index]);
+        }
+    }
+    /* Anything left over goes after the placed keys */
+    rest = f->placed;
+    for(index = 0; index < count; index += 1){
+        if(position[index] == (unsigned long) -1){
+            position[index] = rest;
+            rest += 1;
+        }
+    }
+    build_store(f, keys, values, position);
+
+    mem_free(al, hashes, (count + 1) * sizeof(*hashes));
+    mem_free(al, position, (count + 1) * sizeof(*position));
+    mem_free(al, todo, (count + 1) * sizeof(*todo));
+    return f;
+}
+/*
+   At each level every remaining key hashes to one bit.
+   Keys alone on their bit are placed there; keys that
+   collided try again at the next level, which is sized for
+   just them. The levels' bits are gathered into 'lines'
+   with a running rank at the start of each line.
+*/
+static void build_levels(frozen* f, unsigned long* hashes,
+                         unsigned long* position, unsigned long* todo)
+{
+    unsigned long *seen, *twice, remaining, kept, index, pos, total;
+    unsigned long line, words, rank;
+    size_t bytes;
+    int level, word;
+
+    remaining = f->count;
+    for(index = 0; index < f->count; index += 1){
+        todo[index] = index;
+        position[index] = (unsigned long) -1;
+    }
+    total = 0;
+    f->levels = 0;
+    for(level = 0; level < MAXLEVELS && remaining > 0; level += 1){
+        f->level_start[level] = total;
+        f->level_size[level] = (GAMMA * remaining + WORDBITS - 1) /
+                               WORDBITS * WORDBITS;
+        f->levels = level + 1;
+        words = f->level_size[level] / WORDBITS;
+        bytes = words * sizeof(unsigned long);
+        seen = mem_alloc(&f->alloc, bytes);
+        twice = mem_alloc(&f->alloc, bytes);
+
+        for(index = 0; index < remaining; index += 1){
+            pos = level_pos(f, hashes[todo[index]], level);
+            if(seen[pos / WORDBITS] & (1UL << (pos % WORDBITS))){
+                twice[pos / WORDBITS] |= 1UL << (pos % WORDBITS);
+            }
+            seen[pos / WORDBITS] |= 1UL << (pos % WORDBITS);
+        }
+        kept = 0;
+        for(index = 0; index < remaining; index += 1){
+            pos = level_pos(f, hashes[todo[index]], level);
+            if(twice[pos / WORDBITS] & (1UL << (pos % WORDBITS))){
+                todo[kept] = todo[index];
+                kept += 1;
+            }
+            else{
+                position[todo[index]] = total + pos;
+            }
+        }
+        mem_free(&f->alloc, seen, bytes);
+        mem_free(&f->alloc, twice, bytes);
+        total += f->level_size[level];
+        remaining = kept;
+    }
+
+    f->nlines = total / LINEBITS + 1;
+    f->lines = mem_alloc(&f->alloc,
+                         f->nlines * LINEWORDS * sizeof(unsigned long));
+    for(index = 0; index < f->count; index += 1){
+        pos = position[index];
+        if(pos != (unsigned long) -1){
+            line = pos / LINEBITS;
+            f->lines[line * LINEWORDS + 1 + (pos % LINEBITS) / WORDBITS]
+                |= 1UL << (pos % WORDBITS);
+        }
+    }
+    rank = 0;
+    for(line = 0; line < f->nlines; line += 1){
+        f->lines[line * LINEWORDS] = rank;
+        for(word = 1; word < LINEWORDS; word += 1){
+            rank += bits_count(f->lines[line * LINEWORDS + word]);
+        }
+    }
+    f->placed = rank;
+}
+/*
+   String keys keep their '\0' so they can be compared
+   in place with strcmp().
+*/
+static void build_store(frozen* f, void** keys, void** values,
+                        unsigned long* dense)
+{
+    unsigned long index;
+    size_t cursor, length;
+
+    f->entries = mem_alloc(&f->alloc,
+                           (f->count + 1) * sizeof(frozen_entry));
+    if(f->keysize == 0){
+        f->blobsize = 0;
+        for(index = 0; index < f->count; index += 1){
+            f->blobsize += strlen((char *) keys[index]) + 1;
+        }
+    }
+    else{
+        f->blobsize = f->count * f->keysize;
+    }
+    f->blob = mem_alloc(&f->alloc, f->blobsize + 1);
+
+    cursor = 0;
+    for(index = 0; index < f->count; index += 1){
+        f->entries[dense[index]].value = values[index];
+        if(f->keysize == 0){
+            length = strlen((char *) keys[index]) + 1;
+        }
+        else{
+            cursor = dense[index] * f->keysize;
+            length = f->keysize;
+        }
+        memcpy(&f->blob[cursor], keys[index], length);
+        f->entries[dense[index]].offset = cursor;
+        if(f->keysize == 0){
+            cursor += length;
+        }
+    }
+}
+
+frozen* frozen_copy(pairs_walk walk, void* table, unsigned long most,
+                    size_t keysize, const assoc_allocator* al)
+{
+    frozen *f;
+    pairs p;
+
+    pairs_collect(&p, walk, table, most, al);
+    f = frozen_build(p.keys, p.values, p.count, keysize, al);
+    pairs_free(&p);
+    return f;
+}
+
+void* frozen_lookup(frozen* f, void* key)
+{
+    unsigned long hash, bit, index;
+    int level;
+
+    hash = hash_key(f->keysize, key);
+    for(level = 0; level < f->levels; level += 1){
+        bit = f->level_start[level] + level_pos(f, hash, level);
+        if(bit_test(f, bit)){
+            return match(f, bit_rank(f, bit), key);
+        }
+    }
+    /* Never placed by the cascade (vanishingly rare) */
+    for(index = f->placed; index < f->count; index += 1){
+        if(match(f, index, key) != NULL){
+            return match(f, index, key);
+        }
+    }
+    return NULL;
+}
+
+void* frozen_key(frozen* f, unsigned long index)
+{
+    return &f->blob[f->entries[index].offset];
+}
+
+unsigned long frozen_walk(void* table, void** keys, void** values)
+{
+    frozen *f;
+    unsigned long index;
+
+    f = (frozen *) table;
+    for(index = 0; index < f->count; index += 1){
+        keys[index] = frozen_key(f, index);
+        values[index] = f->entries[index].value;
+    }
+    return f->count;
+}
+
+double frozen_bits_per_key(frozen* f)
+{
+    if(f == NULL || f->count == 0){
+        return 0.0;
+    }
+    return (double) (f->nlines * LINEWORDS * WORDBITS) / (double) f->count;
+}
+
+void frozen_free(frozen* f)
+{
+    assoc_allocator al;
+
+    al = f->alloc;
+    mem_free(&al, f->lines, f->nlines * LINEWORDS * sizeof(unsigned long));
+    mem_free(&al, f->entries, (f->count + 1) * sizeof(frozen_entry));
+    mem_free(&al, f->blob, f->blobsize + 1);
+    mem_free(&al, f, sizeof(*f));
+}
+
+static void* match(frozen* f, unsigned long index, void* key)
+{
+    frozen_entry *entry;
+
+    entry = &f->entries[index];
+    if(f->keysize == 0){
+        if(strcmp(&f->blob[entry->offset], (char *) key) != 0){
+            return NULL;
+        }
+    }
+    else if(memcmp(&f->blob[entry->offset], key, f->keysize) != 0){
+        return NULL;
+    }
+    return entry->value;
+}
+
+/*
+   Scaling the top half of the hash by the size avoids a
+   division; only levels of 2^32 bits or more need the '%'.
+*/
+static unsigned long level_pos(frozen* f, unsigned long hash, int level)
+{
+    unsigned long mixed, size;
+
+    mixed = hash_mix(hash + (level + 1) * LEVELSEED);
+    size = f->level_size[level];
+    if(size <= HALFMASK){
+        return ((mixed >> HALFBITS) * size) >> HALFBITS;
+    }
+    return mixed % size;
+}
+
+static int bit_test(frozen* f, unsigned long bit)
+{
+    unsigned long word;
+
+    word = f->lines[(bit / LINEBITS) * LINEWORDS + 1 +
+                    (bit % LINEBITS) / WORDBITS];
+    return (word >> (bit % WORDBITS)) & 1;
+}
+/*
+   The rank word covers every line before this one, so only
+   the words of this line up to 'bit' need counting.
+*/
+static unsigned long bit_rank(frozen* f, unsigned long bit)
+{
+    unsigned long *line, rank, within;
+    unsigned long word;
+
+    line = &f->lines[(bit / LINEBITS) * LINEWORDS];
+    within = bit % LINEBITS;
+    rank = line[0];
+    for(word = 0; word < within / WORDBITS; word += 1){
+        rank += bits_count(line[1 + word]);
+    }
+    if(within % WORDBITS != 0){
+        rank += bits_count(line[1 + within / WORDBITS] &
+                           ((1UL << (within % WORDBITS)) - 1));
+    }
+    return rank;
+}
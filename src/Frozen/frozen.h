@@ -0,0 +1,83 @@
+/*
+   A read-only table built around a minimal perfect hash
+   (BBHash style): n keys map onto the indices 0 .. n-1 with
+   no empty slots. Keys are packed back to back in one blob
+   and values sit in a dense array alongside each key's
+   offset, so a lookup is a few bit probes, one entry read and
+   one key comparison.
+*/
+
+#ifndef FROZEN_H
+#define FROZEN_H
+
+#include "../Alloc/alloc.h"
+#include "../Pairs/pairs.h"
+
+/* Levels of the cascade, keys left after the last one are rare */
+#define MAXLEVELS 32
+
+/* Where a key starts in the blob, next to its value */
+typedef struct frozen_entry {
+
+    size_t offset;
+    void *value;
+
+} frozen_entry;
+
+typedef struct frozen {
+
+    /*
+       The levels' bit arrays, concatenated and cut into
+       cache lines of one rank word and BITWORDS bit words
+    */
+    unsigned long *lines;
+    size_t nlines;
+    unsigned long level_start[MAXLEVELS];
+    unsigned long level_size[MAXLEVELS];
+    int levels;
+
+    /* Keys the cascade never placed, at the end of 'values' */
+    unsigned long placed;
+
+    unsigned long count;
+    size_t keysize;
+    char *blob;
+    size_t blobsize;
+    /* Dense array, read together so one miss gets both */
+    frozen_entry *entries;
+
+    assoc_allocator alloc;
+
+} frozen;
+
+/*
+   Builds from 'count' keys and their values. 'keysize' as
+   for assoc_init(), 0 => '\0' terminated strings. The keys
+   are copied, so the originals can be freed afterwards.
+*/
+frozen* frozen_build(void** keys, void** values, unsigned long count,
+                     size_t keysize, const assoc_allocator* al);
+
+/*
+   Builds from every pair 'walk' finds in 'table', which holds
+   at most 'most': an O(n) copy that the table can go on
+   changing under, as the array backends' snapshots are
+*/
+frozen* frozen_copy(pairs_walk walk, void* table, unsigned long most,
+                    size_t keysize, const assoc_allocator* al);
+
+/* The value stored against 'key', NULL => not found */
+void* frozen_lookup(frozen* f, void* key);
+
+/* The key at dense index 'index' (0 .. count-1) */
+void* frozen_key(frozen* f, unsigned long index);
+
+/* A pairs_walk over the frozen* 'table', i.e. every pair */
+unsigned long frozen_walk(void* table, void** keys, void** values);
+
+/* Bits of hash structure per key, excluding keys and values, 0.0 for NULL */
+double frozen_bits_per_key(frozen* f);
+
+void frozen_free(frozen* f);
+
+#endif
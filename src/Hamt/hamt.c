@@ -0,0 +1,1055 @@
+/*
+   A Hash Table, storing void pointers to a key/data pair,
+   as a hash array mapped trie: each level of the trie uses
+   HAMTBITS more bits of the key's hash, and each node keeps
+   only the children it has, found through a bitmap. Nodes
+   and leaves are reference counted and never changed while
+   shared: a writer copies the path from the root down to
+   whatever it changes and leaves the rest in place, so
+   assoc_snapshot() is just another reference to the root,
+   and a snapshot stays as it was however the table changes.
+   Fixed size keys are copied into the leaves, and string
+   keys are cloned unless the table borrows them.
+*/
+
+#include "specific.h"
+#include "../assoc.h"
+
+/*
+   Private functions:
+*/
+
+/* Shared by maps and sets, 'valuesize' 0 => set */
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc);
+
+/* A node with room for 'size' children, none set yet */
+static hamt_node* new_node(assoc* assocs, unsigned int size);
+
+/* A new leaf for 'key', counted as one more pair */
+static hamt_leaf* add_pair(assoc* assocs, void* key, unsigned long hash,
+                           void* value);
+
+/* Number of bits set in 'map' */
+static unsigned int bit_count(unsigned int map);
+
+/*
+   The node at *where, copied first if anything else shares
+   it, so it can be changed without any snapshot seeing
+*/
+static hamt_node* own_node(assoc* assocs, void** where);
+
+/* As own_node(), for the leaf at *where */
+static hamt_leaf* own_leaf(assoc* assocs, void** where);
+
+/* Drops a reference, freeing the node and its children at 0 */
+static void release_node(assoc* assocs, hamt_node* n);
+
+/* Drops a reference, freeing the leaf and its key at 0 */
+static void release_leaf(assoc* assocs, hamt_leaf* leaf);
+
+/* Drops the trie, leaving the table read-only */
+static void release_trie(assoc* assocs);
+
+/* A subtrie 'shift' bits down holding just the two leaves */
+static hamt_node* pair_node(assoc* assocs, hamt_leaf* one, hamt_leaf* two,
+                            unsigned int shift);
+
+/* Puts 'child' at 'index' of the owned node at *where */
+static hamt_node* add_child(assoc* assocs, void** where,
+                            unsigned int index, void* child);
+
+/* Takes child 'index' out of the owned node at *where */
+static hamt_node* drop_child(assoc* assocs, void** where,
+                             unsigned int index);
+
+/* The leaf holding 'key', whose hash is 'hash', or NULL */
+static hamt_leaf* find_leaf(assoc* assocs, void* key, unsigned long hash);
+
+/*
+   Single descent to the leaf for 'key'. If the key isn't
+   there it's inserted with 'value'; if it is, the value is
+   replaced only when 'overwrite' is set.
+*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite);
+
+/* The stored data of the leaf at *where, replaced if 'overwrite' */
+static void** update_leaf(assoc* assocs, void** where, void* value,
+                          bool overwrite);
+
+/*
+   Takes 'key', known to be there, out of the subtrie at
+   *where, 'shift' bits down, copying the path to it
+*/
+static void remove_key(assoc* assocs, void** where, void* key,
+                       unsigned long hash, unsigned int shift);
+
+/* Calls 'visit' on every leaf under 'n' */
+static void walk(hamt_node* n, void (*visit)(hamt_visit*, hamt_leaf*),
+                 hamt_visit* v);
+
+/* Visitors for walk(), see the functions they serve */
+static void collect_leaf(hamt_visit* v, hamt_leaf* leaf);
+static void add_leaf(hamt_visit* v, hamt_leaf* leaf);
+static void probe_leaf(hamt_visit* v, hamt_leaf* leaf);
+
+/* Fills 'keys' and 'values' from the leaves, returns the number */
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values);
+
+/* wal_replay() callback: redoes one logged change, unlogged */
+static void replay_change(void* table, int op, void* key, void* data);
+
+/* load_words() callback: inserts one word, as assoc_insert() */
+static void insert_word(void* table, char* word);
+
+/* The key held in 'leaf': for strings, the string itself */
+static void* leaf_key(assoc* assocs, hamt_leaf* leaf);
+
+/* True if the key held in 'leaf' equals 'key' */
+static bool leaf_equal(assoc* assocs, hamt_leaf* leaf, void* key);
+
+/* Sizes a new filter for the current keys and adds every one */
+static void filter_build(assoc* assocs);
+
+/*
+   Puts the keys of 'from' that are (want = true) or are not
+   (want = false) in 'against' into 'out'
+*/
+static void probe_into(assoc* out, assoc* from, assoc* against,
+                       bool want);
+
+assoc* assoc_init(size_t keysize)
+{
+    return assoc_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, sizeof(void *), alloc);
+}
+
+assoc* assoc_set_init(size_t keysize)
+{
+    return assoc_set_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_set_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, 0, alloc);
+}
+
+/* An empty table is an empty root, not NULL (that's read-only) */
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc)
+{
+    assoc* assocs;
+
+    if(alloc == NULL){
+        alloc = &heap_allocator;
+    }
+    assocs = mem_alloc(alloc, sizeof(*assocs));
+    assocs->alloc = *alloc;
+    assocs->keysize = keysize;
+    assocs->valuesize = valuesize;
+    assocs->borrowed = false;
+    assocs->words = NULL;
+    assocs->count = 0;
+    assocs->root = new_node(assocs, 0);
+    assocs->snapshot = false;
+    assocs->filter = NULL;
+    assocs->filter_bits = 0;
+    assocs->filter_keys = 0;
+    assocs->frozen = NULL;
+    assocs->compact = NULL;
+    assocs->shared = NULL;
+    assocs->log = NULL;
+
+    return assocs;
+}
+
+/*
+   Evicting would need a clock over every pair, which a trie
+   has no array for: the other backends' caches do that
+*/
+assoc* assoc_cache_init(size_t keysize, size_t capacity)
+{
+    (void) keysize;
+    (void) capacity;
+    on_error("This backend has no cache mode");
+    return NULL;
+}
+
+void assoc_cache_ttl(assoc* assocs, unsigned long ms)
+{
+    (void) assocs;
+    (void) ms;
+    on_error("Only a cache has a time to live");
+}
+
+void assoc_insert(assoc** a, void* key, void* data)
+{
+    find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+}
+
+void** assoc_upsert(assoc** a, void* key, void* data)
+{
+    void **stored;
+
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    stored = find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+    return stored;
+}
+
+/* Only a new key changes the table, so only that is logged */
+void** assoc_get_or_insert(assoc** a, void* key, void* data)
+{
+    void **stored;
+    assoc_size count;
+
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    count = (*a)->count;
+    stored = find_or_insert(*a, key, data, false);
+    if((*a)->log != NULL && (*a)->count != count){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+    return stored;
+}
+
+/* A missing key copies nothing, so it's looked for first */
+int assoc_remove(assoc* assocs, void* key)
+{
+    unsigned long hash;
+
+    if(assocs->root == NULL || assocs->snapshot){
+        on_error("Cannot remove from a read-only table");
+    }
+    hash = hash_key(assocs->keysize, key);
+    if(find_leaf(assocs, key, hash) == NULL){
+        return 0;
+    }
+    remove_key(assocs, &assocs->root, key, hash, 0);
+    assocs->count -= ADDONE;
+    if(assocs->log != NULL){
+        wal_append(assocs->log, WALREMOVE, key, NULL);
+    }
+    return 1;
+}
+
+size_t assoc_count(assoc* assocs)
+{
+    return assocs->count;
+}
+
+/*
+   A trie has no slots to fill: every new key allocates a
+   leaf, so a live one is never full and never resizes
+*/
+size_t assoc_capacity(assoc* assocs)
+{
+    /* Read-only tables never grow */
+    if(assocs->root == NULL || assocs->snapshot){
+        return assocs->count;
+    }
+    return (size_t) -1;
+}
+
+void assoc_borrow_keys(assoc* assocs)
+{
+    if(assocs->count != 0 || assocs->root == NULL || assocs->snapshot){
+        on_error("Keys can only be borrowed by an empty table");
+    }
+    assocs->borrowed = true;
+}
+
+size_t assoc_load_words(assoc** a, const char* path)
+{
+    if((*a)->keysize != 0){
+        on_error("Words can only go into a table of strings");
+    }
+    return load_words(path, insert_word, a,
+                      (*a)->borrowed ? &(*a)->words : NULL);
+}
+
+static void insert_word(void* table, char* word)
+{
+    assoc_insert((assoc **) table, word, NULL);
+}
+
+void* assoc_lookup(assoc* assocs, void* key)
+{
+    void *value;
+    hamt_leaf *leaf;
+    unsigned long hash;
+
+    /*
+       Definite miss, don't touch the table. The filter is
+       keyed on the same hash as the table, so a key that gets
+       past it isn't hashed again.
+    */
+    hash = 0;
+    if(assocs->filter != NULL){
+        hash = hash_key(assocs->keysize, key);
+        if(!bloom_maybe(assocs->filter, hash)){
+            return NULL;
+        }
+    }
+    if(assocs->frozen != NULL){
+        value = frozen_lookup(assocs->frozen, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->compact != NULL){
+        value = compact_lookup(assocs->compact, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->shared != NULL){
+        value = shm_lookup(assocs->shared, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->filter == NULL){
+        hash = hash_key(assocs->keysize, key);
+    }
+    leaf = find_leaf(assocs, key, hash);
+    if(leaf == NULL){
+        return NULL;
+    }
+    return assocs->valuesize ? leaf->value : key;
+}
+
+/*
+   One more reference to the root and a table to hold it:
+   the writer copies any node it would change from now on,
+   rather than change it. The snapshot shares the table's
+   keys, so a table borrowing them (or replaying them from a
+   log) must outlive its snapshots. It has no filter or log.
+*/
+assoc* assoc_snapshot(assoc* assocs)
+{
+    assoc* snap;
+
+    if(assocs->root == NULL){
+        on_error("Only a live table can be snapshotted");
+    }
+    snap = mem_alloc(&assocs->alloc, sizeof(*snap));
+    *snap = *assocs;
+    snap->snapshot = true;
+    snap->words = NULL;
+    snap->filter = NULL;
+    snap->filter_bits = 0;
+    snap->filter_keys = 0;
+    snap->log = NULL;
+    INCREF(((hamt_node *) assocs->root)->refs);
+    return snap;
+}
+
+void assoc_free(assoc* assocs)
+{
+    assoc_allocator alloc;
+
+    release_trie(assocs);
+    if(assocs->frozen != NULL){
+        frozen_free(assocs->frozen);
+    }
+    if(assocs->compact != NULL){
+        compact_free(assocs->compact);
+    }
+    if(assocs->shared != NULL){
+        shm_detach(assocs->shared);
+    }
+    if(assocs->filter != NULL){
+        bloom_free(assocs->filter);
+    }
+    if(assocs->log != NULL){
+        wal_close(assocs->log);
+    }
+    wordfile_close(assocs->words);
+    alloc = assocs->alloc;
+    mem_free(&alloc, assocs, sizeof(*assocs));
+}
+
+static void release_trie(assoc* assocs)
+{
+    if(assocs->root == NULL){
+        return;
+    }
+    release_node(assocs, (hamt_node *) assocs->root);
+    assocs->root = NULL;
+}
+/*
+   Lists every key (for strings, the string itself) and
+   its value, returning how many there were. Keys of a set
+   get PRESENT, so a read-only lookup can tell they're there.
+   A read-only table is listed by its own walk.
+*/
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values)
+{
+    assoc* assocs;
+    hamt_visit v;
+
+    assocs = (assoc *) table;
+    if(assocs->frozen != NULL){
+        return frozen_walk(assocs->frozen, keys, values);
+    }
+    if(assocs->compact != NULL){
+        return compact_walk(assocs->compact, keys, values);
+    }
+    if(assocs->shared != NULL){
+        return shm_walk(assocs->shared, keys, values);
+    }
+    v.table = assocs;
+    v.keys = keys;
+    v.values = values;
+    v.found = 0;
+    walk((hamt_node *) assocs->root, collect_leaf, &v);
+    return v.found;
+}
+
+static void collect_leaf(hamt_visit* v, hamt_leaf* leaf)
+{
+    v->keys[v->found] = leaf_key(v->table, leaf);
+    v->values[v->found] = v->table->valuesize ? leaf->value : PRESENT;
+    v->found += 1;
+}
+/*
+   The frozen copy owns its keys, so the trie (and any
+   cloned string keys) can go straight away.
+*/
+void assoc_freeze(assoc* assocs)
+{
+    if(assocs->root == NULL || assocs->snapshot){
+        on_error("Table is already read-only");
+    }
+    assocs->frozen = frozen_copy(collect_pairs, assocs, assocs->count,
+                                 assocs->keysize, &assocs->alloc);
+    release_trie(assocs);
+}
+
+void assoc_compact(assoc* assocs)
+{
+    if(assocs->root == NULL || assocs->snapshot){
+        on_error("Table is already read-only");
+    }
+    assocs->compact = compact_copy(collect_pairs, assocs, assocs->count,
+                                   assocs->keysize, &assocs->alloc);
+    release_trie(assocs);
+}
+
+/*
+   Data is copied as 'datasize' bytes from where each value
+   points, since the pointers mean nothing in another process.
+   A snapshot can be published while the table carries on.
+*/
+void assoc_publish(assoc* assocs, const char* name, size_t datasize)
+{
+    if(assocs->root == NULL){
+        on_error("Only a live table can be published");
+    }
+    shm_publish_walk(name, collect_pairs, assocs, assocs->count,
+                     assocs->keysize, assocs->valuesize ? datasize : 0,
+                     &assocs->alloc);
+}
+
+assoc* assoc_attach(const char* name)
+{
+    assoc* assocs;
+    shm_table* t;
+
+    t = shm_attach(name);
+    assocs = make_assoc(shm_keysize(t),
+                        shm_datasize(t) ? sizeof(void *) : 0, NULL);
+    release_trie(assocs);
+    assocs->shared = t;
+    assocs->count = (assoc_size) shm_count(t);
+    return assocs;
+}
+
+int assoc_refresh(assoc* assocs)
+{
+    if(assocs->shared == NULL || !shm_refresh(assocs->shared)){
+        return 0;
+    }
+    assocs->count = (assoc_size) shm_count(assocs->shared);
+    if(assocs->filter != NULL){
+        filter_build(assocs);
+    }
+    return 1;
+}
+
+void assoc_unpublish(const char* name)
+{
+    shm_unpublish(name);
+}
+
+/*
+   Pairs are replayed through the same inserts and removes
+   as ever, but only once the log is attached do they get
+   logged, so replaying writes nothing
+*/
+size_t assoc_log(assoc** a, const char* path, size_t datasize,
+                 unsigned int group)
+{
+    wal* w;
+
+    if((*a)->root == NULL || (*a)->snapshot || (*a)->count != 0 ||
+       (*a)->log != NULL){
+        on_error("Only an empty live table can start a log");
+    }
+    w = wal_open(path, (*a)->keysize, (*a)->valuesize ? datasize : 0,
+                 group);
+    wal_replay(w, replay_change, *a);
+    (*a)->log = w;
+    return (*a)->count;
+}
+
+static void replay_change(void* table, int op, void* key, void* data)
+{
+    if(op == WALINSERT){
+        find_or_insert((assoc *) table, key, data, true);
+    }
+    else{
+        assoc_remove((assoc *) table, key);
+    }
+}
+
+void assoc_checkpoint(assoc* assocs)
+{
+    if(assocs->log == NULL || assocs->root == NULL){
+        on_error("Only a live table with a log can be checkpointed");
+    }
+    wal_checkpoint(assocs->log, collect_pairs, assocs, assocs->count,
+                   assocs->valuesize != 0, &assocs->alloc);
+}
+
+void assoc_sync(assoc* assocs)
+{
+    if(assocs->log == NULL){
+        on_error("Table has no log to sync");
+    }
+    wal_sync(assocs->log);
+}
+
+/*
+   The smaller table's keys are the ones probed, so the work
+   is proportional to the smaller of the two. Either table
+   may be a snapshot, so a set operation can run against a
+   fixed version of a table that's still being written.
+*/
+assoc* assoc_intersect(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->root != NULL && b->root != NULL, a->keysize, b->keysize);
+    if(b->count < a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = make_assoc(a->keysize, 0, NULL);
+    probe_into(out, a, b, true);
+    return out;
+}
+
+assoc* assoc_union(assoc* a, assoc* b)
+{
+    assoc *out;
+    hamt_visit v;
+
+    sets_check(a->root != NULL && b->root != NULL, a->keysize, b->keysize);
+    if(b->count > a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = make_assoc(a->keysize, 0, NULL);
+    v.table = a;
+    v.out = out;
+    walk((hamt_node *) a->root, add_leaf, &v);
+    probe_into(out, b, a, false);
+    return out;
+}
+
+assoc* assoc_difference(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->root != NULL && b->root != NULL, a->keysize, b->keysize);
+    out = make_assoc(a->keysize, 0, NULL);
+    probe_into(out, a, b, false);
+    return out;
+}
+
+static void add_leaf(hamt_visit* v, hamt_leaf* leaf)
+{
+    find_or_insert(v->out, leaf_key(v->table, leaf), NULL, true);
+}
+
+/*
+   A trie has no slots to prefetch ahead of time, so unlike
+   the other backends the keys are probed one at a time,
+   each with the hash its leaf already holds
+*/
+static void probe_into(assoc* out, assoc* from, assoc* against,
+                       bool want)
+{
+    hamt_visit v;
+
+    v.table = from;
+    v.out = out;
+    v.against = against;
+    v.want = want;
+    walk((hamt_node *) from->root, probe_leaf, &v);
+}
+
+static void probe_leaf(hamt_visit* v, hamt_leaf* leaf)
+{
+    void* key;
+
+    key = leaf_key(v->table, leaf);
+    if((find_leaf(v->against, key, leaf->hash) != NULL) == v->want){
+        find_or_insert(v->out, key, NULL, true);
+    }
+}
+
+double assoc_compact_bytes(assoc* assocs)
+{
+    return compact_bytes_per_key(assocs->compact);
+}
+
+double assoc_frozen_bits(assoc* assocs)
+{
+    return frozen_bits_per_key(assocs->frozen);
+}
+
+void assoc_filter(assoc* assocs, int bits)
+{
+    bloom_free(assocs->filter);
+    assocs->filter = NULL;
+    assocs->filter_bits = bits;
+    if(bits > 0){
+        filter_build(assocs);
+    }
+}
+
+double assoc_filter_fpr(assoc* assocs)
+{
+    return bloom_fpr(assocs->filter);
+}
+
+/*
+   A trie never resizes, so the filter is sized for twice
+   the keys there are now, and rebuilt once there are more.
+   A read-only table never grows, so size it for its keys.
+*/
+static void filter_build(assoc* assocs)
+{
+    if(assocs->root == NULL){
+        assocs->filter_keys = assocs->count;
+    }
+    else{
+        assocs->filter_keys = assocs->count < SIZE / 2 ? SIZE
+                                                       : assocs->count * 2;
+    }
+    bloom_free(assocs->filter);
+    assocs->filter = bloom_build(collect_pairs, assocs, assocs->filter_keys,
+                                 assocs->filter_bits, assocs->keysize,
+                                 &assocs->alloc);
+}
+
+static hamt_node* new_node(assoc* assocs, unsigned int size)
+{
+    hamt_node* n;
+
+    n = mem_alloc(&assocs->alloc, NODEBYTES(size));
+    n->refs = 1;
+    n->bitmap = 0;
+    n->leaves = 0;
+    n->size = size;
+    return n;
+}
+
+static hamt_leaf* add_pair(assoc* assocs, void* key, unsigned long hash,
+                           void* value)
+{
+    hamt_leaf* leaf;
+
+    if(assocs->count == ASSOCMAX){
+        on_error("Table has outgrown its index type");
+    }
+    leaf = mem_alloc(&assocs->alloc, LEAFBYTES(assocs->keysize));
+    leaf->refs = 1;
+    leaf->hash = hash;
+    leaf->value = value;
+    if(assocs->keysize == 0){
+        if(assocs->borrowed){
+            LEAFSTRING(leaf) = (char *) key;
+        }
+        else{
+            LEAFSTRING(leaf) = mem_strdup(&assocs->alloc, (char *) key);
+        }
+    }
+    else{
+        memcpy(LEAFKEY(leaf), key, assocs->keysize);
+    }
+    assocs->count += ADDONE;
+    /* The leaf isn't in the trie yet, so a rebuild misses it */
+    if(assocs->filter != NULL){
+        if(assocs->count > assocs->filter_keys){
+            filter_build(assocs);
+        }
+        bloom_add(assocs->filter, hash);
+    }
+    return leaf;
+}
+
+static unsigned int bit_count(unsigned int map)
+{
+#ifdef __GNUC__
+    return (unsigned int) __builtin_popcount(map);
+#else
+    map = map - ((map >> 1) & 0x55555555U);
+    map = (map & 0x33333333U) + ((map >> 2) & 0x33333333U);
+    map = (map + (map >> 4)) & 0x0F0F0F0FU;
+    return (map * 0x01010101U) >> 24;
+#endif
+}
+/*
+   Each child of the copy is shared by one more node, so
+   it too is copied if the writer comes down this way
+*/
+static hamt_node* own_node(assoc* assocs, void** where)
+{
+    hamt_node *n, *copy;
+    unsigned int index, map, bit;
+
+    n = (hamt_node *) *where;
+    if(n->refs == 1){
+        return n;
+    }
+    copy = mem_alloc(&assocs->alloc, NODEBYTES(n->size));
+    memcpy(copy, n, NODEBYTES(n->size));
+    copy->refs = 1;
+    map = n->bitmap;
+    for(index = 0; index < n->size; index += 1){
+        bit = LOWBIT(map);
+        map ^= bit;
+        if(ISLEAF(n, bit)){
+            INCREF(((hamt_leaf *) CHILDREN(n)[index])->refs);
+        }
+        else{
+            INCREF(((hamt_node *) CHILDREN(n)[index])->refs);
+        }
+    }
+    release_node(assocs, n);
+    *where = copy;
+    return copy;
+}
+
+/* Each leaf owns its clone of a string key, so that's copied too */
+static hamt_leaf* own_leaf(assoc* assocs, void** where)
+{
+    hamt_leaf *leaf, *copy;
+
+    leaf = (hamt_leaf *) *where;
+    if(leaf->refs == 1){
+        return leaf;
+    }
+    copy = mem_alloc(&assocs->alloc, LEAFBYTES(assocs->keysize));
+    memcpy(copy, leaf, LEAFBYTES(assocs->keysize));
+    copy->refs = 1;
+    if(assocs->keysize == 0 && !assocs->borrowed){
+        LEAFSTRING(copy) = mem_strdup(&assocs->alloc, LEAFSTRING(leaf));
+    }
+    release_leaf(assocs, leaf);
+    *where = copy;
+    return copy;
+}
+
+static void release_node(assoc* assocs, hamt_node* n)
+{
+    unsigned int index, map, bit;
+
+    if(DECREF(n->refs) != 0){
+        return;
+    }
+    map = n->bitmap;
+    for(index = 0; index < n->size; index += 1){
+        bit = LOWBIT(map);
+        map ^= bit;
+        if(ISLEAF(n, bit)){
+            release_leaf(assocs, (hamt_leaf *) CHILDREN(n)[index]);
+        }
+        else{
+            release_node(assocs, (hamt_node *) CHILDREN(n)[index]);
+        }
+    }
+    mem_free(&assocs->alloc, n, NODEBYTES(n->size));
+}
+
+static void release_leaf(assoc* assocs, hamt_leaf* leaf)
+{
+    if(DECREF(leaf->refs) != 0){
+        return;
+    }
+    if(assocs->keysize == 0 && !assocs->borrowed){
+        mem_free(&assocs->alloc, LEAFSTRING(leaf),
+                 strlen(LEAFSTRING(leaf)) + ADDONE);
+    }
+    mem_free(&assocs->alloc, leaf, LEAFBYTES(assocs->keysize));
+}
+/*
+   While the two hashes agree on the next HAMTBITS bits,
+   they go down another level; if they agree on them all
+   they end up side by side in a collision node
+*/
+static hamt_node* pair_node(assoc* assocs, hamt_leaf* one, hamt_leaf* two,
+                            unsigned int shift)
+{
+    hamt_node* n;
+    unsigned int first, second;
+
+    if(shift >= HASHBITS){
+        n = new_node(assocs, 2);
+        CHILDREN(n)[0] = one;
+        CHILDREN(n)[1] = two;
+        return n;
+    }
+    first = HAMTBIT(one->hash, shift);
+    second = HAMTBIT(two->hash, shift);
+    if(first == second){
+        n = new_node(assocs, 1);
+        n->bitmap = first;
+        CHILDREN(n)[0] = pair_node(assocs, one, two, shift + HAMTBITS);
+        return n;
+    }
+    n = new_node(assocs, 2);
+    n->bitmap = first | second;
+    n->leaves = first | second;
+    CHILDREN(n)[first < second ? 0 : 1] = one;
+    CHILDREN(n)[first < second ? 1 : 0] = two;
+    return n;
+}
+
+static hamt_node* add_child(assoc* assocs, void** where,
+                            unsigned int index, void* child)
+{
+    hamt_node* n;
+
+    n = (hamt_node *) *where;
+    n = mem_realloc(&assocs->alloc, n, NODEBYTES(n->size),
+                    NODEBYTES(n->size + 1));
+    memmove(&CHILDREN(n)[index + 1], &CHILDREN(n)[index],
+            (n->size - index) * sizeof(void *));
+    CHILDREN(n)[index] = child;
+    n->size += 1;
+    *where = n;
+    return n;
+}
+
+static hamt_node* drop_child(assoc* assocs, void** where,
+                             unsigned int index)
+{
+    hamt_node* n;
+
+    n = (hamt_node *) *where;
+    memmove(&CHILDREN(n)[index], &CHILDREN(n)[index + 1],
+            (n->size - index - 1) * sizeof(void *));
+    n = mem_realloc(&assocs->alloc, n, NODEBYTES(n->size),
+                    NODEBYTES(n->size - 1));
+    n->size -= 1;
+    *where = n;
+    return n;
+}
+
+static hamt_leaf* find_leaf(assoc* assocs, void* key, unsigned long hash)
+{
+    hamt_node* n;
+    hamt_leaf* leaf;
+    unsigned int shift, bit, index;
+
+    n = (hamt_node *) assocs->root;
+    for(shift = 0; shift < HASHBITS; shift += HAMTBITS){
+        bit = HAMTBIT(hash, shift);
+        if(!(n->bitmap & bit)){
+            return NULL;
+        }
+        index = bit_count(n->bitmap & (bit - 1));
+        if(n->leaves & bit){
+            leaf = (hamt_leaf *) CHILDREN(n)[index];
+            if(leaf->hash == hash && leaf_equal(assocs, leaf, key)){
+                return leaf;
+            }
+            return NULL;
+        }
+        n = (hamt_node *) CHILDREN(n)[index];
+    }
+    for(index = 0; index < n->size; index += 1){
+        leaf = (hamt_leaf *) CHILDREN(n)[index];
+        if(leaf_equal(assocs, leaf, key)){
+            return leaf;
+        }
+    }
+    return NULL;
+}
+/*
+   Every node on the way down is owned before it's looked
+   at, so whatever changes below it changes in a copy if
+   a snapshot shares it. A key already in a set changes
+   nothing, so only the path to it is copied.
+*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite)
+{
+    void **where;
+    hamt_node *n;
+    hamt_leaf *leaf, *fresh;
+    unsigned long hash;
+    unsigned int shift, bit, index;
+
+    if(assocs->root == NULL || assocs->snapshot){
+        on_error("Cannot insert into a read-only table");
+    }
+    hash = hash_key(assocs->keysize, key);
+    where = &assocs->root;
+    for(shift = 0; shift < HASHBITS; shift += HAMTBITS){
+        n = own_node(assocs, where);
+        bit = HAMTBIT(hash, shift);
+        index = bit_count(n->bitmap & (bit - 1));
+        if(!(n->bitmap & bit)){
+            fresh = add_pair(assocs, key, hash, value);
+            n = add_child(assocs, where, index, fresh);
+            n->bitmap |= bit;
+            n->leaves |= bit;
+            return assocs->valuesize ? &fresh->value : NULL;
+        }
+        if(!(n->leaves & bit)){
+            where = &CHILDREN(n)[index];
+            continue;
+        }
+        leaf = (hamt_leaf *) CHILDREN(n)[index];
+        if(leaf->hash == hash && leaf_equal(assocs, leaf, key)){
+            return update_leaf(assocs, &CHILDREN(n)[index], value,
+                               overwrite);
+        }
+        /* Two keys for one child: both go further down */
+        fresh = add_pair(assocs, key, hash, value);
+        CHILDREN(n)[index] = pair_node(assocs, leaf, fresh,
+                                       shift + HAMTBITS);
+        n->leaves &= ~bit;
+        return assocs->valuesize ? &fresh->value : NULL;
+    }
+    /* Every bit of the hash agrees, so a collision node */
+    n = own_node(assocs, where);
+    for(index = 0; index < n->size; index += 1){
+        if(leaf_equal(assocs, (hamt_leaf *) CHILDREN(n)[index], key)){
+            return update_leaf(assocs, &CHILDREN(n)[index], value,
+                               overwrite);
+        }
+    }
+    fresh = add_pair(assocs, key, hash, value);
+    add_child(assocs, where, n->size, fresh);
+    return assocs->valuesize ? &fresh->value : NULL;
+}
+
+/*
+   The data is handed back to be changed in place, so the
+   leaf is owned even when it isn't overwritten here
+*/
+static void** update_leaf(assoc* assocs, void** where, void* value,
+                          bool overwrite)
+{
+    hamt_leaf* leaf;
+
+    if(assocs->valuesize == 0){
+        return NULL;
+    }
+    leaf = own_leaf(assocs, where);
+    if(overwrite){
+        leaf->value = value;
+    }
+    return &leaf->value;
+}
+/*
+   A node left holding a single leaf is replaced by that
+   leaf on the way back up, so the trie is never deeper
+   than its keys need. The root stays, even when empty.
+*/
+static void remove_key(assoc* assocs, void** where, void* key,
+                       unsigned long hash, unsigned int shift)
+{
+    hamt_node *n, *child;
+    unsigned int bit, index;
+
+    n = own_node(assocs, where);
+    if(shift >= HASHBITS){
+        for(index = 0;
+            !leaf_equal(assocs, (hamt_leaf *) CHILDREN(n)[index], key);
+            index += 1){
+            /* It's there, so this stops */
+        }
+        release_leaf(assocs, (hamt_leaf *) CHILDREN(n)[index]);
+        drop_child(assocs, where, index);
+        return;
+    }
+    bit = HAMTBIT(hash, shift);
+    index = bit_count(n->bitmap & (bit - 1));
+    if(n->leaves & bit){
+        release_leaf(assocs, (hamt_leaf *) CHILDREN(n)[index]);
+        n = drop_child(assocs, where, index);
+        n->bitmap &= ~bit;
+        n->leaves &= ~bit;
+        return;
+    }
+    remove_key(assocs, &CHILDREN(n)[index], key, hash, shift + HAMTBITS);
+    child = (hamt_node *) CHILDREN(n)[index];
+    if(child->size == 1 && ISLEAF(child, child->bitmap)){
+        CHILDREN(n)[index] = CHILDREN(child)[0];
+        n->leaves |= bit;
+        mem_free(&assocs->alloc, child, NODEBYTES(1));
+    }
+}
+
+static void walk(hamt_node* n, void (*visit)(hamt_visit*, hamt_leaf*),
+                 hamt_visit* v)
+{
+    unsigned int index, map, bit;
+
+    map = n->bitmap;
+    for(index = 0; index < n->size; index += 1){
+        bit = LOWBIT(map);
+        map ^= bit;
+        if(ISLEAF(n, bit)){
+            visit(v, (hamt_leaf *) CHILDREN(n)[index]);
+        }
+        else{
+            walk((hamt_node *) CHILDREN(n)[index], visit, v);
+        }
+    }
+}
+
+static void* leaf_key(assoc* assocs, hamt_leaf* leaf)
+{
+    if(assocs->keysize == 0){
+        return LEAFSTRING(leaf);
+    }
+    return LEAFKEY(leaf);
+}
+
+static bool leaf_equal(assoc* assocs, hamt_leaf* leaf, void* key)
+{
+    if(assocs->keysize == 0){
+        return strcmp(LEAFSTRING(leaf), (char *) key) == 0;
+    }
+    return memcmp(LEAFKEY(leaf), key, assocs->keysize) == 0;
+}
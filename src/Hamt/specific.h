@@ -0,0 +1,174 @@
+/* Backend names of its own when built into libassoc */
+#include "../Lib/rename.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include <string.h>
+#include <limits.h>
+
+#include "../Hash/hash.h"
+#include "../Bloom/bloom.h"
+#include "../Alloc/alloc.h"
+#include "../Alloc/arena.h"
+#include "../Pairs/pairs.h"
+#include "../Frozen/frozen.h"
+#include "../Compact/compact.h"
+#include "../Shm/shm.h"
+#include "../Cache/cache.h"
+#include "../Load/load.h"
+#include "../Wal/wal.h"
+#include "../Sets/sets.h"
+
+/* This backend has no cache mode: assoc_cache_init() is an error */
+#define ASSOC_NOCACHE
+
+/* Tables kept in a file are Realloc's alone: no assoc_file_init() */
+#define ASSOC_NOFILE
+/* As are heavy-hitter tables: no assoc_topk_init(), assoc_topk() */
+#define ASSOC_NOTOPK
+
+/* Bits of the hash used at each level of the trie */
+#define HAMTBITS 5
+/* So each node has up to 2^HAMTBITS children, one bit each */
+#define HAMTMASK ((1U << HAMTBITS) - 1)
+/*
+   Bits in a hash. Keys whose hashes agree in all of them
+   share a collision node at the bottom, searched in turn.
+*/
+#define HASHBITS (sizeof(unsigned long) * CHAR_BIT)
+/* Increase value by one */
+#define ADDONE 1
+/* What a read-only set stores for each key */
+#define PRESENT ((void *) 1)
+/* Smallest number of keys a filter is sized for */
+#define SIZE 16
+
+/* The bit standing for a hash's child 'shift' bits down */
+#define HAMTBIT(hash, shift) (1U << (((hash) >> (shift)) & HAMTMASK))
+/* Lowest bit set in a bitmap, 0 if none */
+#define LOWBIT(map) ((map) & (~(map) + 1U))
+/* A node's children follow it, in the order of their bits */
+#define CHILDREN(n) ((void **) ((n) + 1))
+#define NODEBYTES(size) (sizeof(hamt_node) + (size_t) (size) * sizeof(void *))
+/*
+   Whether the child for 'bit' is a leaf rather than a node:
+   a collision node (no bitmap) only ever has leaves
+*/
+#define ISLEAF(n, bit) ((n)->bitmap == 0 || ((n)->leaves & (bit)))
+/* A leaf's key follows it: the bytes, or a pointer to the string */
+#define LEAFKEY(l) ((char *) ((l) + 1))
+#define LEAFSTRING(l) (*(char **) LEAFKEY(l))
+#define LEAFBYTES(keysize) \
+    (sizeof(hamt_leaf) + ((keysize) ? (keysize) : sizeof(char *)))
+
+/*
+   Reference counts. A snapshot can be freed on any thread
+   while the writer carries on, so where the compiler allows,
+   they are changed atomically.
+*/
+#ifdef __GNUC__
+#define INCREF(r) ((void) __sync_add_and_fetch(&(r), 1UL))
+#define DECREF(r) __sync_sub_and_fetch(&(r), 1UL)
+#else
+#define INCREF(r) ((void) ((r) += 1))
+#define DECREF(r) ((r) -= 1)
+#endif
+
+/*
+   Pair counts. Tables known to stay small can be built with
+   -DASSOC32, which keeps them in 32 bits and makes holding
+   more than 2^32 pairs an error rather than a wrap.
+*/
+#ifdef ASSOC32
+typedef unsigned int assoc_size;
+#define ASSOCMAX ((assoc_size) UINT_MAX)
+#else
+typedef size_t assoc_size;
+#define ASSOCMAX ((assoc_size) -1)
+#endif
+
+typedef enum bool {false, true} bool;
+
+/*
+   An inner node: bit b of 'bitmap' is set when there is a
+   child for the hash bits b, and the same bit of 'leaves'
+   when that child is a leaf. A collision node has neither,
+   just 'size' leaves whose hashes are equal.
+*/
+typedef struct hamt_node {
+
+    /* Parents (and tables, for a root) pointing at it */
+    unsigned long refs;
+    unsigned int bitmap;
+    unsigned int leaves;
+    /* Children following the node */
+    unsigned int size;
+
+} hamt_node;
+
+/* One pair, followed by its key */
+typedef struct hamt_leaf {
+
+    unsigned long refs;
+    unsigned long hash;
+    void *value;
+
+} hamt_leaf;
+
+/* Structure for hashing */
+typedef struct assoc {
+
+    /*
+       The trie, a hamt_node (void * like any child, so it's
+       path-copied the same way). NULL => read-only copy,
+       as in the other backends' slots.
+    */
+    void *root;
+    /* Taken by assoc_snapshot(), so never changes */
+    bool snapshot;
+    /* sizeof(void *), or 0 for a set */
+    size_t valuesize;
+
+    size_t keysize;
+    /* String keys are the caller's: never copied, never freed */
+    bool borrowed;
+    /* Mapped files that borrowed keys point into */
+    wordfile *words;
+    assoc_size count;
+
+    /* Optional membership filter, NULL => none */
+    bloom *filter;
+    int filter_bits;
+    /* Keys it was sized for, rebuilt once there are more */
+    assoc_size filter_keys;
+
+    /* Read-only perfect hash copy, NULL => not frozen */
+    frozen *frozen;
+    /* Read-only front-coded copy, NULL => not compacted */
+    compact *compact;
+    /* Attached shared-memory copy, NULL => not attached */
+    shm_table *shared;
+    /* Write-ahead log of every change, NULL => not durable */
+    wal *log;
+
+    /* Where all of the table's memory comes from */
+    assoc_allocator alloc;
+
+} assoc;
+
+/* What a walk over the leaves carries along, see walk() */
+typedef struct hamt_visit {
+
+    assoc *table;
+    /* collect_pairs() fills these in */
+    void **keys;
+    void **values;
+    unsigned long found;
+    /* The set operations put keys into 'out' */
+    assoc *out;
+    assoc *against;
+    bool want;
+
+} hamt_visit;
@@ -0,0 +1,108 @@
+#include "hash.h"
+
+/* Odd constants from the golden ratio and MurmurHash3 */
+#define HASHSEED 0x9E3779B97F4A7C15UL
+#define HASHMUL 0xFF51AFD7ED558CCDUL
+#define HASHFINAL 0xC4CEB93C185EC53UL
+/* Shifts used when folding the high bits back down */
+#define SHIFTFOLD 33
+#define SHIFTWORD 29
+/* Payload bits in each byte of a varint */
+#define VARINTBITS 7
+#define VARINTMASK 0x7F
+
+unsigned long hash_mix(unsigned long h)
+{
+    h ^= h >> SHIFTFOLD;
+    h *= HASHMUL;
+    h ^= h >> SHIFTFOLD;
+    h *= HASHFINAL;
+    h ^= h >> SHIFTFOLD;
+    return h;
+}
+/*
+   Reads the key a word at a time rather than a byte
+   at a time, so long keys cost len / 8 multiplies.
+*/
+unsigned long hash_bytes(const void* key, size_t len)
+{
+    const unsigned char *buffer;
+    unsigned long hash, word;
+
+    buffer = (const unsigned char *) key;
+    hash = HASHSEED ^ ((unsigned long) len * HASHMUL);
+
+    while(len >= sizeof(word)){
+        memcpy(&word, buffer, sizeof(word));
+        hash = (hash ^ word) * HASHMUL;
+        hash ^= hash >> SHIFTWORD;
+        buffer += sizeof(word);
+        len -= sizeof(word);
+    }
+    if(len > 0){
+        word = 0;
+        memcpy(&word, buffer, len);
+        hash = (hash ^ word) * HASHMUL;
+    }
+    return hash_mix(hash);
+}
+
+unsigned long hash_string(const char* key)
+{
+    return hash_bytes(key, strlen(key));
+}
+
+unsigned long hash_key(size_t keysize, const void* key)
+{
+    if(keysize == 0){
+        return hash_string((const char *) key);
+    }
+    return hash_bytes(key, keysize);
+}
+
+int bits_count(unsigned long word)
+{
+#ifdef __GNUC__
+    return __builtin_popcountl(word);
+#else
+    int count;
+
+    count = 0;
+    while(word != 0){
+        word &= word - 1;
+        count += 1;
+    }
+    return count;
+#endif
+}
+
+size_t varint_put(unsigned char* out, unsigned long value)
+{
+    size_t used;
+
+    used = 0;
+    while(value > VARINTMASK){
+        out[used] = (unsigned char) ((value & VARINTMASK) | VARINTMORE);
+        value >>= VARINTBITS;
+        used += 1;
+    }
+    out[used] = (unsigned char) value;
+    return used + 1;
+}
+
+unsigned long varint_get(const unsigned char** in)
+{
+    unsigned long value;
+    int shift;
+
+    value = 0;
+    shift = 0;
+    while(**in & VARINTMORE){
+        value |= (unsigned long) (**in & VARINTMASK) << shift;
+        shift += VARINTBITS;
+        *in += 1;
+    }
+    value |= (unsigned long) **in << shift;
+    *in += 1;
+    return value;
+}
@@ -0,0 +1,48 @@
+/*
+   General purpose hashing of keys, shared by the
+   tables and the structures built on top of them.
+   Hashes are 'unsigned long' (64 bits on the machines
+   we care about), never reduced with abs(). Also the
+   few bit-level helpers those structures have in
+   common: counting set bits, and varints.
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Hash 'len' bytes starting at 'key' */
+unsigned long hash_bytes(const void* key, size_t len);
+
+/* Hash a '\0' terminated string */
+unsigned long hash_string(const char* key);
+
+/*
+   Hash of a table key: 'keysize' bytes, or for 'keysize' 0,
+   a '\0' terminated string
+*/
+unsigned long hash_key(size_t keysize, const void* key);
+
+/* Scrambles the bits of 'h', used to derive further hashes */
+unsigned long hash_mix(unsigned long h);
+
+/* Number of bits set in 'word' */
+int bits_count(unsigned long word);
+
+/*
+   Varints carry 7 bits per byte, low bits first, and a
+   set top bit means another byte follows
+*/
+#define VARINTMORE 0x80
+/* Longest varint of an unsigned long */
+#define VARINTMAX 10
+
+/* Writes 'value' as a varint to 'out', returns the bytes used */
+size_t varint_put(unsigned char* out, unsigned long value);
+
+/* Reads a varint, advancing '*in' past it */
+unsigned long varint_get(const unsigned char** in);
+
+#endif
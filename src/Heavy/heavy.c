@@ -0,0 +1,332 @@
+#include <string.h>
+#include <limits.h>
+
+#include "heavy.h"
+#include "../../../ADTs/General/general.h"
+
+/* Slots in the index per candidate, at least */
+#define INDEXSLACK 2
+/* The high half of a hash steps between the sketch's rows */
+#define HALFBITS (sizeof(unsigned long) * CHAR_BIT / 2)
+/* No such entry */
+#define NOENTRY ((unsigned long) -1)
+/* Heap children and parent of place 'p' */
+#define LEFT(p) (2 * (p) + 1)
+#define PARENT(p) (((p) - 1) / 2)
+
+/* Smallest power of two of at least 'n' */
+static unsigned long power_of_two(unsigned long n);
+
+/*
+   Adds one to the key's counters in each row, or rather to
+   those at its minimum, and returns its new estimate
+*/
+static unsigned long sketch_add(heavy* h, unsigned long hash);
+
+/* The entry holding 'key', or NOENTRY */
+static unsigned long find_entry(heavy* h, const void* key,
+                                unsigned long hash);
+
+/* True if entry 'e' holds 'key' */
+static int entry_equal(heavy* h, unsigned long e, const void* key);
+
+/* Makes entry 'e' the candidate for 'key', indexed */
+static void fill_entry(heavy* h, unsigned long e, const void* key,
+                       unsigned long hash, unsigned long count);
+
+/* Takes entry 'e' out of the index, freeing its key */
+static void empty_entry(heavy* h, unsigned long e);
+
+/* Moves the entry at heap place 'p' up while its count is less */
+static void sift_up(heavy* h, unsigned long p);
+
+/* Moves the entry at heap place 'p' down while its count is more */
+static void sift_down(heavy* h, unsigned long p);
+
+/* Puts entry 'e' at heap place 'p' */
+static void place_entry(heavy* h, unsigned long p, unsigned long e);
+
+/* qsort() order for heavy_top(): highest count first */
+static int by_count(const void* a, const void* b);
+
+heavy* heavy_init(size_t keysize, unsigned long capacity,
+                  const assoc_allocator* al)
+{
+    heavy* h;
+
+    if(capacity == 0){
+        on_error("Heavy hitters need room for at least one candidate");
+    }
+    h = mem_alloc(al, sizeof(*h));
+    h->alloc = *al;
+    h->keysize = keysize;
+    h->capacity = capacity;
+    h->size = 0;
+    h->entries = mem_alloc(al, capacity * sizeof(heavy_entry));
+    h->keys = keysize ? mem_alloc(al, capacity * keysize) : NULL;
+    h->heap = mem_alloc(al, capacity * sizeof(unsigned long));
+    h->length = power_of_two(capacity * INDEXSLACK);
+    h->index = mem_alloc(al, h->length * sizeof(unsigned long));
+    h->width = power_of_two(capacity * HEAVYWIDTH);
+    h->sketch = mem_alloc(al, HEAVYDEPTH * h->width *
+                              sizeof(unsigned long));
+    h->total = 0;
+    return h;
+}
+/*
+   While there's room every key seen is a candidate, so its
+   first count is exact. Once full, a key becomes one only if
+   the sketch has seen it more often than the least candidate
+   has been counted; it then takes over that count plus one.
+   A key the sketch turned away was seen no more times than
+   that, so the new count is still never an underestimate.
+*/
+void heavy_add(heavy* h, const void* key, unsigned long hash)
+{
+    unsigned long e, estimate, least;
+
+    h->total += 1;
+    estimate = sketch_add(h, hash);
+    e = find_entry(h, key, hash);
+    if(e != NOENTRY){
+        h->entries[e].count += 1;
+        sift_down(h, h->entries[e].place);
+        return;
+    }
+    if(h->size < h->capacity){
+        e = h->size;
+        h->size += 1;
+        fill_entry(h, e, key, hash, 1);
+        place_entry(h, e, e);
+        sift_up(h, e);
+        return;
+    }
+    e = h->heap[0];
+    least = h->entries[e].count;
+    if(estimate <= least){
+        return;
+    }
+    empty_entry(h, e);
+    fill_entry(h, e, key, hash, least + 1);
+    sift_down(h, 0);
+}
+
+unsigned long heavy_count(heavy* h, const void* key, unsigned long hash)
+{
+    unsigned long e;
+
+    e = find_entry(h, key, hash);
+    return e == NOENTRY ? 0 : h->entries[e].count;
+}
+
+unsigned long heavy_size(heavy* h)
+{
+    return h->size;
+}
+
+unsigned long heavy_top(heavy* h, void** keys, unsigned long* counts,
+                        unsigned long k)
+{
+    heavy_entry** order;
+    unsigned long e;
+
+    order = mem_alloc(&h->alloc, (h->size + 1) * sizeof(heavy_entry *));
+    for(e = 0; e < h->size; e += 1){
+        order[e] = &h->entries[e];
+    }
+    qsort(order, h->size, sizeof(heavy_entry *), by_count);
+    if(k > h->size){
+        k = h->size;
+    }
+    for(e = 0; e < k; e += 1){
+        keys[e] = order[e]->key;
+        if(counts != NULL){
+            counts[e] = order[e]->count;
+        }
+    }
+    mem_free(&h->alloc, order, (h->size + 1) * sizeof(heavy_entry *));
+    return k;
+}
+
+void heavy_free(heavy* h)
+{
+    assoc_allocator alloc;
+    unsigned long e;
+
+    if(h->keysize == 0){
+        for(e = 0; e < h->size; e += 1){
+            mem_free(&h->alloc, h->entries[e].key,
+                     strlen((char *) h->entries[e].key) + 1);
+        }
+    }
+    alloc = h->alloc;
+    mem_free(&alloc, h->entries, h->capacity * sizeof(heavy_entry));
+    if(h->keys != NULL){
+        mem_free(&alloc, h->keys, h->capacity * h->keysize);
+    }
+    mem_free(&alloc, h->heap, h->capacity * sizeof(unsigned long));
+    mem_free(&alloc, h->index, h->length * sizeof(unsigned long));
+    mem_free(&alloc, h->sketch, HEAVYDEPTH * h->width *
+                                sizeof(unsigned long));
+    mem_free(&alloc, h, sizeof(*h));
+}
+
+static unsigned long power_of_two(unsigned long n)
+{
+    unsigned long p;
+
+    for(p = 1; p < n; p *= 2){
+    }
+    return p;
+}
+/*
+   Rows are picked Kirsch-Mitzenmacher style, the low half
+   of the hash plus a multiple of the high half, as in the
+   Bloom filters, so one hash serves every row
+*/
+static unsigned long sketch_add(heavy* h, unsigned long hash)
+{
+    unsigned long *cell[HEAVYDEPTH];
+    unsigned long step, least;
+    int row;
+
+    step = (hash >> HALFBITS) | 1;
+    least = (unsigned long) -1;
+    for(row = 0; row < HEAVYDEPTH; row += 1){
+        cell[row] = &h->sketch[row * h->width +
+                               ((hash + row * step) & (h->width - 1))];
+        if(*cell[row] < least){
+            least = *cell[row];
+        }
+    }
+    for(row = 0; row < HEAVYDEPTH; row += 1){
+        if(*cell[row] == least){
+            *cell[row] += 1;
+        }
+    }
+    return least + 1;
+}
+
+static unsigned long find_entry(heavy* h, const void* key,
+                                unsigned long hash)
+{
+    unsigned long slot, e;
+
+    for(slot = hash & (h->length - 1); h->index[slot] != 0;
+        slot = (slot + 1) & (h->length - 1)){
+        e = h->index[slot] - 1;
+        if(h->entries[e].hash == hash && entry_equal(h, e, key)){
+            return e;
+        }
+    }
+    return NOENTRY;
+}
+
+static int entry_equal(heavy* h, unsigned long e, const void* key)
+{
+    if(h->keysize == 0){
+        return strcmp((char *) h->entries[e].key, (const char *) key) == 0;
+    }
+    return memcmp(h->entries[e].key, key, h->keysize) == 0;
+}
+
+static void fill_entry(heavy* h, unsigned long e, const void* key,
+                       unsigned long hash, unsigned long count)
+{
+    heavy_entry* entry;
+    unsigned long slot;
+
+    entry = &h->entries[e];
+    entry->hash = hash;
+    entry->count = count;
+    if(h->keysize == 0){
+        entry->key = mem_alloc(&h->alloc, strlen((const char *) key) + 1);
+        strcpy((char *) entry->key, (const char *) key);
+    }
+    else{
+        entry->key = &h->keys[e * h->keysize];
+        memcpy(entry->key, key, h->keysize);
+    }
+    for(slot = hash & (h->length - 1); h->index[slot] != 0;
+        slot = (slot + 1) & (h->length - 1)){
+    }
+    h->index[slot] = e + 1;
+}
+/*
+   Linear probing with no tombstones: the keys after the
+   hole that could live in it move back, as in Realloc/
+*/
+static void empty_entry(heavy* h, unsigned long e)
+{
+    unsigned long hole, next, home, mask;
+
+    mask = h->length - 1;
+    for(hole = h->entries[e].hash & mask; h->index[hole] != e + 1;
+        hole = (hole + 1) & mask){
+    }
+    for(next = (hole + 1) & mask; h->index[next] != 0;
+        next = (next + 1) & mask){
+        home = h->entries[h->index[next] - 1].hash & mask;
+        if(((next - home) & mask) >= ((next - hole) & mask)){
+            h->index[hole] = h->index[next];
+            hole = next;
+        }
+    }
+    h->index[hole] = 0;
+    if(h->keysize == 0){
+        mem_free(&h->alloc, h->entries[e].key,
+                 strlen((char *) h->entries[e].key) + 1);
+    }
+}
+
+static void sift_up(heavy* h, unsigned long p)
+{
+    unsigned long e;
+
+    e = h->heap[p];
+    while(p > 0 &&
+          h->entries[h->heap[PARENT(p)]].count > h->entries[e].count){
+        place_entry(h, p, h->heap[PARENT(p)]);
+        p = PARENT(p);
+    }
+    place_entry(h, p, e);
+}
+
+/* Candidates only ever count up, so this is the usual move */
+static void sift_down(heavy* h, unsigned long p)
+{
+    unsigned long e, child;
+
+    e = h->heap[p];
+    while((child = LEFT(p)) < h->size){
+        if(child + 1 < h->size &&
+           h->entries[h->heap[child + 1]].count <
+           h->entries[h->heap[child]].count){
+            child += 1;
+        }
+        if(h->entries[h->heap[child]].count >= h->entries[e].count){
+            break;
+        }
+        place_entry(h, p, h->heap[child]);
+        p = child;
+    }
+    place_entry(h, p, e);
+}
+
+static void place_entry(heavy* h, unsigned long p, unsigned long e)
+{
+    h->heap[p] = e;
+    h->entries[e].place = p;
+}
+
+static int by_count(const void* a, const void* b)
+{
+    const heavy_entry *x, *y;
+
+    x = *(const heavy_entry * const *) a;
+    y = *(const heavy_entry * const *) b;
+    if(x->count != y->count){
+        return x->count > y->count ? -1 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+   Heavy hitters in bounded memory: the keys seen most often
+   in a stream too long to count exactly. A fixed number of
+   candidates are counted by Space-Saving (Metwally et al.):
+   once every place is taken, a new key replaces the candidate
+   with the least count, taking over that count plus one, so
+   counts only ever overestimate, by at most the least count.
+
+   In front of the candidates is a count-min sketch, a few
+   rows of counters every key adds to (conservatively: only
+   the rows at the key's minimum go up). Its least counter is
+   an overestimate of how often the key has been seen, and a
+   key only displaces a candidate once that estimate is more
+   than the candidate's count, so keys seen once or twice
+   don't keep evicting one another at the bottom.
+
+   Each key costs one hash, from which the sketch's rows and
+   the candidates' index are all derived.
+*/
+
+#ifndef HEAVY_H
+#define HEAVY_H
+
+#include <stdlib.h>
+
+#include "../Alloc/alloc.h"
+
+/* Rows of the sketch */
+#define HEAVYDEPTH 4
+/* Counters per row, per candidate (rounded up to a power of two) */
+#define HEAVYWIDTH 8
+
+typedef struct heavy_entry {
+
+    unsigned long hash;
+    /* Estimated times seen, never less than the true count */
+    unsigned long count;
+    /* Where it is in the heap */
+    unsigned long place;
+    /* The candidate's own copy of its key */
+    void *key;
+
+} heavy_entry;
+
+typedef struct heavy {
+
+    /* As for assoc_init(), 0 => strings */
+    size_t keysize;
+    unsigned long capacity;
+    unsigned long size;
+    heavy_entry *entries;
+    /* Fixed size keys, one per entry */
+    char *keys;
+    /* Entry numbers, a min-heap on their counts */
+    unsigned long *heap;
+    /* Open addressing by hash: entry number + 1, 0 => empty */
+    unsigned long *index;
+    unsigned long length;
+
+    /* HEAVYDEPTH rows of 'width' counters */
+    unsigned long *sketch;
+    unsigned long width;
+    /* Keys added, repeats included */
+    unsigned long total;
+
+    assoc_allocator alloc;
+
+} heavy;
+
+/*
+   Room for 'capacity' candidates with keys of 'keysize'
+   bytes (0 => strings), all memory coming from 'al'
+*/
+heavy* heavy_init(size_t keysize, unsigned long capacity,
+                  const assoc_allocator* al);
+
+/* Counts one more sighting of 'key', whose hash is 'hash' */
+void heavy_add(heavy* h, const void* key, unsigned long hash);
+
+/* The count of 'key' if it's a candidate, 0 if not */
+unsigned long heavy_count(heavy* h, const void* key, unsigned long hash);
+
+/* Candidates so far, at most the capacity */
+unsigned long heavy_size(heavy* h);
+
+/*
+   Fills in up to 'k' candidates with the highest counts,
+   highest first, and returns how many. 'keys' point at the
+   candidates' own copies, valid until the next heavy_add().
+   'counts' may be NULL.
+*/
+unsigned long heavy_top(heavy* h, void** keys, unsigned long* counts,
+                        unsigned long k);
+
+void heavy_free(heavy* h);
+
+#endif
@@ -0,0 +1,1017 @@
+/*
+   A Hash Table, storing void pointers to a key/data pair,
+   using hopscotch hashing: linear probing, except that no
+   key is ever more than HOPRANGE - 1 slots past its home,
+   and each home slot keeps a bitmap of where its keys are.
+   Lookups read that map and only the slots it points at, so
+   they stay short even with the table 90% full. Inserts
+   that find their nearest empty slot too far away hop it
+   back towards home, one displaced key at a time.
+   Fixed size keys are copied into the slots, and string
+   keys are cloned unless the table borrows them.
+*/
+
+#include "specific.h"
+#include "../assoc.h"
+
+/*
+   Private functions:
+*/
+
+/*
+   Bytes in one slot: with a value, the key rounded up to
+   pointer alignment; a set's keys are packed
+*/
+static size_t slot_size(size_t keysize, size_t valuesize);
+
+/* Shared by maps and sets, 'valuesize' 0 => set */
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc);
+
+/* Allocates empty slots, control bytes and maps for 'length' slots */
+static void alloc_arrays(assoc* assocs, assoc_size length);
+
+/* Frees the arrays alloc_arrays() made, keys and all left alone */
+static void free_arrays(assoc* assocs);
+
+/* The most pairs 'length' slots hold before the table grows */
+static assoc_size fill_limit(assoc_size length);
+
+/* What a lookup returns for slot 'index': its data, or for a set the key */
+static void* found_data(assoc* assocs, assoc_size index, void* key);
+
+/* Doubles the length of the internal arrays (or more, if need be) */
+static void expand_assoc(assoc* assocs);
+
+/* Index of the slot holding 'key', whose home is 'home', or NOTFOUND */
+static assoc_size find_slot(assoc* assocs, void* key, assoc_size home);
+
+/*
+   An empty slot within reach of 'home', hopping keys along
+   to make one if need be. NOTFOUND => the table must grow.
+*/
+static assoc_size make_room(assoc* assocs, assoc_size home);
+
+/* Moves the contents of 'slot' into the table, false if no room */
+static bool place_slot(assoc* assocs, char* slot);
+
+/* The key held in 'slot': for strings, the string itself */
+static void* slot_key(assoc* assocs, char* slot);
+
+/* Sizes a new filter for the current length and adds every key */
+static void filter_build(assoc* assocs);
+
+/* True if the key held in slot 'index' equals 'key' */
+static bool key_equal(assoc* assocs, assoc_size index, void* key);
+/*
+   Single probe for the slot holding 'key'. If the key
+   isn't there it's inserted with 'value'; if it is, the
+   value is replaced only when 'overwrite' is set.
+*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite);
+
+/* Stores a new key and its value in the unused slot 'index' */
+static void** fill_slot(assoc* assocs, assoc_size index, void* key,
+                        void* value);
+
+/* Fills 'keys' and 'values' from the slots, returns the number */
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values);
+
+/* wal_replay() callback: redoes one logged change, unlogged */
+static void replay_change(void* table, int op, void* key, void* data);
+
+/* load_words() callback: inserts one word, as assoc_insert() */
+static void insert_word(void* table, char* word);
+
+/* Frees the slot array and any keys cloned into it */
+static void release_slots(assoc* assocs);
+
+/* Takes the pair in slot 'index' out of the table, freeing its key */
+static void remove_slot(assoc* assocs, assoc_size index);
+
+/*
+   A cache can't grow its way out of a crowded neighbourhood,
+   so it evicts from it instead, returning the slot freed
+*/
+static assoc_size evict_near(assoc* assocs, assoc_size home);
+
+/* An empty set already big enough for 'n' keys */
+static assoc* sized_set(size_t keysize, size_t n);
+
+/* sets_probe: looks up one batch of keys in the table 'table' */
+static void probe_batch(void* table, void** keys, int n, int* found);
+
+/* sets_add: puts 'key' into the set 'out' */
+static void add_key(void* out, void* key);
+
+/* This backend's part in the set operations */
+static const sets_ops set_ops = {collect_pairs, probe_batch, add_key};
+
+assoc* assoc_init(size_t keysize)
+{
+    return assoc_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, sizeof(void *), alloc);
+}
+
+assoc* assoc_set_init(size_t keysize)
+{
+    return assoc_set_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_set_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, 0, alloc);
+}
+
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc)
+{
+    assoc* assocs;
+
+    if(alloc == NULL){
+        alloc = &heap_allocator;
+    }
+    assocs = mem_alloc(alloc, sizeof(*assocs));
+    assocs->alloc = *alloc;
+    assocs->keysize = keysize;
+    assocs->valuesize = valuesize;
+    assocs->borrowed = false;
+    assocs->words = NULL;
+    assocs->slotsize = slot_size(keysize, valuesize);
+    assocs->count = 0;
+    alloc_arrays(assocs, SIZE);
+    assocs->filter = NULL;
+    assocs->filter_bits = 0;
+    assocs->frozen = NULL;
+    assocs->compact = NULL;
+    assocs->shared = NULL;
+    assocs->cache = NULL;
+    assocs->log = NULL;
+
+    return assocs;
+}
+
+static void alloc_arrays(assoc* assocs, assoc_size length)
+{
+    assocs->length = length;
+    assocs->slots = mem_alloc(&assocs->alloc, (size_t) assocs->slotsize *
+                                              length);
+    assocs->ctrl = mem_alloc(&assocs->alloc, length);
+    assocs->hops = mem_alloc(&assocs->alloc,
+                             (size_t) length * sizeof(unsigned int));
+}
+
+static void free_arrays(assoc* assocs)
+{
+    mem_free(&assocs->alloc, assocs->slots,
+             (size_t) assocs->slotsize * assocs->length);
+    mem_free(&assocs->alloc, assocs->ctrl, assocs->length);
+    mem_free(&assocs->alloc, assocs->hops,
+             (size_t) assocs->length * sizeof(unsigned int));
+}
+
+static assoc_size fill_limit(assoc_size length)
+{
+    return length / FILLDEN * FILLNUM;
+}
+
+/*
+   Sized so that 'capacity' pairs keep the table no fuller
+   than a growing one would get, each slot one word longer
+   for its reference bit and expiry
+*/
+assoc* assoc_cache_init(size_t keysize, size_t capacity)
+{
+    assoc* assocs;
+    assoc_size length;
+
+    if(capacity == 0){
+        on_error("A cache needs room for at least one pair");
+    }
+    assocs = make_assoc(keysize, sizeof(void *), NULL);
+    release_slots(assocs);
+    assocs->slotsize = CACHESLOT(assocs->slotsize);
+    length = SIZE;
+    while(fill_limit(length) < capacity){
+        if(length > ASSOCMAX / DOUBLE){
+            on_error("Cache capacity is too big for its index type");
+        }
+        length *= DOUBLE;
+    }
+    alloc_arrays(assocs, length);
+    assocs->cache = mem_alloc(&assocs->alloc, sizeof(cache));
+    assocs->cache->capacity = capacity;
+    return assocs;
+}
+
+void assoc_cache_ttl(assoc* assocs, unsigned long ms)
+{
+    if(assocs->cache == NULL){
+        on_error("Only a cache has a time to live");
+    }
+    assocs->cache->ttl = ms;
+}
+
+void assoc_insert(assoc** a, void* key, void* data)
+{
+    find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+}
+
+void** assoc_upsert(assoc** a, void* key, void* data)
+{
+    void **stored;
+
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    stored = find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+    return stored;
+}
+
+/* Only a new key changes the table, so only that is logged */
+void** assoc_get_or_insert(assoc** a, void* key, void* data)
+{
+    void **stored;
+    assoc_size count;
+
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    count = (*a)->count;
+    stored = find_or_insert(*a, key, data, false);
+    if((*a)->log != NULL && (*a)->count != count){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+    return stored;
+}
+
+int assoc_remove(assoc* assocs, void* key)
+{
+    assoc_size index;
+
+    if(assocs->slots == NULL){
+        on_error("Cannot remove from a read-only table");
+    }
+    index = find_slot(assocs, key,
+                      HOME(assocs, hash_key(assocs->keysize, key)));
+    if(index == NOTFOUND){
+        return 0;
+    }
+    remove_slot(assocs, index);
+    if(assocs->log != NULL){
+        wal_append(assocs->log, WALREMOVE, key, NULL);
+    }
+    return 1;
+}
+
+size_t assoc_count(assoc* assocs)
+{
+    return assocs->count;
+}
+
+size_t assoc_capacity(assoc* assocs)
+{
+    /* Read-only tables never grow */
+    if(assocs->slots == NULL){
+        return assocs->count;
+    }
+    /* Nor do caches, they evict */
+    if(assocs->cache != NULL){
+        return assocs->cache->capacity;
+    }
+    /* A crowded neighbourhood can grow the table sooner */
+    return fill_limit(assocs->length);
+}
+
+void assoc_borrow_keys(assoc* assocs)
+{
+    if(assocs->count != 0 || assocs->slots == NULL){
+        on_error("Keys can only be borrowed by an empty table");
+    }
+    assocs->borrowed = true;
+}
+
+size_t assoc_load_words(assoc** a, const char* path)
+{
+    if((*a)->keysize != 0){
+        on_error("Words can only go into a table of strings");
+    }
+    return load_words(path, insert_word, a,
+                      (*a)->borrowed ? &(*a)->words : NULL);
+}
+
+static void insert_word(void* table, char* word)
+{
+    assoc_insert((assoc **) table, word, NULL);
+}
+
+void* assoc_lookup(assoc* assocs, void* key)
+{
+    void *value;
+    assoc_size index;
+    unsigned long hash;
+
+    /*
+       Definite miss, don't touch the table. The filter is
+       keyed on the same hash as the table, so a key that gets
+       past it isn't hashed again.
+    */
+    hash = 0;
+    if(assocs->filter != NULL){
+        hash = hash_key(assocs->keysize, key);
+        if(!bloom_maybe(assocs->filter, hash)){
+            return NULL;
+        }
+    }
+    if(assocs->frozen != NULL){
+        value = frozen_lookup(assocs->frozen, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->compact != NULL){
+        value = compact_lookup(assocs->compact, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->shared != NULL){
+        value = shm_lookup(assocs->shared, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->filter == NULL){
+        hash = hash_key(assocs->keysize, key);
+    }
+    index = find_slot(assocs, key, HOME(assocs, hash));
+    if(index == NOTFOUND){
+        return NULL;
+    }
+    return found_data(assocs, index, key);
+}
+
+void assoc_free(assoc* assocs)
+{
+    assoc_allocator alloc;
+
+    release_slots(assocs);
+    if(assocs->frozen != NULL){
+        frozen_free(assocs->frozen);
+    }
+    if(assocs->compact != NULL){
+        compact_free(assocs->compact);
+    }
+    if(assocs->shared != NULL){
+        shm_detach(assocs->shared);
+    }
+    if(assocs->filter != NULL){
+        bloom_free(assocs->filter);
+    }
+    if(assocs->cache != NULL){
+        mem_free(&assocs->alloc, assocs->cache, sizeof(cache));
+    }
+    if(assocs->log != NULL){
+        wal_close(assocs->log);
+    }
+    wordfile_close(assocs->words);
+    alloc = assocs->alloc;
+    mem_free(&alloc, assocs, sizeof(*assocs));
+}
+
+static void release_slots(assoc* assocs)
+{
+    assoc_size index;
+
+    if(assocs->slots == NULL){
+        return;
+    }
+    if(assocs->keysize == 0 && !assocs->borrowed){
+        for(index = 0; index < assocs->length; index += 1){
+            if(assocs->ctrl[index] == SLOTFULL){
+                mem_free(&assocs->alloc, SLOTSTRING(assocs, index),
+                         strlen(SLOTSTRING(assocs, index)) + ADDONE);
+            }
+        }
+    }
+    free_arrays(assocs);
+    assocs->slots = NULL;
+    assocs->ctrl = NULL;
+    assocs->hops = NULL;
+    assocs->length = 0;
+}
+/*
+   Lists every key (for strings, the string itself) and
+   its value, returning how many there were. Keys of a set
+   get PRESENT, so a read-only lookup can tell they're there.
+   A read-only table is listed by its own walk.
+*/
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values)
+{
+    assoc* assocs;
+    unsigned long found;
+    assoc_size index;
+
+    assocs = (assoc *) table;
+    if(assocs->frozen != NULL){
+        return frozen_walk(assocs->frozen, keys, values);
+    }
+    if(assocs->compact != NULL){
+        return compact_walk(assocs->compact, keys, values);
+    }
+    if(assocs->shared != NULL){
+        return shm_walk(assocs->shared, keys, values);
+    }
+    found = 0;
+    for(index = 0; index < assocs->length; index += 1){
+        if(assocs->ctrl[index] == SLOTFULL){
+            if(assocs->keysize == 0){
+                keys[found] = SLOTSTRING(assocs, index);
+            }
+            else{
+                keys[found] = SLOTKEY(assocs, index);
+            }
+            values[found] = assocs->valuesize ? SLOTVALUE(assocs, index)
+                                              : PRESENT;
+            found += 1;
+        }
+    }
+    return found;
+}
+/*
+   The frozen copy owns its keys, so the slots (and any
+   cloned string keys) can go straight away.
+*/
+void assoc_freeze(assoc* assocs)
+{
+    if(assocs->slots == NULL){
+        on_error("Table is already read-only");
+    }
+    assocs->frozen = frozen_copy(collect_pairs, assocs, assocs->count,
+                                 assocs->keysize, &assocs->alloc);
+    release_slots(assocs);
+}
+
+void assoc_compact(assoc* assocs)
+{
+    if(assocs->slots == NULL){
+        on_error("Table is already read-only");
+    }
+    assocs->compact = compact_copy(collect_pairs, assocs, assocs->count,
+                                   assocs->keysize, &assocs->alloc);
+    release_slots(assocs);
+}
+
+/*
+   Data is copied as 'datasize' bytes from where each value
+   points, since the pointers mean nothing in another process
+*/
+void assoc_publish(assoc* assocs, const char* name, size_t datasize)
+{
+    if(assocs->slots == NULL){
+        on_error("Only a live table can be published");
+    }
+    shm_publish_walk(name, collect_pairs, assocs, assocs->count,
+                     assocs->keysize, assocs->valuesize ? datasize : 0,
+                     &assocs->alloc);
+}
+
+assoc* assoc_attach(const char* name)
+{
+    assoc* assocs;
+    shm_table* t;
+
+    t = shm_attach(name);
+    assocs = make_assoc(shm_keysize(t),
+                        shm_datasize(t) ? sizeof(void *) : 0, NULL);
+    release_slots(assocs);
+    assocs->shared = t;
+    assocs->count = (assoc_size) shm_count(t);
+    return assocs;
+}
+
+int assoc_refresh(assoc* assocs)
+{
+    if(assocs->shared == NULL || !shm_refresh(assocs->shared)){
+        return 0;
+    }
+    assocs->count = (assoc_size) shm_count(assocs->shared);
+    if(assocs->filter != NULL){
+        filter_build(assocs);
+    }
+    return 1;
+}
+
+void assoc_unpublish(const char* name)
+{
+    shm_unpublish(name);
+}
+
+/*
+   Pairs are replayed through the same inserts and removes
+   as ever, but only once the log is attached do they get
+   logged, so replaying writes nothing
+*/
+size_t assoc_log(assoc** a, const char* path, size_t datasize,
+                 unsigned int group)
+{
+    wal* w;
+
+    if((*a)->slots == NULL || (*a)->count != 0 || (*a)->log != NULL){
+        on_error("Only an empty live table can start a log");
+    }
+    if((*a)->cache != NULL){
+        on_error("A cache drops pairs by itself, so can't be logged");
+    }
+    w = wal_open(path, (*a)->keysize, (*a)->valuesize ? datasize : 0,
+                 group);
+    wal_replay(w, replay_change, *a);
+    (*a)->log = w;
+    return (*a)->count;
+}
+
+static void replay_change(void* table, int op, void* key, void* data)
+{
+    if(op == WALINSERT){
+        find_or_insert((assoc *) table, key, data, true);
+    }
+    else{
+        assoc_remove((assoc *) table, key);
+    }
+}
+
+void assoc_checkpoint(assoc* assocs)
+{
+    if(assocs->log == NULL || assocs->slots == NULL){
+        on_error("Only a live table with a log can be checkpointed");
+    }
+    wal_checkpoint(assocs->log, collect_pairs, assocs, assocs->count,
+                   assocs->valuesize != 0, &assocs->alloc);
+}
+
+void assoc_sync(assoc* assocs)
+{
+    if(assocs->log == NULL){
+        on_error("Table has no log to sync");
+    }
+    wal_sync(assocs->log);
+}
+
+/*
+   Slots change in place, so there is nothing to share: the
+   snapshot is an O(n) copy, a frozen one owning its keys
+*/
+assoc* assoc_snapshot(assoc* assocs)
+{
+    assoc* snap;
+
+    if(assocs->slots == NULL){
+        on_error("Only a live table can be snapshotted");
+    }
+    snap = make_assoc(assocs->keysize, assocs->valuesize, &assocs->alloc);
+    release_slots(snap);
+    snap->frozen = frozen_copy(collect_pairs, assocs, assocs->count,
+                               assocs->keysize, &snap->alloc);
+    snap->count = (assoc_size) snap->frozen->count;
+    return snap;
+}
+
+/*
+   The smaller table's keys are the ones probed, so the work
+   is proportional to the smaller of the two
+*/
+assoc* assoc_intersect(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    if(b->count < a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = sized_set(a->keysize, a->count);
+    sets_probe_into(&set_ops, out, a, a->count, b, true, &a->alloc);
+    return out;
+}
+
+assoc* assoc_union(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    if(b->count > a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = sized_set(a->keysize, (size_t) a->count + b->count);
+    sets_add_all(&set_ops, out, a, a->count, &a->alloc);
+    sets_probe_into(&set_ops, out, b, b->count, a, false, &b->alloc);
+    return out;
+}
+
+assoc* assoc_difference(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    out = sized_set(a->keysize, a->count);
+    sets_probe_into(&set_ops, out, a, a->count, b, false, &a->alloc);
+    return out;
+}
+
+/*
+   Growing an empty table costs next to nothing, and
+   afterwards filling it never has to grow it again
+*/
+static assoc* sized_set(size_t keysize, size_t n)
+{
+    assoc* out;
+
+    out = make_assoc(keysize, 0, NULL);
+    while(assoc_capacity(out) < n){
+        expand_assoc(out);
+    }
+    return out;
+}
+
+/*
+   Every key's neighbourhood map and home slot are prefetched
+   before any of them is probed, so the batch's cache misses
+   overlap rather than each waiting for the one before
+*/
+static void probe_batch(void* table, void** keys, int n, int* found)
+{
+    assoc *against;
+    assoc_size homes[SETBATCH];
+    int k;
+
+    against = (assoc *) table;
+    for(k = 0; k < n; k += 1){
+        homes[k] = HOME(against, hash_key(against->keysize, keys[k]));
+        PREFETCH(&against->hops[homes[k]]);
+        PREFETCH(SLOT(against, homes[k]));
+    }
+    for(k = 0; k < n; k += 1){
+        found[k] = find_slot(against, keys[k], homes[k]) != NOTFOUND;
+    }
+}
+
+static void add_key(void* out, void* key)
+{
+    find_or_insert((assoc *) out, key, NULL, true);
+}
+
+double assoc_compact_bytes(assoc* assocs)
+{
+    return compact_bytes_per_key(assocs->compact);
+}
+
+double assoc_frozen_bits(assoc* assocs)
+{
+    return frozen_bits_per_key(assocs->frozen);
+}
+
+void assoc_filter(assoc* assocs, int bits)
+{
+    bloom_free(assocs->filter);
+    assocs->filter = NULL;
+    assocs->filter_bits = bits;
+    if(bits > 0){
+        filter_build(assocs);
+    }
+}
+
+double assoc_filter_fpr(assoc* assocs)
+{
+    return bloom_fpr(assocs->filter);
+}
+
+/*
+   Sized for the most keys the table holds before its
+   next resize, so the filter is rebuilt on each resize.
+   A read-only table never grows, so size it for its keys.
+*/
+static void filter_build(assoc* assocs)
+{
+    bloom_free(assocs->filter);
+    assocs->filter = bloom_build(collect_pairs, assocs, assoc_capacity(assocs),
+                                 assocs->filter_bits, assocs->keysize,
+                                 &assocs->alloc);
+}
+
+static size_t slot_size(size_t keysize, size_t valuesize)
+{
+    size_t aligned;
+
+    /* Special case of (char *) */
+    if(keysize == 0){
+        keysize = sizeof(char *);
+    }
+    if(valuesize == 0){
+        return keysize;
+    }
+    aligned = (keysize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    return valuesize + aligned;
+}
+
+/*
+   An expired pair in a cache is evicted as it is found
+   and reported missing; otherwise it's marked as used
+*/
+static void* found_data(assoc* assocs, assoc_size index, void* key)
+{
+    if(assocs->cache != NULL && !cache_touch(&SLOTCACHE(assocs, index))){
+        remove_slot(assocs, index);
+        return NULL;
+    }
+    if(assocs->valuesize == 0){
+        return key;
+    }
+    return SLOTVALUE(assocs, index);
+}
+
+static void* slot_key(assoc* assocs, char* slot)
+{
+    if(assocs->keysize == 0){
+        return *(char **) (slot + assocs->valuesize);
+    }
+    return slot + assocs->valuesize;
+}
+/*
+   Only the slots named in the home's map are compared, and
+   they all lie within HOPRANGE of it, so a miss costs the
+   same as a hit rather than a walk to the next empty slot
+*/
+static assoc_size find_slot(assoc* assocs, void* key, assoc_size home)
+{
+    unsigned int map;
+    assoc_size distance;
+
+    map = assocs->hops[home];
+    for(distance = 0; map != 0; distance += 1, map >>= 1){
+        if((map & 1) &&
+           key_equal(assocs, WRAP(assocs, home + distance), key)){
+            return WRAP(assocs, home + distance);
+        }
+    }
+    return NOTFOUND;
+}
+/*
+   The nearest empty slot is found by probing on from home.
+   While it's out of reach, a key from one of the homes just
+   before it, sitting before it, moves into it - staying in
+   reach of its own home - and its old slot becomes the
+   empty one, until the gap is close enough to 'home'.
+   Keys are only ever moved forwards, to the gap.
+*/
+static assoc_size make_room(assoc* assocs, assoc_size home)
+{
+    assoc_size gap, distance, back, base, from;
+    unsigned int map;
+
+    for(distance = 0;
+        assocs->ctrl[WRAP(assocs, home + distance)] != SLOTEMPTY;
+        distance += 1){
+        if(distance == HOPSCAN || distance == assocs->length - 1){
+            return NOTFOUND;
+        }
+    }
+    gap = WRAP(assocs, home + distance);
+    while(distance >= HOPRANGE){
+        /* Furthest back first, so the gap moves as far as it can */
+        for(back = HOPRANGE - 1; back > 0; back -= 1){
+            base = WRAP(assocs, gap - back);
+            /* Only keys before the gap, i.e. less than 'back' along */
+            map = assocs->hops[base] & (HOPBIT(back) - 1);
+            if(map != 0){
+                break;
+            }
+        }
+        if(back == 0){
+            return NOTFOUND;
+        }
+        for(from = 0; !(map & HOPBIT(from)); from += 1){
+            /* The lowest set bit is the earliest key */
+        }
+        assocs->hops[base] = (assocs->hops[base] & ~HOPBIT(from)) |
+                             HOPBIT(back);
+        from = WRAP(assocs, base + from);
+        memcpy(SLOT(assocs, gap), SLOT(assocs, from), assocs->slotsize);
+        assocs->ctrl[gap] = SLOTFULL;
+        assocs->ctrl[from] = SLOTEMPTY;
+        distance -= HOPS(assocs, from, gap);
+        gap = from;
+    }
+    return gap;
+}
+/*
+   Slots are moved as they are: string keys go across as
+   pointers, not cloned again.
+*/
+static bool place_slot(assoc* assocs, char* slot)
+{
+    assoc_size home, index;
+
+    home = HOME(assocs, hash_key(assocs->keysize, slot_key(assocs, slot)));
+    index = make_room(assocs, home);
+    if(index == NOTFOUND){
+        return false;
+    }
+    memcpy(SLOT(assocs, index), slot, assocs->slotsize);
+    assocs->ctrl[index] = SLOTFULL;
+    assocs->hops[home] |= HOPBIT(HOPS(assocs, home, index));
+    return true;
+}
+/*
+   Every key is placed afresh in arrays twice the length. In
+   the unlikely event that some neighbourhood still overflows,
+   those arrays are thrown away and twice as long tried.
+*/
+static void expand_assoc(assoc* assocs)
+{
+    char *old_slots;
+    unsigned char *old_ctrl;
+    unsigned int *old_hops;
+    assoc_size old_length, length, index;
+    bool placed;
+
+    old_slots = assocs->slots;
+    old_ctrl = assocs->ctrl;
+    old_hops = assocs->hops;
+    old_length = assocs->length;
+    length = old_length;
+    placed = false;
+    while(!placed){
+        if(length > ASSOCMAX / DOUBLE){
+            on_error("Table has outgrown its index type");
+        }
+        length *= DOUBLE;
+        alloc_arrays(assocs, length);
+        placed = true;
+        for(index = 0; placed && index < old_length; index += 1){
+            if(old_ctrl[index] == SLOTFULL){
+                placed = place_slot(assocs, &old_slots[(size_t) index *
+                                                       assocs->slotsize]);
+            }
+        }
+        if(!placed){
+            free_arrays(assocs);
+        }
+    }
+    mem_free(&assocs->alloc, old_slots,
+             (size_t) assocs->slotsize * old_length);
+    mem_free(&assocs->alloc, old_ctrl, old_length);
+    mem_free(&assocs->alloc, old_hops,
+             (size_t) old_length * sizeof(unsigned int));
+
+    if(assocs->filter != NULL){
+        filter_build(assocs);
+    }
+}
+
+static bool key_equal(assoc* assocs, assoc_size index, void* key)
+{
+    if(assocs->keysize == 0){
+        return strcmp(SLOTSTRING(assocs, index), (char *) key) == 0;
+    }
+    return memcmp(SLOTKEY(assocs, index), key, assocs->keysize) == 0;
+}
+/*
+   A neighbourhood with no room left grows the table, and
+   the key's home is worked out again for the new length
+*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite)
+{
+    unsigned long hash;
+    assoc_size home, index;
+
+    if(assocs->slots == NULL){
+        on_error("Cannot insert into a read-only table");
+    }
+    hash = hash_key(assocs->keysize, key);
+    index = find_slot(assocs, key, HOME(assocs, hash));
+    if(index != NOTFOUND){
+        if(assocs->cache != NULL){
+            overwrite = cache_hit(assocs->cache, &SLOTCACHE(assocs, index),
+                                  overwrite);
+        }
+        if(assocs->valuesize == 0){
+            return NULL;
+        }
+        if(overwrite){
+            SLOTVALUE(assocs, index) = value;
+        }
+        return &SLOTVALUE(assocs, index);
+    }
+    /* Caches evict rather than grow */
+    if(assocs->cache != NULL){
+        if(assocs->count == assocs->cache->capacity){
+            remove_slot(assocs,
+                        (assoc_size) cache_victim(assocs->cache, assocs->ctrl,
+                                                  SLOTFULL, assocs->slots,
+                                                  assocs->slotsize,
+                                                  assocs->length));
+        }
+    }
+    else if(assocs->count >= fill_limit(assocs->length)){
+        expand_assoc(assocs);
+    }
+    home = HOME(assocs, hash);
+    while((index = make_room(assocs, home)) == NOTFOUND){
+        if(assocs->cache != NULL){
+            index = evict_near(assocs, home);
+            break;
+        }
+        expand_assoc(assocs);
+        home = HOME(assocs, hash);
+    }
+    assocs->hops[home] |= HOPBIT(HOPS(assocs, home, index));
+    return fill_slot(assocs, index, key, value);
+}
+
+static void** fill_slot(assoc* assocs, assoc_size index, void* key,
+                        void* value)
+{
+    if(assocs->keysize == 0){
+        if(assocs->borrowed){
+            SLOTSTRING(assocs, index) = (char *) key;
+        }
+        else{
+            SLOTSTRING(assocs, index) = mem_strdup(&assocs->alloc,
+                                                     (char *) key);
+        }
+    }
+    else{
+        memcpy(SLOTKEY(assocs, index), key, assocs->keysize);
+    }
+    assocs->ctrl[index] = SLOTFULL;
+    assocs->count += ADDONE;
+    if(assocs->filter != NULL){
+        bloom_add(assocs->filter, hash_key(assocs->keysize, key));
+    }
+    if(assocs->cache != NULL){
+        SLOTCACHE(assocs, index) = cache_fresh(assocs->cache);
+    }
+    if(assocs->valuesize == 0){
+        return NULL;
+    }
+    SLOTVALUE(assocs, index) = value;
+    return &SLOTVALUE(assocs, index);
+}
+
+/*
+   Nothing else moves: the key's bit comes out of its home's
+   map and the slot is simply empty again, with no tombstone.
+*/
+static void remove_slot(assoc* assocs, assoc_size index)
+{
+    assoc_size home;
+
+    home = HOME(assocs, hash_key(assocs->keysize,
+                                 slot_key(assocs, SLOT(assocs, index))));
+    assocs->hops[home] &= ~HOPBIT(HOPS(assocs, home, index));
+    if(assocs->keysize == 0 && !assocs->borrowed){
+        mem_free(&assocs->alloc, SLOTSTRING(assocs, index),
+                 strlen(SLOTSTRING(assocs, index)) + ADDONE);
+    }
+    assocs->ctrl[index] = SLOTEMPTY;
+    assocs->count -= ADDONE;
+
+    if(assocs->filter != NULL && assocs->cache != NULL &&
+       cache_forget(assocs->cache)){
+        filter_build(assocs);
+    }
+}
+
+/*
+   make_room() only fails once every slot within reach of
+   'home' is full, so the first of them not used lately (or
+   failing that, the home slot itself) goes
+*/
+static assoc_size evict_near(assoc* assocs, assoc_size home)
+{
+    assoc_size distance, index;
+
+    index = home;
+    for(distance = 0; distance < HOPRANGE; distance += 1){
+        if(!(SLOTCACHE(assocs, WRAP(assocs, home + distance)) & CACHEREF)){
+            index = WRAP(assocs, home + distance);
+            break;
+        }
+    }
+    remove_slot(assocs, index);
+    return index;
+}
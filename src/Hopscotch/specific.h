@@ -0,0 +1,144 @@
+/* Backend names of its own when built into libassoc */
+#include "../Lib/rename.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include <string.h>
+#include <limits.h>
+
+#include "../Hash/hash.h"
+#include "../Bloom/bloom.h"
+#include "../Alloc/alloc.h"
+#include "../Alloc/arena.h"
+#include "../Pairs/pairs.h"
+#include "../Frozen/frozen.h"
+#include "../Compact/compact.h"
+#include "../Shm/shm.h"
+#include "../Cache/cache.h"
+#include "../Load/load.h"
+#include "../Wal/wal.h"
+#include "../Sets/sets.h"
+
+/* Tables kept in a file are Realloc's alone: no assoc_file_init() */
+#define ASSOC_NOFILE
+/* As are heavy-hitter tables: no assoc_topk_init(), assoc_topk() */
+#define ASSOC_NOTOPK
+
+/* Grows once FILLNUM / FILLDEN of the slots are in use */
+#define FILLNUM 9
+#define FILLDEN 10
+/*
+   Every key lives within HOPRANGE slots of its home, and
+   each home slot has a bitmap of which of those hold its
+   keys, so a lookup reads one map and a run of nearby slots
+*/
+#define HOPRANGE 32
+/* How far past a key's home an insert looks for an empty slot */
+#define HOPSCAN 512
+/* No such slot */
+#define NOTFOUND ((assoc_size) -1)
+/* Increase value by one */
+#define ADDONE 1
+/* Doubles the length of the internal arrays */
+#define DOUBLE 2
+/*
+   One control byte per slot says whether it is in use, so
+   any data (NULL included) can be stored, and sets need no
+   value at all.
+*/
+#define SLOTEMPTY 0
+#define SLOTFULL 1
+/* What a read-only set stores for each key */
+#define PRESENT ((void *) 1)
+/* The assignment requires this size */
+#define SIZE 16
+
+/*
+   Each slot holds the value pointer followed by the key
+   (or, for strings, the pointer to the key), as in the
+   other backends. A set has no value pointer.
+*/
+#define SLOTVALUE(a, i) \
+    (*(void **) &(a)->slots[(size_t) (i) * (a)->slotsize])
+#define SLOTKEY(a, i) \
+    (&(a)->slots[(size_t) (i) * (a)->slotsize + (a)->valuesize])
+#define SLOTSTRING(a, i) (*(char **) SLOTKEY(a, i))
+/* The whole of slot 'i' */
+#define SLOT(a, i) (&(a)->slots[(size_t) (i) * (a)->slotsize])
+/* In cache mode, the reference bit and expiry of slot 'i' */
+#define SLOTCACHE(a, i) CACHEWORD((a)->slots, (a)->slotsize, i)
+
+/* Lengths are powers of two, so wrapping round is a mask */
+#define WRAP(a, i) ((assoc_size) (i) & ((a)->length - 1))
+/* The home slot of a key with hash 'h' */
+#define HOME(a, h) WRAP(a, h)
+/* How far past 'home' slot 'i' is */
+#define HOPS(a, home, i) WRAP(a, (i) - (home))
+/* The bit of a neighbourhood map for a key 'd' slots from home */
+#define HOPBIT(d) (1U << (d))
+
+/* Hints that memory is about to be read */
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+/*
+   Slot counts and indices. Tables known to stay small can be
+   built with -DASSOC32, which keeps them in 32 bits and makes
+   growing past 2^32 slots an error rather than a wrap.
+*/
+#ifdef ASSOC32
+typedef unsigned int assoc_size;
+#define ASSOCMAX ((assoc_size) UINT_MAX)
+#else
+typedef size_t assoc_size;
+#define ASSOCMAX ((assoc_size) -1)
+#endif
+
+typedef enum bool {false, true} bool;
+/* Structure for hashing */
+typedef struct assoc {
+
+    char *slots;
+    unsigned char *ctrl;
+    /*
+       One neighbourhood map per home slot: bit d is set when
+       slot home + d holds a key whose home this is. HOPRANGE
+       bits, so an unsigned int (32 bits wherever this builds)
+    */
+    unsigned int *hops;
+    size_t slotsize;
+    /* sizeof(void *), or 0 for a set */
+    size_t valuesize;
+
+    size_t keysize;
+    /* String keys are the caller's: never copied, never freed */
+    bool borrowed;
+    /* Mapped files that borrowed keys point into */
+    wordfile *words;
+    assoc_size length;
+    assoc_size count;
+
+    /* Optional membership filter, NULL => none */
+    bloom *filter;
+    int filter_bits;
+
+    /* Read-only perfect hash copy, NULL => not frozen */
+    frozen *frozen;
+    /* Read-only front-coded copy, NULL => not compacted */
+    compact *compact;
+    /* Attached shared-memory copy, NULL => not attached */
+    shm_table *shared;
+    /* Fixed capacity and eviction state, NULL => grows as needed */
+    cache *cache;
+    /* Write-ahead log of every change, NULL => not durable */
+    wal *log;
+
+    /* Where all of the table's memory comes from */
+    assoc_allocator alloc;
+
+} assoc;
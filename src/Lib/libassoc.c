@@ -0,0 +1,719 @@
+/*
+   The front end of libassoc: each table remembers which
+   backend it was built on, and every call is passed on to
+   that backend's own copy of the function (realloc_assoc_*,
+   cuckoo_assoc_*, hopscotch_assoc_*, hamt_assoc_*, see
+   rename.h).
+*/
+
+#include "specific.h"
+#include "../assoc.h"
+
+/*
+   Private functions:
+*/
+
+/* Each backend's public functions, under its own names */
+#define BACKEND(P) \
+struct P##assoc* P##assoc_init_ex(size_t keysize, \
+                                  const assoc_allocator* alloc); \
+struct P##assoc* P##assoc_set_init_ex(size_t keysize, \
+                                      const assoc_allocator* alloc); \
+struct P##assoc* P##assoc_cache_init(size_t keysize, size_t capacity); \
+void P##assoc_cache_ttl(struct P##assoc* a, unsigned long ms); \
+void P##assoc_borrow_keys(struct P##assoc* a); \
+void P##assoc_insert(struct P##assoc** a, void* key, void* data); \
+void** P##assoc_upsert(struct P##assoc** a, void* key, void* data); \
+void** P##assoc_get_or_insert(struct P##assoc** a, void* key, \
+                              void* data); \
+int P##assoc_remove(struct P##assoc* a, void* key); \
+size_t P##assoc_load_words(struct P##assoc** a, const char* path); \
+size_t P##assoc_count(struct P##assoc* a); \
+size_t P##assoc_capacity(struct P##assoc* a); \
+void* P##assoc_lookup(struct P##assoc* a, void* key); \
+struct P##assoc* P##assoc_intersect(struct P##assoc* a, \
+                                    struct P##assoc* b); \
+struct P##assoc* P##assoc_union(struct P##assoc* a, struct P##assoc* b); \
+struct P##assoc* P##assoc_difference(struct P##assoc* a, \
+                                     struct P##assoc* b); \
+void P##assoc_filter(struct P##assoc* a, int bits); \
+double P##assoc_filter_fpr(struct P##assoc* a); \
+void P##assoc_freeze(struct P##assoc* a); \
+double P##assoc_frozen_bits(struct P##assoc* a); \
+void P##assoc_compact(struct P##assoc* a); \
+double P##assoc_compact_bytes(struct P##assoc* a); \
+void P##assoc_publish(struct P##assoc* a, const char* name, \
+                      size_t datasize); \
+struct P##assoc* P##assoc_attach(const char* name); \
+int P##assoc_refresh(struct P##assoc* a); \
+void P##assoc_unpublish(const char* name); \
+size_t P##assoc_log(struct P##assoc** a, const char* path, \
+                    size_t datasize, unsigned int group); \
+void P##assoc_checkpoint(struct P##assoc* a); \
+void P##assoc_sync(struct P##assoc* a); \
+struct P##assoc* P##assoc_snapshot(struct P##assoc* a); \
+void P##assoc_free(struct P##assoc* a);
+
+BACKEND(realloc_)
+BACKEND(cuckoo_)
+BACKEND(hopscotch_)
+BACKEND(hamt_)
+
+/* Only Realloc keeps tables in a file, or heavy hitters */
+struct realloc_assoc* realloc_assoc_file_init(const char* path,
+                                              size_t keysize,
+                                              size_t datasize);
+struct realloc_assoc* realloc_assoc_topk_init(size_t keysize,
+                                              size_t capacity);
+size_t realloc_assoc_topk(struct realloc_assoc* a, void** keys,
+                          unsigned long* counts, size_t k);
+
+/* Where ASSOC_AUTO goes without ASSOC_BACKEND */
+#define DEFAULTKIND ASSOC_REALLOC
+
+/* Resolves ASSOC_AUTO to an actual backend */
+static assoc_kind choose(assoc_kind kind);
+
+/* A new front end table on backend 'kind', its table unset */
+static assoc* wrap(assoc_kind kind);
+
+/* Set operations only combine tables of one backend */
+static void same_kind(assoc* a, assoc* b);
+
+assoc* assoc_init(size_t keysize)
+{
+    return assoc_init_kind(keysize, ASSOC_AUTO, NULL);
+}
+
+assoc* assoc_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return assoc_init_kind(keysize, ASSOC_AUTO, alloc);
+}
+
+assoc* assoc_set_init(size_t keysize)
+{
+    return assoc_set_init_kind(keysize, ASSOC_AUTO, NULL);
+}
+
+assoc* assoc_set_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return assoc_set_init_kind(keysize, ASSOC_AUTO, alloc);
+}
+
+assoc* assoc_init_kind(size_t keysize, assoc_kind kind,
+                       const assoc_allocator* alloc)
+{
+    assoc* a;
+
+    a = wrap(choose(kind));
+    if(a->kind == ASSOC_CUCKOO){
+        a->table.cuckoo_table = cuckoo_assoc_init_ex(keysize, alloc);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        a->table.hopscotch_table = hopscotch_assoc_init_ex(keysize, alloc);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        a->table.hamt_table = hamt_assoc_init_ex(keysize, alloc);
+    }
+    else{
+        a->table.realloc_table = realloc_assoc_init_ex(keysize, alloc);
+    }
+    return a;
+}
+
+assoc* assoc_set_init_kind(size_t keysize, assoc_kind kind,
+                           const assoc_allocator* alloc)
+{
+    assoc* a;
+
+    a = wrap(choose(kind));
+    if(a->kind == ASSOC_CUCKOO){
+        a->table.cuckoo_table = cuckoo_assoc_set_init_ex(keysize, alloc);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        a->table.hopscotch_table = hopscotch_assoc_set_init_ex(keysize, alloc);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        a->table.hamt_table = hamt_assoc_set_init_ex(keysize, alloc);
+    }
+    else{
+        a->table.realloc_table = realloc_assoc_set_init_ex(keysize, alloc);
+    }
+    return a;
+}
+
+assoc_kind assoc_backend(assoc* a)
+{
+    return a->kind;
+}
+
+assoc* assoc_cache_init(size_t keysize, size_t capacity)
+{
+    assoc* a;
+
+    a = wrap(choose(ASSOC_AUTO));
+    /* HAMT has no cache mode, so its caches go to the default */
+    if(a->kind == ASSOC_HAMT){
+        a->kind = DEFAULTKIND;
+    }
+    if(a->kind == ASSOC_CUCKOO){
+        a->table.cuckoo_table = cuckoo_assoc_cache_init(keysize, capacity);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        a->table.hopscotch_table = hopscotch_assoc_cache_init(keysize,
+                                                              capacity);
+    }
+    else{
+        a->table.realloc_table = realloc_assoc_cache_init(keysize,
+                                                          capacity);
+    }
+    return a;
+}
+
+void assoc_cache_ttl(assoc* a, unsigned long ms)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_cache_ttl(a->table.cuckoo_table, ms);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_cache_ttl(a->table.hopscotch_table, ms);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_cache_ttl(a->table.hamt_table, ms);
+    }
+    else{
+        realloc_assoc_cache_ttl(a->table.realloc_table, ms);
+    }
+}
+/*
+   The file's layout is its own (see Linear/linear.h), so
+   rather than every backend, Realloc alone wraps one
+*/
+assoc* assoc_file_init(const char* path, size_t keysize, size_t datasize)
+{
+    assoc* a;
+
+    a = wrap(DEFAULTKIND);
+    a->table.realloc_table = realloc_assoc_file_init(path, keysize,
+                                                     datasize);
+    return a;
+}
+
+/* Likewise, the candidates have a layout of their own (Heavy/) */
+assoc* assoc_topk_init(size_t keysize, size_t capacity)
+{
+    assoc* a;
+
+    a = wrap(DEFAULTKIND);
+    a->table.realloc_table = realloc_assoc_topk_init(keysize, capacity);
+    return a;
+}
+
+size_t assoc_topk(assoc* a, void** keys, unsigned long* counts, size_t k)
+{
+    if(a->kind != ASSOC_REALLOC){
+        on_error("Only a heavy-hitter table has a top k");
+    }
+    return realloc_assoc_topk(a->table.realloc_table, keys, counts, k);
+}
+
+void assoc_borrow_keys(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_borrow_keys(a->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_borrow_keys(a->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_borrow_keys(a->table.hamt_table);
+    }
+    else{
+        realloc_assoc_borrow_keys(a->table.realloc_table);
+    }
+}
+
+void assoc_insert(assoc** a, void* key, void* data)
+{
+    if((*a)->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_insert(&(*a)->table.cuckoo_table, key, data);
+    }
+    else if((*a)->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_insert(&(*a)->table.hopscotch_table, key, data);
+    }
+    else if((*a)->kind == ASSOC_HAMT){
+        hamt_assoc_insert(&(*a)->table.hamt_table, key, data);
+    }
+    else{
+        realloc_assoc_insert(&(*a)->table.realloc_table, key, data);
+    }
+}
+
+void** assoc_upsert(assoc** a, void* key, void* data)
+{
+    if((*a)->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_upsert(&(*a)->table.cuckoo_table, key, data);
+    }
+    if((*a)->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_upsert(&(*a)->table.hopscotch_table, key, data);
+    }
+    if((*a)->kind == ASSOC_HAMT){
+        return hamt_assoc_upsert(&(*a)->table.hamt_table, key, data);
+    }
+    return realloc_assoc_upsert(&(*a)->table.realloc_table, key, data);
+}
+
+void** assoc_get_or_insert(assoc** a, void* key, void* data)
+{
+    if((*a)->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_get_or_insert(&(*a)->table.cuckoo_table,
+                                          key, data);
+    }
+    if((*a)->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_get_or_insert(&(*a)->table.hopscotch_table,
+                                             key, data);
+    }
+    if((*a)->kind == ASSOC_HAMT){
+        return hamt_assoc_get_or_insert(&(*a)->table.hamt_table,
+                                        key, data);
+    }
+    return realloc_assoc_get_or_insert(&(*a)->table.realloc_table,
+                                       key, data);
+}
+
+int assoc_remove(assoc* a, void* key)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_remove(a->table.cuckoo_table, key);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_remove(a->table.hopscotch_table, key);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_remove(a->table.hamt_table, key);
+    }
+    return realloc_assoc_remove(a->table.realloc_table, key);
+}
+
+size_t assoc_load_words(assoc** a, const char* path)
+{
+    if((*a)->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_load_words(&(*a)->table.cuckoo_table, path);
+    }
+    if((*a)->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_load_words(&(*a)->table.hopscotch_table, path);
+    }
+    if((*a)->kind == ASSOC_HAMT){
+        return hamt_assoc_load_words(&(*a)->table.hamt_table, path);
+    }
+    return realloc_assoc_load_words(&(*a)->table.realloc_table, path);
+}
+
+size_t assoc_count(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_count(a->table.cuckoo_table);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_count(a->table.hopscotch_table);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_count(a->table.hamt_table);
+    }
+    return realloc_assoc_count(a->table.realloc_table);
+}
+
+size_t assoc_capacity(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_capacity(a->table.cuckoo_table);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_capacity(a->table.hopscotch_table);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_capacity(a->table.hamt_table);
+    }
+    return realloc_assoc_capacity(a->table.realloc_table);
+}
+
+void* assoc_lookup(assoc* a, void* key)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_lookup(a->table.cuckoo_table, key);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_lookup(a->table.hopscotch_table, key);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_lookup(a->table.hamt_table, key);
+    }
+    return realloc_assoc_lookup(a->table.realloc_table, key);
+}
+
+assoc* assoc_intersect(assoc* a, assoc* b)
+{
+    assoc* out;
+
+    same_kind(a, b);
+    out = wrap(a->kind);
+    if(a->kind == ASSOC_CUCKOO){
+        out->table.cuckoo_table =
+            cuckoo_assoc_intersect(a->table.cuckoo_table,
+                                   b->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        out->table.hopscotch_table =
+            hopscotch_assoc_intersect(a->table.hopscotch_table,
+                                      b->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        out->table.hamt_table =
+            hamt_assoc_intersect(a->table.hamt_table,
+                                 b->table.hamt_table);
+    }
+    else{
+        out->table.realloc_table =
+            realloc_assoc_intersect(a->table.realloc_table,
+                                    b->table.realloc_table);
+    }
+    return out;
+}
+
+assoc* assoc_union(assoc* a, assoc* b)
+{
+    assoc* out;
+
+    same_kind(a, b);
+    out = wrap(a->kind);
+    if(a->kind == ASSOC_CUCKOO){
+        out->table.cuckoo_table =
+            cuckoo_assoc_union(a->table.cuckoo_table,
+                               b->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        out->table.hopscotch_table =
+            hopscotch_assoc_union(a->table.hopscotch_table,
+                                  b->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        out->table.hamt_table =
+            hamt_assoc_union(a->table.hamt_table, b->table.hamt_table);
+    }
+    else{
+        out->table.realloc_table =
+            realloc_assoc_union(a->table.realloc_table,
+                                b->table.realloc_table);
+    }
+    return out;
+}
+
+assoc* assoc_difference(assoc* a, assoc* b)
+{
+    assoc* out;
+
+    same_kind(a, b);
+    out = wrap(a->kind);
+    if(a->kind == ASSOC_CUCKOO){
+        out->table.cuckoo_table =
+            cuckoo_assoc_difference(a->table.cuckoo_table,
+                                    b->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        out->table.hopscotch_table =
+            hopscotch_assoc_difference(a->table.hopscotch_table,
+                                       b->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        out->table.hamt_table =
+            hamt_assoc_difference(a->table.hamt_table,
+                                  b->table.hamt_table);
+    }
+    else{
+        out->table.realloc_table =
+            realloc_assoc_difference(a->table.realloc_table,
+                                     b->table.realloc_table);
+    }
+    return out;
+}
+
+void assoc_filter(assoc* a, int bits)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_filter(a->table.cuckoo_table, bits);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_filter(a->table.hopscotch_table, bits);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_filter(a->table.hamt_table, bits);
+    }
+    else{
+        realloc_assoc_filter(a->table.realloc_table, bits);
+    }
+}
+
+double assoc_filter_fpr(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_filter_fpr(a->table.cuckoo_table);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_filter_fpr(a->table.hopscotch_table);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_filter_fpr(a->table.hamt_table);
+    }
+    return realloc_assoc_filter_fpr(a->table.realloc_table);
+}
+
+void assoc_freeze(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_freeze(a->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_freeze(a->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_freeze(a->table.hamt_table);
+    }
+    else{
+        realloc_assoc_freeze(a->table.realloc_table);
+    }
+}
+
+double assoc_frozen_bits(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_frozen_bits(a->table.cuckoo_table);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_frozen_bits(a->table.hopscotch_table);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_frozen_bits(a->table.hamt_table);
+    }
+    return realloc_assoc_frozen_bits(a->table.realloc_table);
+}
+
+void assoc_compact(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_compact(a->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_compact(a->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_compact(a->table.hamt_table);
+    }
+    else{
+        realloc_assoc_compact(a->table.realloc_table);
+    }
+}
+
+double assoc_compact_bytes(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_compact_bytes(a->table.cuckoo_table);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_compact_bytes(a->table.hopscotch_table);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_compact_bytes(a->table.hamt_table);
+    }
+    return realloc_assoc_compact_bytes(a->table.realloc_table);
+}
+
+void assoc_publish(assoc* a, const char* name, size_t datasize)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_publish(a->table.cuckoo_table, name, datasize);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_publish(a->table.hopscotch_table, name, datasize);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_publish(a->table.hamt_table, name, datasize);
+    }
+    else{
+        realloc_assoc_publish(a->table.realloc_table, name, datasize);
+    }
+}
+/*
+   The segment's layout is the same whichever backend wrote
+   it, and an attached table never probes its own slots, so
+   any backend will do
+*/
+assoc* assoc_attach(const char* name)
+{
+    assoc* a;
+
+    a = wrap(DEFAULTKIND);
+    a->table.realloc_table = realloc_assoc_attach(name);
+    return a;
+}
+
+int assoc_refresh(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_refresh(a->table.cuckoo_table);
+    }
+    if(a->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_refresh(a->table.hopscotch_table);
+    }
+    if(a->kind == ASSOC_HAMT){
+        return hamt_assoc_refresh(a->table.hamt_table);
+    }
+    return realloc_assoc_refresh(a->table.realloc_table);
+}
+
+void assoc_unpublish(const char* name)
+{
+    realloc_assoc_unpublish(name);
+}
+
+size_t assoc_log(assoc** a, const char* path, size_t datasize,
+                 unsigned int group)
+{
+    if((*a)->kind == ASSOC_CUCKOO){
+        return cuckoo_assoc_log(&(*a)->table.cuckoo_table, path,
+                                datasize, group);
+    }
+    if((*a)->kind == ASSOC_HOPSCOTCH){
+        return hopscotch_assoc_log(&(*a)->table.hopscotch_table, path,
+                                   datasize, group);
+    }
+    if((*a)->kind == ASSOC_HAMT){
+        return hamt_assoc_log(&(*a)->table.hamt_table, path,
+                              datasize, group);
+    }
+    return realloc_assoc_log(&(*a)->table.realloc_table, path,
+                             datasize, group);
+}
+
+void assoc_checkpoint(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_checkpoint(a->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_checkpoint(a->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_checkpoint(a->table.hamt_table);
+    }
+    else{
+        realloc_assoc_checkpoint(a->table.realloc_table);
+    }
+}
+
+void assoc_sync(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_sync(a->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_sync(a->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_sync(a->table.hamt_table);
+    }
+    else{
+        realloc_assoc_sync(a->table.realloc_table);
+    }
+}
+
+assoc* assoc_snapshot(assoc* a)
+{
+    assoc* out;
+
+    out = wrap(a->kind);
+    if(a->kind == ASSOC_CUCKOO){
+        out->table.cuckoo_table = cuckoo_assoc_snapshot(a->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        out->table.hopscotch_table =
+            hopscotch_assoc_snapshot(a->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        out->table.hamt_table = hamt_assoc_snapshot(a->table.hamt_table);
+    }
+    else{
+        out->table.realloc_table =
+            realloc_assoc_snapshot(a->table.realloc_table);
+    }
+    return out;
+}
+
+void assoc_free(assoc* a)
+{
+    if(a->kind == ASSOC_CUCKOO){
+        cuckoo_assoc_free(a->table.cuckoo_table);
+    }
+    else if(a->kind == ASSOC_HOPSCOTCH){
+        hopscotch_assoc_free(a->table.hopscotch_table);
+    }
+    else if(a->kind == ASSOC_HAMT){
+        hamt_assoc_free(a->table.hamt_table);
+    }
+    else{
+        realloc_assoc_free(a->table.realloc_table);
+    }
+    free(a);
+}
+/*
+   Realloc has the quickest inserts and misses in benchassoc
+   and its hits are within a few percent of Cuckoo's, so it
+   is the default; Hopscotch is the one to try when memory
+   matters more, running 90% full, and HAMT when readers
+   need snapshots of a table still being written. The
+   environment is only read once.
+*/
+static assoc_kind choose(assoc_kind kind)
+{
+    static assoc_kind chosen = ASSOC_AUTO;
+    const char* forced;
+
+    if(kind != ASSOC_AUTO){
+        return kind;
+    }
+    if(chosen == ASSOC_AUTO){
+        forced = getenv("ASSOC_BACKEND");
+        if(forced == NULL || strcmp(forced, "realloc") == 0){
+            chosen = DEFAULTKIND;
+        }
+        else if(strcmp(forced, "cuckoo") == 0){
+            chosen = ASSOC_CUCKOO;
+        }
+        else if(strcmp(forced, "hopscotch") == 0){
+            chosen = ASSOC_HOPSCOTCH;
+        }
+        else if(strcmp(forced, "hamt") == 0){
+            chosen = ASSOC_HAMT;
+        }
+        else{
+            on_error("ASSOC_BACKEND must be \"realloc\", \"cuckoo\", "
+                     "\"hopscotch\" or \"hamt\"");
+        }
+    }
+    return chosen;
+}
+
+static assoc* wrap(assoc_kind kind)
+{
+    assoc* a;
+
+    a = (assoc*) ncalloc(1, sizeof(assoc));
+    a->kind = kind;
+    return a;
+}
+
+static void same_kind(assoc* a, assoc* b)
+{
+    if(a->kind != b->kind){
+        on_error("Set operations need tables on the same backend");
+    }
+}
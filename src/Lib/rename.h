@@ -0,0 +1,61 @@
+/*
+   Included first thing by each backend's specific.h. When a
+   backend is built for libassoc (-DASSOC_PREFIX=realloc_ and
+   so on) its table type and every public function get a name
+   of the backend's own, e.g. assoc_insert() becomes
+   realloc_assoc_insert(), so that all the backends link into
+   one library behind the front end in libassoc.c. Without
+   ASSOC_PREFIX nothing changes.
+*/
+
+#ifndef RENAME_H
+#define RENAME_H
+
+#ifdef ASSOC_PREFIX
+
+#define ASSOC_PASTE(prefix, name) prefix##name
+#define ASSOC_NAME(prefix, name) ASSOC_PASTE(prefix, name)
+
+#define assoc ASSOC_NAME(ASSOC_PREFIX, assoc)
+#define assoc_init ASSOC_NAME(ASSOC_PREFIX, assoc_init)
+#define assoc_init_ex ASSOC_NAME(ASSOC_PREFIX, assoc_init_ex)
+#define assoc_set_init ASSOC_NAME(ASSOC_PREFIX, assoc_set_init)
+#define assoc_set_init_ex ASSOC_NAME(ASSOC_PREFIX, assoc_set_init_ex)
+#define assoc_borrow_keys ASSOC_NAME(ASSOC_PREFIX, assoc_borrow_keys)
+#define assoc_cache_init ASSOC_NAME(ASSOC_PREFIX, assoc_cache_init)
+#define assoc_cache_ttl ASSOC_NAME(ASSOC_PREFIX, assoc_cache_ttl)
+#define assoc_file_init ASSOC_NAME(ASSOC_PREFIX, assoc_file_init)
+#define assoc_topk_init ASSOC_NAME(ASSOC_PREFIX, assoc_topk_init)
+#define assoc_topk ASSOC_NAME(ASSOC_PREFIX, assoc_topk)
+#define assoc_insert ASSOC_NAME(ASSOC_PREFIX, assoc_insert)
+#define assoc_upsert ASSOC_NAME(ASSOC_PREFIX, assoc_upsert)
+#define assoc_get_or_insert ASSOC_NAME(ASSOC_PREFIX, assoc_get_or_insert)
+#define assoc_remove ASSOC_NAME(ASSOC_PREFIX, assoc_remove)
+#define assoc_load_words ASSOC_NAME(ASSOC_PREFIX, assoc_load_words)
+#define assoc_count ASSOC_NAME(ASSOC_PREFIX, assoc_count)
+#define assoc_capacity ASSOC_NAME(ASSOC_PREFIX, assoc_capacity)
+#define assoc_lookup ASSOC_NAME(ASSOC_PREFIX, assoc_lookup)
+#define assoc_intersect ASSOC_NAME(ASSOC_PREFIX, assoc_intersect)
+#define assoc_union ASSOC_NAME(ASSOC_PREFIX, assoc_union)
+#define assoc_difference ASSOC_NAME(ASSOC_PREFIX, assoc_difference)
+#define assoc_filter ASSOC_NAME(ASSOC_PREFIX, assoc_filter)
+#define assoc_filter_fpr ASSOC_NAME(ASSOC_PREFIX, assoc_filter_fpr)
+#define assoc_freeze ASSOC_NAME(ASSOC_PREFIX, assoc_freeze)
+#define assoc_frozen_bits ASSOC_NAME(ASSOC_PREFIX, assoc_frozen_bits)
+#define assoc_compact ASSOC_NAME(ASSOC_PREFIX, assoc_compact)
+#define assoc_compact_bytes ASSOC_NAME(ASSOC_PREFIX, assoc_compact_bytes)
+#define assoc_publish ASSOC_NAME(ASSOC_PREFIX, assoc_publish)
+#define assoc_attach ASSOC_NAME(ASSOC_PREFIX, assoc_attach)
+#define assoc_refresh ASSOC_NAME(ASSOC_PREFIX, assoc_refresh)
+#define assoc_unpublish ASSOC_NAME(ASSOC_PREFIX, assoc_unpublish)
+#define assoc_log ASSOC_NAME(ASSOC_PREFIX, assoc_log)
+#define assoc_checkpoint ASSOC_NAME(ASSOC_PREFIX, assoc_checkpoint)
+#define assoc_sync ASSOC_NAME(ASSOC_PREFIX, assoc_sync)
+#define assoc_snapshot ASSOC_NAME(ASSOC_PREFIX, assoc_snapshot)
+#define assoc_todot ASSOC_NAME(ASSOC_PREFIX, assoc_todot)
+#define assoc_free ASSOC_NAME(ASSOC_PREFIX, assoc_free)
+#define assoc_test ASSOC_NAME(ASSOC_PREFIX, assoc_test)
+
+#endif
+
+#endif
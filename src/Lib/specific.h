@@ -0,0 +1,72 @@
+/*
+   The table as libassoc sees it: which backend it is, and
+   that backend's own table. Every backend is in the one
+   library, under names of its own (see rename.h), so each
+   table can use a different one. Build against this
+   directory (-I./Lib) in place of a single backend's.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include <string.h>
+
+#include "../Hash/hash.h"
+#include "../Alloc/alloc.h"
+#include "../Alloc/arena.h"
+#include "../Cache/cache.h"
+
+/* This build can choose the backend table by table */
+#define ASSOC_KINDS
+
+typedef enum assoc_kind {
+
+    /* The library's choice, see assoc_init_kind() */
+    ASSOC_AUTO,
+    /* Linear probing, Realloc/ */
+    ASSOC_REALLOC,
+    /* Two nests per key, Cuckoo/ */
+    ASSOC_CUCKOO,
+    /* Neighbourhood bitmaps, Hopscotch/ */
+    ASSOC_HOPSCOTCH,
+    /* Persistent trie with O(1) snapshots, Hamt/ */
+    ASSOC_HAMT
+
+} assoc_kind;
+
+/* The backends' tables, only ever handled through pointers */
+struct realloc_assoc;
+struct cuckoo_assoc;
+struct hopscotch_assoc;
+struct hamt_assoc;
+
+typedef struct assoc {
+
+    assoc_kind kind;
+    union {
+        struct realloc_assoc *realloc_table;
+        struct cuckoo_assoc *cuckoo_table;
+        struct hopscotch_assoc *hopscotch_table;
+        struct hamt_assoc *hamt_table;
+    } table;
+
+} assoc;
+
+/*
+   As assoc_init_ex(), on the backend 'kind'. The plain
+   assoc_*init*() calls all use ASSOC_AUTO, which is Realloc
+   unless the environment variable ASSOC_BACKEND ("realloc",
+   "cuckoo", "hopscotch" or "hamt") says otherwise, so a
+   workload can be tried on each backend without a rebuild.
+   HAMT has no cache mode, so caches go to Realloc.
+*/
+assoc* assoc_init_kind(size_t keysize, assoc_kind kind,
+                       const assoc_allocator* alloc);
+
+/* As assoc_init_kind(), for a set */
+assoc* assoc_set_init_kind(size_t keysize, assoc_kind kind,
+                           const assoc_allocator* alloc);
+
+/* The backend a table ended up on, never ASSOC_AUTO */
+assoc_kind assoc_backend(assoc* a);
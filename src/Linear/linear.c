@@ -0,0 +1,433 @@
+/* open(), mmap(), msync() and ftruncate() aren't C90 */
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "linear.h"
+#include "../Hash/hash.h"
+#include "../../../ADTs/General/general.h"
+
+#define LINEARMAGIC 0x414C494EUL
+#define LINEARMODE 0644
+/* A bucket splits whenever the pages are this full on average */
+#define FILLNUM 3
+#define FILLDEN 4
+/* The files grow a quarter at a time, and at least this much */
+#define GROWFRAC 4
+#define MINGROW (1 << 20)
+
+#define ALIGNUP(n) \
+    (((n) + LINEARALIGN - 1) & ~((size_t) LINEARALIGN - 1))
+#define PAGEHEAD ALIGNUP(sizeof(linear_page))
+/* Bytes of a page free for entries */
+#define PAYLOAD (LINEARPAGE - PAGEHEAD)
+#define HASHBYTES ALIGNUP(sizeof(unsigned long))
+/* The first entry of 'page' */
+#define ENTRIES(page) ((char *) (page) + PAGEHEAD)
+
+/* Bucket 'b' is page b + 1 of the bucket file, after the header */
+static linear_page* bucket_page(linear* t, unsigned long b);
+static linear_page* overflow_page(linear* t, unsigned long n);
+/* The bucket that keys with hash 'h' belong in right now */
+static unsigned long bucket_of(linear* t, unsigned long h);
+static unsigned long key_hash(linear* t, const void* key);
+/* Bytes of 'key', the '\0' of a string included */
+static size_t key_bytes(linear* t, const void* key);
+static char* entry_key(linear* t, char* entry);
+static int key_equal(linear* t, const char* stored, const void* key);
+static size_t entry_bytes(linear* t, char* entry);
+/* The entry holding 'key', and its page; NULL => not there */
+static char* find_entry(linear* t, const void* key, unsigned long h,
+                        linear_page** page);
+/* Appends an entry to the first page in the bucket's chain with room */
+static void add_entry(linear* t, unsigned long bucket, const char* entry,
+                      size_t bytes);
+/* An empty overflow page, reused if one is free */
+static unsigned long new_overflow(linear* t);
+/* Splits the next bucket in turn between itself and a new one */
+static void split(linear* t);
+/* Extends a file and its mapping to at least 'needed' bytes */
+static void grow(int fd, char** base, size_t* size, size_t needed);
+
+/*
+   Both files are created sparse, so room that hasn't been
+   written to yet costs nothing on disk
+*/
+linear* linear_open(const char* path, size_t keysize, size_t datasize)
+{
+    linear* t;
+    linear_header* h;
+    struct stat st;
+    char* name;
+
+    t = (linear*) ncalloc(1, sizeof(linear));
+    name = (char*) ncalloc(1, strlen(path) + strlen(".ovf") + 1);
+    strcpy(name, path);
+    strcat(name, ".ovf");
+    t->fd = open(path, O_RDWR | O_CREAT, LINEARMODE);
+    t->overflow_fd = open(name, O_RDWR | O_CREAT, LINEARMODE);
+    free(name);
+    if(t->fd < 0 || t->overflow_fd < 0 || fstat(t->fd, &st) != 0){
+        on_error("Cannot open file-backed table");
+    }
+    grow(t->fd, &t->base, &t->size,
+         (size_t) st.st_size > 2 * LINEARPAGE ? (size_t) st.st_size
+                                              : 2 * LINEARPAGE);
+    if(fstat(t->overflow_fd, &st) != 0){
+        on_error("Cannot open file-backed table");
+    }
+    grow(t->overflow_fd, &t->overflow, &t->overflow_size,
+         (size_t) st.st_size > LINEARPAGE ? (size_t) st.st_size
+                                          : LINEARPAGE);
+    t->header = h = (linear_header*) t->base;
+    /* A new file is all zeroes: one empty bucket, not yet split */
+    if(h->magic == 0){
+        h->magic = LINEARMAGIC;
+        h->keysize = keysize;
+        h->datasize = datasize;
+    }
+    if(h->magic != LINEARMAGIC){
+        on_error("Not a file-backed table");
+    }
+    if(h->keysize != keysize || h->datasize != datasize){
+        on_error("File-backed table has a different size of key or data");
+    }
+    return t;
+}
+
+void* linear_lookup(linear* t, const void* key)
+{
+    linear_page* page;
+    char* entry;
+
+    entry = find_entry(t, key, key_hash(t, key), &page);
+    if(entry == NULL){
+        return NULL;
+    }
+    return t->header->datasize ? entry + HASHBYTES : entry_key(t, entry);
+}
+
+/*
+   One split per page's worth of new entries keeps the
+   average page FILLNUM / FILLDEN full
+*/
+void linear_insert(linear* t, const void* key, const void* data)
+{
+    unsigned long buffer[LINEARPAGE / sizeof(unsigned long)];
+    linear_page* page;
+    unsigned long h;
+    size_t bytes, datasize;
+    char* entry;
+
+    datasize = t->header->datasize;
+    h = key_hash(t, key);
+    entry = find_entry(t, key, h, &page);
+    if(entry != NULL){
+        if(data != NULL){
+            memcpy(entry + HASHBYTES, data, datasize);
+        }
+        else{
+            memset(entry + HASHBYTES, 0, datasize);
+        }
+        return;
+    }
+    bytes = HASHBYTES + ALIGNUP(datasize) + ALIGNUP(key_bytes(t, key));
+    if(bytes > PAYLOAD){
+        on_error("Key and data too big for a page of a file-backed table");
+    }
+    entry = (char*) buffer;
+    memset(entry, 0, bytes);
+    buffer[0] = h;
+    if(data != NULL){
+        memcpy(entry + HASHBYTES, data, datasize);
+    }
+    memcpy(entry_key(t, entry), key, key_bytes(t, key));
+    add_entry(t, bucket_of(t, h), entry, bytes);
+    t->header->count += 1;
+    t->header->bytes += bytes;
+
+    while(t->header->bytes * FILLDEN >
+          ((1UL << t->header->level) + t->header->split) *
+          (unsigned long) PAYLOAD * FILLNUM){
+        split(t);
+    }
+}
+
+/*
+   The rest of the page closes up behind it. Pages are never
+   handed back here: a split tidies its whole chain anyway.
+*/
+int linear_remove(linear* t, const void* key)
+{
+    linear_page* page;
+    char* entry;
+    size_t bytes;
+
+    entry = find_entry(t, key, key_hash(t, key), &page);
+    if(entry == NULL){
+        return 0;
+    }
+    bytes = entry_bytes(t, entry);
+    memmove(entry, entry + bytes,
+            (size_t) (ENTRIES(page) + page->used - (entry + bytes)));
+    page->used -= bytes;
+    t->header->count -= 1;
+    t->header->bytes -= bytes;
+    return 1;
+}
+
+unsigned long linear_count(linear* t)
+{
+    return t->header->count;
+}
+
+size_t linear_keysize(linear* t)
+{
+    return (size_t) t->header->keysize;
+}
+
+size_t linear_datasize(linear* t)
+{
+    return (size_t) t->header->datasize;
+}
+
+void linear_sync(linear* t)
+{
+    if(msync(t->base, t->size, MS_SYNC) != 0 ||
+       msync(t->overflow, t->overflow_size, MS_SYNC) != 0){
+        on_error("Cannot sync file-backed table");
+    }
+}
+
+void linear_close(linear* t)
+{
+    linear_sync(t);
+    munmap(t->base, t->size);
+    munmap(t->overflow, t->overflow_size);
+    close(t->fd);
+    close(t->overflow_fd);
+    free(t);
+}
+
+static linear_page* bucket_page(linear* t, unsigned long b)
+{
+    return (linear_page*) &t->base[(size_t) (b + 1) * LINEARPAGE];
+}
+
+static linear_page* overflow_page(linear* t, unsigned long n)
+{
+    return (linear_page*) &t->overflow[(size_t) n * LINEARPAGE];
+}
+
+static unsigned long bucket_of(linear* t, unsigned long h)
+{
+    unsigned long b;
+
+    b = h & ((1UL << t->header->level) - 1);
+    if(b < t->header->split){
+        b = h & ((1UL << (t->header->level + 1)) - 1);
+    }
+    return b;
+}
+
+static unsigned long key_hash(linear* t, const void* key)
+{
+    if(t->header->keysize == 0){
+        return hash_string((const char*) key);
+    }
+    return hash_bytes(key, (size_t) t->header->keysize);
+}
+
+static size_t key_bytes(linear* t, const void* key)
+{
+    if(t->header->keysize == 0){
+        return strlen((const char*) key) + 1;
+    }
+    return (size_t) t->header->keysize;
+}
+
+static char* entry_key(linear* t, char* entry)
+{
+    return entry + HASHBYTES + ALIGNUP((size_t) t->header->datasize);
+}
+
+static int key_equal(linear* t, const char* stored, const void* key)
+{
+    if(t->header->keysize == 0){
+        return strcmp(stored, (const char*) key) == 0;
+    }
+    return memcmp(stored, key, (size_t) t->header->keysize) == 0;
+}
+
+static size_t entry_bytes(linear* t, char* entry)
+{
+    return HASHBYTES + ALIGNUP((size_t) t->header->datasize) +
+           ALIGNUP(key_bytes(t, entry_key(t, entry)));
+}
+
+/* Whole hashes are compared first, so keys rarely are */
+static char* find_entry(linear* t, const void* key, unsigned long h,
+                        linear_page** page)
+{
+    char* entry;
+    size_t offset;
+
+    *page = bucket_page(t, bucket_of(t, h));
+    for(;;){
+        for(offset = 0; offset < (*page)->used;
+            offset += entry_bytes(t, entry)){
+            entry = ENTRIES(*page) + offset;
+            if(*(unsigned long*) entry == h &&
+               key_equal(t, entry_key(t, entry), key)){
+                return entry;
+            }
+        }
+        if((*page)->next == 0){
+            return NULL;
+        }
+        *page = overflow_page(t, (*page)->next);
+    }
+}
+
+static void add_entry(linear* t, unsigned long bucket, const char* entry,
+                      size_t bytes)
+{
+    linear_page* page;
+    unsigned long n;
+
+    page = bucket_page(t, bucket);
+    while(page->used + bytes > PAYLOAD && page->next != 0){
+        page = overflow_page(t, page->next);
+    }
+    if(page->used + bytes > PAYLOAD){
+        /* The overflow file may have moved, so find the end again */
+        n = new_overflow(t);
+        page = bucket_page(t, bucket);
+        while(page->next != 0){
+            page = overflow_page(t, page->next);
+        }
+        page->next = n;
+        page = overflow_page(t, n);
+    }
+    memcpy(ENTRIES(page) + page->used, entry, bytes);
+    page->used += bytes;
+}
+
+static unsigned long new_overflow(linear* t)
+{
+    linear_page* page;
+    unsigned long n;
+
+    if(t->header->free != 0){
+        n = t->header->free;
+        t->header->free = overflow_page(t, n)->next;
+    }
+    else{
+        t->header->overflows += 1;
+        n = t->header->overflows;
+        grow(t->overflow_fd, &t->overflow, &t->overflow_size,
+             (size_t) (n + 1) * LINEARPAGE);
+    }
+    page = overflow_page(t, n);
+    page->next = 0;
+    page->used = 0;
+    return n;
+}
+
+/*
+   Every entry in the chain is copied out, the chain emptied
+   (its overflow pages going on the free list), and then each
+   entry goes back to whichever of the two buckets its hash
+   now says. Only this one chain is read or written.
+*/
+static void split(linear* t)
+{
+    linear_page* page;
+    unsigned long from, to, next, n;
+    char *entries, *entry;
+    size_t total, offset, bytes;
+
+    from = t->header->split;
+    to = from + (1UL << t->header->level);
+    grow(t->fd, &t->base, &t->size, (size_t) (to + 2) * LINEARPAGE);
+    t->header = (linear_header*) t->base;
+    page = bucket_page(t, to);
+    page->next = 0;
+    page->used = 0;
+
+    total = 0;
+    for(page = bucket_page(t, from); ; page = overflow_page(t, page->next)){
+        total += page->used;
+        if(page->next == 0){
+            break;
+        }
+    }
+    entries = (char*) ncalloc(1, total + 1);
+    total = 0;
+    for(page = bucket_page(t, from); ; page = overflow_page(t, page->next)){
+        memcpy(entries + total, ENTRIES(page), page->used);
+        total += page->used;
+        if(page->next == 0){
+            break;
+        }
+    }
+    page = bucket_page(t, from);
+    next = page->next;
+    page->next = 0;
+    page->used = 0;
+    while(next != 0){
+        page = overflow_page(t, next);
+        n = page->next;
+        page->next = t->header->free;
+        page->used = 0;
+        t->header->free = next;
+        next = n;
+    }
+
+    t->header->split += 1;
+    if(t->header->split == 1UL << t->header->level){
+        t->header->level += 1;
+        t->header->split = 0;
+    }
+    for(offset = 0; offset < total; offset += bytes){
+        entry = entries + offset;
+        bytes = entry_bytes(t, entry);
+        add_entry(t, bucket_of(t, *(unsigned long*) entry), entry, bytes);
+    }
+    free(entries);
+}
+
+static void grow(int fd, char** base, size_t* size, size_t needed)
+{
+    size_t length;
+
+    if(needed <= *size){
+        return;
+    }
+    length = *size;
+    while(length < needed){
+        length += length / GROWFRAC > MINGROW ? length / GROWFRAC
+                                              : MINGROW;
+    }
+    if(ftruncate(fd, (off_t) length) != 0){
+        on_error("Cannot grow file-backed table");
+    }
+    if(*base != NULL){
+        munmap(*base, *size);
+    }
+    *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(*base == MAP_FAILED){
+        on_error("Cannot mmap() file-backed table");
+    }
+#ifdef MADV_RANDOM
+    /* Buckets are read one at a time, read-ahead would be wasted */
+    madvise(*base, length, MADV_RANDOM);
+#endif
+    *size = length;
+}
@@ -0,0 +1,110 @@
+/*
+   A table kept in a file rather than in memory, for key sets
+   too big for RAM, grown by Litwin's linear hashing. Buckets
+   are page-sized blocks of a memory-mapped file, each with a
+   chain of overflow pages (in a second file, "path.ovf") for
+   when it fills. Rather than doubling all at once the table
+   splits one bucket at a time, in order, whenever the pages
+   get too full, so the file only ever grows by a page and
+   nothing is rewritten but the bucket being split.
+
+   With 2^level buckets at the start of a round and 'split'
+   of them split so far, a key with hash h lives in bucket
+   h mod 2^level, or h mod 2^(level+1) if that one has been
+   split already. A lookup reads one bucket's chain, usually
+   a single page, so the page cache keeps whichever buckets
+   are busy and the kernel writes the rest back as it likes.
+   There's no journal: a crash can leave a half-split bucket.
+*/
+
+#ifndef LINEAR_H
+#define LINEAR_H
+
+#include <stdlib.h>
+
+/* Bytes per bucket and overflow page */
+#define LINEARPAGE 4096
+/* Entries, and the data in them, start on these boundaries */
+#define LINEARALIGN 8
+
+/* Page 0 of the bucket file */
+typedef struct linear_header {
+
+    unsigned long magic;
+    unsigned long keysize;
+    /* Bytes of data copied per key, 0 => a set */
+    unsigned long datasize;
+    /* 2^level buckets when this round of splits began */
+    unsigned long level;
+    /* Next bucket to split */
+    unsigned long split;
+    unsigned long count;
+    /* Bytes of entries stored, what decides when to split */
+    unsigned long bytes;
+    /* Overflow pages handed out, page 0 is never used */
+    unsigned long overflows;
+    /* First overflow page free for reuse, 0 => none */
+    unsigned long free;
+
+} linear_header;
+
+/*
+   Starts every page, its entries following on: the key's
+   hash, its data (padded to LINEARALIGN), then the key
+*/
+typedef struct linear_page {
+
+    /* The next overflow page of the chain, 0 => last */
+    unsigned long next;
+    /* Bytes of entries on this page */
+    unsigned long used;
+
+} linear_page;
+
+typedef struct linear {
+
+    int fd;
+    int overflow_fd;
+    /* Both files are mapped whole, bigger than in use */
+    char *base;
+    size_t size;
+    char *overflow;
+    size_t overflow_size;
+    linear_header *header;
+
+} linear;
+
+/*
+   Opens the table in the file 'path', creating it if need
+   be. 'keysize' as for assoc_init(), 0 => strings. on_error()
+   if the file holds a table with other sizes.
+*/
+linear* linear_open(const char* path, size_t keysize, size_t datasize);
+
+/*
+   The table's copy of the data stored against 'key', or for
+   a set of the key itself; NULL => not found. Only valid
+   until the next change, which may move the mapping.
+*/
+void* linear_lookup(linear* t, const void* key);
+
+/*
+   Stores 'key' with a copy of the 'datasize' bytes at 'data'
+   (zeroes if NULL), replacing the data if it's already there
+*/
+void linear_insert(linear* t, const void* key, const void* data);
+
+/* Removes 'key', returning 1 if it was there, 0 if not */
+int linear_remove(linear* t, const void* key);
+
+unsigned long linear_count(linear* t);
+size_t linear_keysize(linear* t);
+size_t linear_datasize(linear* t);
+
+/* Writes every changed page back to the files */
+void linear_sync(linear* t);
+
+/* Syncs, then unmaps and closes everything */
+void linear_close(linear* t);
+
+#endif
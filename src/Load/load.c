@@ -0,0 +1,141 @@
+/* mmap() and open() aren't C90 */
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "load.h"
+#include "../../../ADTs/General/general.h"
+
+/* This byte and every one below it ends a word, as isspace() */
+#define SPACE 0x20
+#define HIGHBYTE 0x7F
+/* A byte in every lane of a word */
+#define ONES 0x0101010101010101UL
+#define HIGHS 0x8080808080808080UL
+/*
+   Eight bytes tested at once: nonzero if any byte of 'x'
+   is a delimiter, or if any byte is part of a word
+*/
+#define HAS_SPACE(x) (((x) - ONES * (SPACE + 1)) & ~(x) & HIGHS)
+#define HAS_WORD(x) ((((x) + ONES * (HIGHBYTE - SPACE)) | (x)) & HIGHS)
+
+/* Eight bytes from 'p', which needn't be aligned */
+static unsigned long load_word(const char* p);
+
+wordfile* wordfile_open(const char* path)
+{
+    wordfile* w;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0 || fstat(fd, &st) != 0){
+        on_error("Cannot open word file");
+    }
+    w = (wordfile*) ncalloc(1, sizeof(wordfile));
+    w->size = (size_t) st.st_size;
+    if(w->size > 0){
+        /* Private and writable: only pages holding a '\0' get copied */
+        w->base = mmap(NULL, w->size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+        if(w->base == MAP_FAILED){
+            on_error("Cannot mmap() word file");
+        }
+#ifdef MADV_SEQUENTIAL
+        madvise(w->base, w->size, MADV_SEQUENTIAL);
+#endif
+    }
+    close(fd);
+    return w;
+}
+/*
+   Whole runs of delimiters, then whole runs of word bytes,
+   are stepped over eight bytes at a time, finishing off a
+   byte at a time where the run ends.
+*/
+char* wordfile_next(wordfile* w)
+{
+    size_t start, length;
+
+    while(w->pos + sizeof(unsigned long) <= w->size &&
+          !HAS_WORD(load_word(w->base + w->pos))){
+        w->pos += sizeof(unsigned long);
+    }
+    while(w->pos < w->size &&
+          (unsigned char) w->base[w->pos] <= SPACE){
+        w->pos += 1;
+    }
+    if(w->pos == w->size){
+        return NULL;
+    }
+    start = w->pos;
+    while(w->pos + sizeof(unsigned long) <= w->size &&
+          !HAS_SPACE(load_word(w->base + w->pos))){
+        w->pos += sizeof(unsigned long);
+    }
+    while(w->pos < w->size &&
+          (unsigned char) w->base[w->pos] > SPACE){
+        w->pos += 1;
+    }
+    if(w->pos < w->size){
+        w->base[w->pos] = '\0';
+        w->pos += 1;
+        return w->base + start;
+    }
+    /* Nowhere to put the '\0' without writing past the file */
+    length = w->pos - start;
+    w->tail = (char*) ncalloc(length + 1, 1);
+    memcpy(w->tail, w->base + start, length);
+    return w->tail;
+}
+
+void wordfile_close(wordfile* w)
+{
+    wordfile* next;
+
+    while(w != NULL){
+        next = w->next;
+        if(w->size > 0){
+            munmap(w->base, w->size);
+        }
+        free(w->tail);
+        free(w);
+        w = next;
+    }
+}
+
+size_t load_words(const char* path, load_insert insert, void* table,
+                  wordfile** kept)
+{
+    wordfile* w;
+    char* word;
+    size_t words;
+
+    w = wordfile_open(path);
+    words = 0;
+    while((word = wordfile_next(w)) != NULL){
+        insert(table, word);
+        words += 1;
+    }
+    if(kept != NULL){
+        w->next = *kept;
+        *kept = w;
+    }
+    else{
+        wordfile_close(w);
+    }
+    return words;
+}
+
+static unsigned long load_word(const char* p)
+{
+    unsigned long x;
+
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
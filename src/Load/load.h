@@ -0,0 +1,48 @@
+/*
+   Splits a text file into whitespace separated words
+   without reading it into buffers: the file is mapped
+   privately, and each word is '\0' terminated in place (over
+   the delimiter that follows it), so a word is just a
+   pointer into the mapping, valid until wordfile_close().
+*/
+
+#ifndef LOAD_H
+#define LOAD_H
+
+#include <stddef.h>
+
+typedef struct wordfile {
+
+    char *base;
+    size_t size;
+    size_t pos;
+    /* Copy of a last word with no delimiter after it */
+    char *tail;
+    /* Tables keep a list of the files their keys point into */
+    struct wordfile *next;
+
+} wordfile;
+
+/* Maps 'path', on_error() if it can't */
+wordfile* wordfile_open(const char* path);
+
+/* The next word, or NULL at the end of the file */
+char* wordfile_next(wordfile* w);
+
+/* Unmaps 'w' and every file listed after it */
+void wordfile_close(wordfile* w);
+
+/* Adds one word, found in place in the mapping, to 'table' */
+typedef void (*load_insert)(void* table, char* word);
+
+/*
+   Passes every word of 'path' to 'insert', returning how
+   many there were. A table that borrows its keys keeps the
+   mapping for as long as it lives, so passes the list to
+   push it onto as 'kept'; otherwise each word is cloned as
+   usual, 'kept' is NULL and the mapping goes straight away.
+*/
+size_t load_words(const char* path, load_insert insert, void* table,
+                  wordfile** kept);
+
+#endif
@@ -0,0 +1,97 @@
+/* pthread_rwlock_t isn't in the base headers */
+#define _POSIX_C_SOURCE 200112L
+
+#include "specific.h"
+#include "../assoc.h"
+#include "locked.h"
+
+/*
+   Private functions:
+*/
+
+/* True if a lookup on 'a' changes it, so needs the lock to itself */
+static int lookup_writes(assoc* a);
+
+locked* locked_init(assoc* a, int shared)
+{
+    locked* l;
+
+    l = (locked*) ncalloc(1, sizeof(locked));
+    l->a = a;
+    l->shared = shared;
+    if(shared){
+        if(pthread_rwlock_init(&l->rwlock, NULL) != 0){
+            on_error("Cannot create rwlock");
+        }
+    }
+    else{
+        if(pthread_mutex_init(&l->mutex, NULL) != 0){
+            on_error("Cannot create mutex");
+        }
+    }
+    return l;
+}
+
+void locked_insert(locked* l, void* key, void* data)
+{
+    if(l->shared){
+        pthread_rwlock_wrlock(&l->rwlock);
+        assoc_insert(&l->a, key, data);
+        pthread_rwlock_unlock(&l->rwlock);
+    }
+    else{
+        pthread_mutex_lock(&l->mutex);
+        assoc_insert(&l->a, key, data);
+        pthread_mutex_unlock(&l->mutex);
+    }
+}
+
+/*
+   Concurrent readers are only safe on tables whose lookups
+   don't write: a cache sets a reference bit and drops the
+   expired pair it finds, and a compacted table decodes keys
+   into a shared buffer. Those take the write lock instead.
+*/
+void* locked_lookup(locked* l, void* key)
+{
+    void* value;
+
+    if(l->shared && !lookup_writes(l->a)){
+        pthread_rwlock_rdlock(&l->rwlock);
+        value = assoc_lookup(l->a, key);
+        pthread_rwlock_unlock(&l->rwlock);
+    }
+    else if(l->shared){
+        pthread_rwlock_wrlock(&l->rwlock);
+        value = assoc_lookup(l->a, key);
+        pthread_rwlock_unlock(&l->rwlock);
+    }
+    else{
+        pthread_mutex_lock(&l->mutex);
+        value = assoc_lookup(l->a, key);
+        pthread_mutex_unlock(&l->mutex);
+    }
+    return value;
+}
+
+void locked_free(locked* l)
+{
+    if(l->shared){
+        pthread_rwlock_destroy(&l->rwlock);
+    }
+    else{
+        pthread_mutex_destroy(&l->mutex);
+    }
+    assoc_free(l->a);
+    free(l);
+}
+
+static int lookup_writes(assoc* a)
+{
+#ifndef ASSOC_NOCACHE
+    if(a->cache != NULL){
+        return 1;
+    }
+#endif
+    return a->compact != NULL;
+}
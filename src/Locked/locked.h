@@ -0,0 +1,37 @@
+/*
+   The simplest thread-safe table: an assoc behind a lock.
+   Either one mutex for everything, or a reader/writer lock
+   so that lookups can run side by side (bar those on caches
+   and compacted tables, which write). This is the
+   baseline any real concurrent variant has to beat.
+   Needs _POSIX_C_SOURCE 200112L for pthread_rwlock_t.
+*/
+
+#ifndef LOCKED_H
+#define LOCKED_H
+
+#include <pthread.h>
+
+struct assoc;
+
+typedef struct locked {
+
+    struct assoc *a;
+    /* Nonzero => rwlock, else mutex */
+    int shared;
+    pthread_mutex_t mutex;
+    pthread_rwlock_t rwlock;
+
+} locked;
+
+/* Takes ownership of 'a'; 'shared' picks the rwlock */
+locked* locked_init(struct assoc* a, int shared);
+
+void locked_insert(locked* l, void* key, void* data);
+
+void* locked_lookup(locked* l, void* key);
+
+/* Frees the lock and the table */
+void locked_free(locked* l);
+
+#endif
@@ -0,0 +1,18 @@
+#include "pairs.h"
+
+/* One spare entry, so an empty table still gets arrays */
+void pairs_collect(pairs* p, pairs_walk walk, void* table,
+                   unsigned long most, const assoc_allocator* al)
+{
+    p->alloc = *al;
+    p->bytes = (most + 1) * sizeof(void *);
+    p->keys = mem_alloc(al, p->bytes);
+    p->values = mem_alloc(al, p->bytes);
+    p->count = walk(table, p->keys, p->values);
+}
+
+void pairs_free(pairs* p)
+{
+    mem_free(&p->alloc, p->keys, p->bytes);
+    mem_free(&p->alloc, p->values, p->bytes);
+}
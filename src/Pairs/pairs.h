@@ -0,0 +1,43 @@
+/*
+   Every pair of a table, as a key array and a value array
+   side by side: what the read-only copies, shared-memory
+   tables, snapshots and log checkpoints are built from.
+   Only the walk that fills them in is each backend's own;
+   the arrays are sized, allocated and freed here.
+*/
+
+#ifndef PAIRS_H
+#define PAIRS_H
+
+#include "../Alloc/alloc.h"
+
+/*
+   A backend's walk over 'table': fills in 'keys' (for
+   strings, the string itself) and 'values', returning how
+   many pairs there were
+*/
+typedef unsigned long (*pairs_walk)(void* table, void** keys,
+                                    void** values);
+
+typedef struct pairs {
+
+    void **keys;
+    void **values;
+    unsigned long count;
+    /* Bytes in each array */
+    size_t bytes;
+    assoc_allocator alloc;
+
+} pairs;
+
+/*
+   Fills in 'p' by 'walk' over 'table', which holds at
+   most 'most' pairs, with arrays from 'al'
+*/
+void pairs_collect(pairs* p, pairs_walk walk, void* table,
+                   unsigned long most, const assoc_allocator* al);
+
+/* Frees the arrays, the keys and values are still the table's */
+void pairs_free(pairs* p);
+
+#endif
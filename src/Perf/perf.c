@@ -0,0 +1,203 @@
+/* syscall() and clock_gettime() aren't C90 */
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "perf.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* Nanoseconds in a second */
+#define NANO 1e9
+/* No counter */
+#define CLOSED -1
+
+/* Opens one counter for this thread, CLOSED on failure */
+static int open_event(int kind);
+
+/* Seconds on the monotonic clock */
+static double now(void);
+
+static const char* names[PERF_EVENTS] = {
+    "cycles", "instr", "L1D-miss", "LLC-miss", "dTLB-miss", "br-miss"
+};
+
+void perf_init(perf* p, int counters)
+{
+    int kind;
+
+    for(kind = 0; kind < PERF_EVENTS; kind += 1){
+        p->fds[kind] = counters ? open_event(kind) : CLOSED;
+    }
+    perf_reset(p);
+}
+
+void perf_reset(perf* p)
+{
+    memset(p->counts, 0, sizeof(p->counts));
+    p->seconds = 0.0;
+}
+
+int perf_available(perf* p)
+{
+    int kind;
+
+    for(kind = 0; kind < PERF_EVENTS; kind += 1){
+        if(p->fds[kind] != CLOSED){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void perf_start(perf* p)
+{
+#ifdef __linux__
+    int kind;
+
+    for(kind = 0; kind < PERF_EVENTS; kind += 1){
+        if(p->fds[kind] != CLOSED){
+            ioctl(p->fds[kind], PERF_EVENT_IOC_RESET, 0);
+            ioctl(p->fds[kind], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    p->started = now();
+}
+
+void perf_stop(perf* p)
+{
+#ifdef __linux__
+    unsigned long value;
+    int kind;
+#endif
+
+    p->seconds += now() - p->started;
+#ifdef __linux__
+    for(kind = 0; kind < PERF_EVENTS; kind += 1){
+        if(p->fds[kind] != CLOSED){
+            ioctl(p->fds[kind], PERF_EVENT_IOC_DISABLE, 0);
+            if(read(p->fds[kind], &value, sizeof(value)) ==
+               (ssize_t) sizeof(value)){
+                p->counts[kind] += value;
+            }
+        }
+    }
+#endif
+}
+
+void perf_header(perf* p)
+{
+    int kind;
+
+    printf("%-12s %10s %9s", "phase", "ops", "ns/op");
+    for(kind = 0; kind < PERF_EVENTS; kind += 1){
+        if(p->fds[kind] != CLOSED){
+            printf(" %10s", names[kind]);
+        }
+    }
+    printf("\n");
+}
+
+void perf_report(perf* p, const char* phase, unsigned long ops)
+{
+    int kind;
+
+    if(ops == 0){
+        ops = 1;
+    }
+    printf("%-12s %10lu %9.1f", phase, ops, p->seconds * NANO / ops);
+    for(kind = 0; kind < PERF_EVENTS; kind += 1){
+        if(p->fds[kind] != CLOSED){
+            printf(" %10.2f", (double) p->counts[kind] / ops);
+        }
+    }
+    printf("\n");
+}
+
+void perf_close(perf* p)
+{
+#ifdef __linux__
+    int kind;
+
+    for(kind = 0; kind < PERF_EVENTS; kind += 1){
+        if(p->fds[kind] != CLOSED){
+            close(p->fds[kind]);
+            p->fds[kind] = CLOSED;
+        }
+    }
+#else
+    (void) p;
+#endif
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / NANO;
+}
+
+#ifdef __linux__
+/*
+   Each counter is opened on its own, so that a machine
+   missing one event (often dTLB or LLC in VMs) still gets
+   the rest. User space only, which needs the least privilege.
+*/
+static int open_event(int kind)
+{
+    struct perf_event_attr attr;
+    long fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.type = PERF_TYPE_HARDWARE;
+
+    switch(kind){
+        case PERF_CYCLES:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_LLC_MISSES:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PERF_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0 ? CLOSED : (int) fd;
+}
+#else
+static int open_event(int kind)
+{
+    (void) kind;
+    return CLOSED;
+}
+#endif
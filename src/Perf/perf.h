@@ -0,0 +1,55 @@
+/*
+   Wall clock time and, where the kernel lets us, hardware
+   performance counters (perf_event_open) around a phase of
+   a benchmark. If a counter can't be opened - no permission,
+   a VM without a PMU, not Linux - it reads as unavailable
+   and everything else carries on.
+*/
+
+#ifndef PERF_H
+#define PERF_H
+
+/* The counters we try to open */
+enum perf_event_kind {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENTS
+};
+
+typedef struct perf {
+
+    int fds[PERF_EVENTS];
+    /* Totals over every start/stop since the last reset */
+    unsigned long counts[PERF_EVENTS];
+    double seconds;
+    double started;
+
+} perf;
+
+/* Opens the counters if 'counters' is set, else just times */
+void perf_init(perf* p, int counters);
+
+/* Zeroes the totals */
+void perf_reset(perf* p);
+
+void perf_start(perf* p);
+
+/* Adds everything since perf_start() to the totals */
+void perf_stop(perf* p);
+
+/* One line: the totals divided by 'ops' */
+void perf_report(perf* p, const char* phase, unsigned long ops);
+
+/* Column headings for perf_report() */
+void perf_header(perf* p);
+
+/* True if at least one counter is open */
+int perf_available(perf* p);
+
+void perf_close(perf* p);
+
+#endif
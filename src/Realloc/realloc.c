@@ -2,7 +2,8 @@
    A Hash Table, storing void pointers to a key/data pair.
    The user is responsible for keeping the data persistent
    (i.e. pointing at objects that haven't been freed)
-   No copying of key/data is done.
+   Fixed size keys are copied into the slots, and string
+   keys are cloned unless the table borrows them.
 */
 
 #include "specific.h"
@@ -12,36 +13,50 @@
    Private functions:
 */
 
-/* Creates copy of the 'original' string given as argument */
-static char* clone_string(char* original);
+/*
+   Bytes in one slot: with a value, the key rounded up to
+   pointer alignment; a set's keys are packed
+*/
+static size_t slot_size(size_t keysize, size_t valuesize);
+
+/* Shared by maps and sets, 'valuesize' 0 => set */
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc);
+
+/* What a lookup returns for slot 'index': its data, or for a set the key */
+static void* found_data(assoc* assocs, assoc_size index, void* key);
 
 /* Doubles the length of the internal arrays */
 static void expand_assoc(assoc* assocs);
 
-/* Looks to see if equal key found */
-static void* lookup_strings(assoc* assocs, char* key);
+/* Index of 'key' among a small table's pairs, or NOTFOUND */
+static assoc_size small_find(assoc* assocs, void* key);
+
+/* Moves a small table's pairs out into hashed slots of their own */
+static void spill(assoc* assocs);
+
+/* Looks to see if equal key found, probing from its 'hash' */
+static void* lookup_strings(assoc* assocs, char* key, unsigned long hash);
 
-/* Looks to see if equal key found */
-static void* lookup_general(assoc* assocs, void* key);
+/* Looks to see if equal key found, probing from its 'hash' */
+static void* lookup_general(assoc* assocs, void* key, unsigned long hash);
 
-/* Fills memory with value and passes to insert_one */
-static void expand_strings(assoc* assocs, void **old_values,
-                           char **old_keys, int old_length);
+/* Rehashes the first 'old_length' slots into the doubled arrays */
+static void rehash_in_place(assoc* assocs, assoc_size old_length);
 
-/* Fills memory with value and passes to insert_one */
-static void expand_general(assoc* assocs, void **old_values,
-                           void *old_keys, int old_length);
+/* Moves the contents of 'slot' to the first free slot from its home */
+static void place_slot(assoc* assocs, char* slot);
 
-/* My own hash function */
-static int hash_key(int keysize, void* key);
+/* Sizes a new filter for the current length and adds every key */
+static void filter_build(assoc* assocs);
 
 /* Inserts one key-value pair into the assocs object. */
 static void insert_key_string(assoc* assocs, char* key,
-                              int index, int copy_this);
+                              assoc_size index, int copy_this);
 
 /* Inserts one key-value pair into the assocs object. */
 static void insert_key_general(assoc* assocs, void* key,
-                               int index);
+                               assoc_size index);
 /*
    Inserts key-value pair into the assocs object.
    Uses flag "count" to decide whether or not
@@ -49,276 +64,1013 @@ static void insert_key_general(assoc* assocs, void* key,
 */
 static void insert_one(assoc* assocs, void* key, void* value,
                        int count);
+/* True if the key held in slot 'index' equals 'key' */
+static bool key_equal(assoc* assocs, assoc_size index, void* key);
+
+/* Index of the slot holding 'key', or NOTFOUND */
+static assoc_size find_key(assoc* assocs, void* key);
 /*
-   Function removes repeated values but failed to work
-   properly. I've commented it out to show that an attempt
-   was made.
+   Single probe for the slot holding 'key'. If the key
+   isn't there it's inserted with 'value'; if it is, the
+   value is replaced only when 'overwrite' is set.
 */
-/*static int repeated_insert(assoc* assocs, void *key,
-                             void *value, int index);*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite);
+
+/* Stores a new key and its value in the unused slot 'index' */
+static void** fill_slot(assoc* assocs, assoc_size index, void* key,
+                        void* value);
+
+/* Fills 'keys' and 'values' from the slots, returns the number */
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values);
+
+/* wal_replay() callback: redoes one logged change, unlogged */
+static void replay_change(void* table, int op, void* key, void* data);
+
+/* load_words() callback: inserts one word, as assoc_insert() */
+static void insert_word(void* table, char* word);
+
+/* Frees the slot array and any keys cloned into it */
+static void release_slots(assoc* assocs);
+
+/* Takes the pair in slot 'index' out of the table, freeing its key */
+static void remove_slot(assoc* assocs, assoc_size index);
+
+/* An empty set already big enough for 'n' keys */
+static assoc* sized_set(size_t keysize, size_t n);
+
+/* sets_probe: looks up one batch of keys in the table 'table' */
+static void probe_batch(void* table, void** keys, int n, int* found);
+
+/* sets_add: puts 'key' into the set 'out' */
+static void add_key(void* out, void* key);
+
+/* This backend's part in the set operations */
+static const sets_ops set_ops = {collect_pairs, probe_batch, add_key};
 
 /* Testing on some of the private functions */
 void assoc_test();
 
-assoc* assoc_init(int keysize)
+assoc* assoc_init(size_t keysize)
+{
+    return assoc_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, sizeof(void *), alloc);
+}
+
+assoc* assoc_set_init(size_t keysize)
+{
+    return assoc_set_init_ex(keysize, &heap_allocator);
+}
+
+assoc* assoc_set_init_ex(size_t keysize, const assoc_allocator* alloc)
+{
+    return make_assoc(keysize, 0, alloc);
+}
+
+/*
+   One allocation: the struct with the small slots and their
+   control bytes after it, so a table that never holds more
+   than a handful of pairs costs a single malloc() and free()
+*/
+static assoc* make_assoc(size_t keysize, size_t valuesize,
+                         const assoc_allocator* alloc)
 {
-    int full_keysize;
     assoc* assocs;
 
-    assocs = malloc(sizeof(*assocs));
+    if(alloc == NULL){
+        alloc = &heap_allocator;
+    }
+    assocs = mem_alloc(alloc, sizeof(*assocs) +
+                              SMALLBYTES(slot_size(keysize, valuesize)));
+    assocs->alloc = *alloc;
     assocs->keysize = keysize;
-    assocs->length = SIZE;
+    assocs->valuesize = valuesize;
+    assocs->borrowed = false;
+    assocs->words = NULL;
+    assocs->slotsize = slot_size(keysize, valuesize);
+    assocs->length = SMALLMAX;
     assocs->count = 0;
-    /* Special case of (char *) */
-    if(keysize == 0){
-        full_keysize = sizeof(char *) * assocs->length;
+    assocs->slots = INLINESLOTS(assocs);
+    assocs->ctrl = (unsigned char *) assocs->slots +
+                   (size_t) assocs->slotsize * SMALLMAX;
+    assocs->filter = NULL;
+    assocs->filter_bits = 0;
+    assocs->frozen = NULL;
+    assocs->compact = NULL;
+    assocs->shared = NULL;
+    assocs->cache = NULL;
+    assocs->log = NULL;
+    assocs->file = NULL;
+    assocs->hitters = NULL;
+
+    return assocs;
+}
+
+/*
+   Sized so that 'capacity' pairs keep the table no fuller
+   than a growing one would get, each slot one word longer
+   for its reference bit and expiry
+*/
+assoc* assoc_cache_init(size_t keysize, size_t capacity)
+{
+    assoc* assocs;
+
+    if(capacity == 0){
+        on_error("A cache needs room for at least one pair");
     }
-    else{
-        full_keysize = keysize * assocs->length;
+    assocs = make_assoc(keysize, sizeof(void *), NULL);
+    release_slots(assocs);
+    assocs->slotsize = CACHESLOT(assocs->slotsize);
+    assocs->length = SIZE;
+    while(assocs->length / RESIZEHALF < capacity){
+        if(assocs->length > ASSOCMAX / DOUBLE){
+            on_error("Cache capacity is too big for its index type");
+        }
+        assocs->length *= DOUBLE;
     }
-    assocs->keys = malloc(full_keysize);
-    memset(assocs->keys, 0, full_keysize);
-    assocs->values = malloc(sizeof(void *) * assocs->length);
-    memset(assocs->values, 0, sizeof(*assocs->values) * assocs->length);
-
+    assocs->slots = mem_alloc(&assocs->alloc, (size_t) assocs->slotsize *
+                                              assocs->length);
+    assocs->ctrl = mem_alloc(&assocs->alloc, assocs->length);
+    assocs->cache = mem_alloc(&assocs->alloc, sizeof(cache));
+    assocs->cache->capacity = capacity;
     return assocs;
 }
 
+void assoc_cache_ttl(assoc* assocs, unsigned long ms)
+{
+    if(assocs->cache == NULL){
+        on_error("Only a cache has a time to live");
+    }
+    assocs->cache->ttl = ms;
+}
+
 void assoc_insert(assoc** a, void* key, void* data)
 {
-    assoc* assocs;
-    assocs = *a;
-    /* If array is 50% filled, resize it */
-    if(assocs->count == assocs->length / RESIZEHALF){
-        expand_assoc(assocs);
+    if((*a)->hitters != NULL){
+        heavy_add((*a)->hitters, key, hash_key((*a)->keysize, key));
+        (*a)->count = (assoc_size) heavy_size((*a)->hitters);
+        return;
+    }
+    if((*a)->file != NULL){
+        linear_insert((*a)->file, key, data);
+        (*a)->count = (assoc_size) linear_count((*a)->file);
+        return;
+    }
+    find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
     }
-    /* Count = true */
-    insert_one(assocs, key, data, true);
 }
 
-unsigned int assoc_count(assoc* assocs)
+void** assoc_upsert(assoc** a, void* key, void* data)
 {
-    return assocs->count;
+    void **stored;
+
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    if((*a)->file != NULL){
+        on_error("A file-backed table keeps copies of data, not pointers");
+    }
+    if((*a)->hitters != NULL){
+        on_error("A heavy-hitter table keeps counts, not data");
+    }
+    stored = find_or_insert(*a, key, data, true);
+    if((*a)->log != NULL){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+    return stored;
 }
 
-static void* lookup_strings(assoc* assocs, char* key)
+/* Only a new key changes the table, so only that is logged */
+void** assoc_get_or_insert(assoc** a, void* key, void* data)
 {
-    char **string_keys;
-    int index, comparison;
+    void **stored;
+    assoc_size count;
 
-    string_keys = (char **) assocs->keys;
-    index = hash_key(assocs->keysize, key) % assocs->length;
+    if((*a)->valuesize == 0){
+        on_error("A set has no data to update");
+    }
+    if((*a)->file != NULL){
+        on_error("A file-backed table keeps copies of data, not pointers");
+    }
+    if((*a)->hitters != NULL){
+        on_error("A heavy-hitter table keeps counts, not data");
+    }
+    count = (*a)->count;
+    stored = find_or_insert(*a, key, data, false);
+    if((*a)->log != NULL && (*a)->count != count){
+        wal_append((*a)->log, WALINSERT, key, data);
+    }
+    return stored;
+}
 
-    comparison = (COMPARE);
-     /* No equal key found */
-    while(comparison != 0){
-        if(assocs->values[index] == NULL){
-            return NULL;
+int assoc_remove(assoc* assocs, void* key)
+{
+    assoc_size index;
+
+    if(assocs->file != NULL){
+        if(!linear_remove(assocs->file, key)){
+            return 0;
         }
-        if(assocs->values[index] != VACANT){
-            comparison = strcmp(string_keys[index], key);
+        assocs->count -= ADDONE;
+        return 1;
+    }
+    if(assocs->slots == NULL){
+        on_error("Cannot remove from a read-only table");
+    }
+    index = find_key(assocs, key);
+    if(index == NOTFOUND){
+        return 0;
+    }
+    remove_slot(assocs, index);
+    if(assocs->log != NULL){
+        wal_append(assocs->log, WALREMOVE, key, NULL);
+    }
+    return 1;
+}
+
+size_t assoc_count(assoc* assocs)
+{
+    return assocs->count;
+}
+
+size_t assoc_capacity(assoc* assocs)
+{
+    if(assocs->hitters != NULL){
+        return assocs->hitters->capacity;
+    }
+    /* Read-only tables never grow */
+    if(assocs->slots == NULL){
+        return assocs->count;
+    }
+    /* Nor do caches, they evict */
+    if(assocs->cache != NULL){
+        return assocs->cache->capacity;
+    }
+    if(SMALL(assocs)){
+        return SMALLMAX;
+    }
+    return assocs->length / RESIZEHALF;
+}
+
+void assoc_borrow_keys(assoc* assocs)
+{
+    if(assocs->count != 0 || assocs->slots == NULL){
+        on_error("Keys can only be borrowed by an empty table");
+    }
+    assocs->borrowed = true;
+}
+
+size_t assoc_load_words(assoc** a, const char* path)
+{
+    if((*a)->keysize != 0){
+        on_error("Words can only go into a table of strings");
+    }
+    return load_words(path, insert_word, a,
+                      (*a)->borrowed ? &(*a)->words : NULL);
+}
+
+static void insert_word(void* table, char* word)
+{
+    assoc_insert((assoc **) table, word, NULL);
+}
+
+static void* lookup_strings(assoc* assocs, char* key, unsigned long hash)
+{
+    assoc_size index;
+
+    index = hash % assocs->length;
+
+    /* A never used slot ends the probe: no equal key found */
+    while(assocs->ctrl[index] == SLOTFULL){
+        if(strcmp(SLOTSTRING(assocs, index), key) == 0){
+            return found_data(assocs, index, key);
         }
         index = (index + ADDONE) % assocs->length;
     }
-    return assocs->values[index];
+    return NULL;
 }
 
-static void* lookup_general(assoc* assocs, void* key)
+static void* lookup_general(assoc* assocs, void* key, unsigned long hash)
 {
-    char *buffer;
-    int memory_index, index, comparison;
+    assoc_size index;
 
-    buffer = (char *) assocs->keys;
-    index = hash_key(assocs->keysize, key) % assocs->length;
-    memory_index = index * assocs->keysize;
+    index = hash % assocs->length;
 
-    comparison = (COMPARE);
-    /* No equal key found */
-    while(comparison != 0){
-        if(assocs->values[index] == NULL){
-            return NULL;
+    /* A never used slot ends the probe: no equal key found */
+    while(assocs->ctrl[index] == SLOTFULL){
+        if(memcmp(SLOTKEY(assocs, index), key, assocs->keysize) == 0){
+            return found_data(assocs, index, key);
         }
         index = (index + ADDONE) % assocs->length;
-        comparison = memcmp(&buffer[memory_index], key,
-                            assocs->keysize);
     }
-    return assocs->values[index];
+    return NULL;
 }
 
 void* assoc_lookup(assoc* assocs, void* key)
 {
+    void *value;
+    assoc_size index;
+    unsigned long hash;
+
+    /*
+       Definite miss, don't touch the table. The filter is
+       keyed on the same hash as the table, so a key that gets
+       past it isn't hashed again.
+    */
+    hash = 0;
+    if(assocs->filter != NULL){
+        hash = hash_key(assocs->keysize, key);
+        if(!bloom_maybe(assocs->filter, hash)){
+            return NULL;
+        }
+    }
+    if(assocs->frozen != NULL){
+        value = frozen_lookup(assocs->frozen, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->compact != NULL){
+        value = compact_lookup(assocs->compact, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->shared != NULL){
+        value = shm_lookup(assocs->shared, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->file != NULL){
+        value = linear_lookup(assocs->file, key);
+        return assocs->valuesize || value == NULL ? value : key;
+    }
+    if(assocs->hitters != NULL){
+        return heavy_count(assocs->hitters, key,
+                           hash_key(assocs->keysize, key)) ? key : NULL;
+    }
+    if(SMALL(assocs)){
+        index = small_find(assocs, key);
+        return index == NOTFOUND ? NULL : found_data(assocs, index, key);
+    }
+    if(assocs->filter == NULL){
+        hash = hash_key(assocs->keysize, key);
+    }
     if(assocs->keysize == 0){
-        return lookup_strings(assocs, (char *) key);
+        return lookup_strings(assocs, (char *) key, hash);
     }
     else{
-        return lookup_general(assocs, key);
+        return lookup_general(assocs, key, hash);
     }
 }
 
 void assoc_free(assoc* assocs)
 {
-    int index;
-    char **string_keys;
+    assoc_allocator alloc;
 
-    if(assocs->keysize == 0){
-        string_keys = (char **) assocs->keys;
+    release_slots(assocs);
+    if(assocs->frozen != NULL){
+        frozen_free(assocs->frozen);
+    }
+    if(assocs->compact != NULL){
+        compact_free(assocs->compact);
+    }
+    if(assocs->shared != NULL){
+        shm_detach(assocs->shared);
+    }
+    if(assocs->filter != NULL){
+        bloom_free(assocs->filter);
+    }
+    if(assocs->cache != NULL){
+        mem_free(&assocs->alloc, assocs->cache, sizeof(cache));
+    }
+    if(assocs->log != NULL){
+        wal_close(assocs->log);
+    }
+    if(assocs->file != NULL){
+        linear_close(assocs->file);
+    }
+    if(assocs->hitters != NULL){
+        heavy_free(assocs->hitters);
+    }
+    wordfile_close(assocs->words);
+    alloc = assocs->alloc;
+    mem_free(&alloc, assocs,
+             sizeof(*assocs) +
+             SMALLBYTES(slot_size(assocs->keysize, assocs->valuesize)));
+}
+
+static void release_slots(assoc* assocs)
+{
+    assoc_size index;
+
+    if(assocs->slots == NULL){
+        return;
+    }
+    if(assocs->keysize == 0 && !assocs->borrowed){
         for(index = 0; index < assocs->length; index += 1){
-            if(string_keys[index] != NULL &&
-               string_keys[index] != VACANT){
-                free(string_keys[index]);
+            if(assocs->ctrl[index] == SLOTFULL){
+                mem_free(&assocs->alloc, SLOTSTRING(assocs, index),
+                         strlen(SLOTSTRING(assocs, index)) + ADDONE);
+            }
+        }
+    }
+    /* The small slots go with the struct */
+    if(!SMALL(assocs)){
+        mem_free(&assocs->alloc, assocs->slots,
+                 (size_t) assocs->slotsize * assocs->length);
+        mem_free(&assocs->alloc, assocs->ctrl, assocs->length);
+    }
+    assocs->slots = NULL;
+    assocs->ctrl = NULL;
+    assocs->length = 0;
+}
+/*
+   Lists every key (for strings, the string itself) and
+   its value, returning how many there were. Keys of a set
+   get PRESENT, so a read-only lookup can tell they're there.
+   A read-only table is listed by its own walk.
+*/
+static unsigned long collect_pairs(void* table, void** keys,
+                                   void** values)
+{
+    assoc* assocs;
+    unsigned long found;
+    assoc_size index;
+
+    assocs = (assoc *) table;
+    if(assocs->frozen != NULL){
+        return frozen_walk(assocs->frozen, keys, values);
+    }
+    if(assocs->compact != NULL){
+        return compact_walk(assocs->compact, keys, values);
+    }
+    if(assocs->shared != NULL){
+        return shm_walk(assocs->shared, keys, values);
+    }
+    found = 0;
+    for(index = 0; index < assocs->length; index += 1){
+        if(assocs->ctrl[index] == SLOTFULL){
+            if(assocs->keysize == 0){
+                keys[found] = SLOTSTRING(assocs, index);
+            }
+            else{
+                keys[found] = SLOTKEY(assocs, index);
             }
+            values[found] = assocs->valuesize ? SLOTVALUE(assocs, index)
+                                              : PRESENT;
+            found += 1;
         }
     }
-    free(assocs->keys);
-    free(assocs->values);
-    free(assocs);
+    return found;
+}
+/*
+   The frozen copy owns its keys, so the slots (and any
+   cloned string keys) can go straight away.
+*/
+void assoc_freeze(assoc* assocs)
+{
+    if(assocs->slots == NULL){
+        on_error("Table is already read-only");
+    }
+    assocs->frozen = frozen_copy(collect_pairs, assocs, assocs->count,
+                                 assocs->keysize, &assocs->alloc);
+    release_slots(assocs);
+}
+
+void assoc_compact(assoc* assocs)
+{
+    if(assocs->slots == NULL){
+        on_error("Table is already read-only");
+    }
+    assocs->compact = compact_copy(collect_pairs, assocs, assocs->count,
+                                   assocs->keysize, &assocs->alloc);
+    release_slots(assocs);
+}
+
+/*
+   Data is copied as 'datasize' bytes from where each value
+   points, since the pointers mean nothing in another process
+*/
+void assoc_publish(assoc* assocs, const char* name, size_t datasize)
+{
+    if(assocs->slots == NULL){
+        on_error("Only a live table can be published");
+    }
+    shm_publish_walk(name, collect_pairs, assocs, assocs->count,
+                     assocs->keysize, assocs->valuesize ? datasize : 0,
+                     &assocs->alloc);
+}
+
+assoc* assoc_attach(const char* name)
+{
+    assoc* assocs;
+    shm_table* t;
+
+    t = shm_attach(name);
+    assocs = make_assoc(shm_keysize(t),
+                        shm_datasize(t) ? sizeof(void *) : 0, NULL);
+    release_slots(assocs);
+    assocs->shared = t;
+    assocs->count = (assoc_size) shm_count(t);
+    return assocs;
+}
+
+int assoc_refresh(assoc* assocs)
+{
+    if(assocs->shared == NULL || !shm_refresh(assocs->shared)){
+        return 0;
+    }
+    assocs->count = (assoc_size) shm_count(assocs->shared);
+    if(assocs->filter != NULL){
+        filter_build(assocs);
+    }
+    return 1;
 }
 
-static char* clone_string(char* original)
+void assoc_unpublish(const char* name)
 {
-    char *clone;
-    int length;
+    shm_unpublish(name);
+}
 
-    length = strlen(original) + ADDONE;
-    clone = malloc(length);
+/*
+   Pairs are replayed through the same inserts and removes
+   as ever, but only once the log is attached do they get
+   logged, so replaying writes nothing
+*/
+size_t assoc_log(assoc** a, const char* path, size_t datasize,
+                 unsigned int group)
+{
+    wal* w;
 
-    strcpy(clone, original);
+    if((*a)->slots == NULL || (*a)->count != 0 || (*a)->log != NULL){
+        on_error("Only an empty live table can start a log");
+    }
+    if((*a)->cache != NULL){
+        on_error("A cache drops pairs by itself, so can't be logged");
+    }
+    w = wal_open(path, (*a)->keysize, (*a)->valuesize ? datasize : 0,
+                 group);
+    wal_replay(w, replay_change, *a);
+    (*a)->log = w;
+    return (*a)->count;
+}
 
-    return clone;
+static void replay_change(void* table, int op, void* key, void* data)
+{
+    if(op == WALINSERT){
+        find_or_insert((assoc *) table, key, data, true);
+    }
+    else{
+        assoc_remove((assoc *) table, key);
+    }
 }
 
-static void expand_strings(assoc* assocs, void **old_values,
-                           char **old_keys, int old_length)
+void assoc_checkpoint(assoc* assocs)
 {
-    int index;
-    memset(assocs->keys, 0, sizeof(char *) * assocs->length);
+    if(assocs->log == NULL || assocs->slots == NULL){
+        on_error("Only a live table with a log can be checkpointed");
+    }
+    wal_checkpoint(assocs->log, collect_pairs, assocs, assocs->count,
+                   assocs->valuesize != 0, &assocs->alloc);
+}
 
-    for(index = 0; index < old_length; index += 1){
-        if(old_values[index] != NULL && old_values[index] != VACANT){
-            insert_one(assocs,
-                       old_keys[index],
-                       old_values[index],
-                       /* Count = false */
-                       false);
+void assoc_sync(assoc* assocs)
+{
+    if(assocs->log == NULL){
+        on_error("Table has no log to sync");
+    }
+    wal_sync(assocs->log);
+}
+
+/*
+   Slots change in place, so there is nothing to share: the
+   snapshot is an O(n) copy, a frozen one owning its keys
+*/
+assoc* assoc_snapshot(assoc* assocs)
+{
+    assoc* snap;
+
+    if(assocs->slots == NULL){
+        on_error("Only a live table can be snapshotted");
+    }
+    snap = make_assoc(assocs->keysize, assocs->valuesize, &assocs->alloc);
+    release_slots(snap);
+    snap->frozen = frozen_copy(collect_pairs, assocs, assocs->count,
+                               assocs->keysize, &snap->alloc);
+    snap->count = (assoc_size) snap->frozen->count;
+    return snap;
+}
+
+/* Like an attached table, it has no slots of its own */
+assoc* assoc_file_init(const char* path, size_t keysize, size_t datasize)
+{
+    assoc* assocs;
+    linear* t;
+
+    t = linear_open(path, keysize, datasize);
+    assocs = make_assoc(keysize, datasize ? sizeof(void *) : 0, NULL);
+    release_slots(assocs);
+    assocs->file = t;
+    assocs->count = (assoc_size) linear_count(t);
+    return assocs;
+}
+
+/* Nor does a heavy-hitter table, its candidates are kept apart */
+assoc* assoc_topk_init(size_t keysize, size_t capacity)
+{
+    assoc* assocs;
+
+    assocs = make_assoc(keysize, 0, NULL);
+    release_slots(assocs);
+    assocs->hitters = heavy_init(keysize, capacity, &assocs->alloc);
+    return assocs;
+}
+
+size_t assoc_topk(assoc* assocs, void** keys, unsigned long* counts,
+                  size_t k)
+{
+    if(assocs->hitters == NULL){
+        on_error("Only a heavy-hitter table has a top k");
+    }
+    return heavy_top(assocs->hitters, keys, counts, k);
+}
+
+/*
+   The smaller table's keys are the ones probed, so the work
+   is proportional to the smaller of the two
+*/
+assoc* assoc_intersect(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    if(b->count < a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = sized_set(a->keysize, a->count);
+    sets_probe_into(&set_ops, out, a, a->count, b, true, &a->alloc);
+    return out;
+}
+
+assoc* assoc_union(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    if(b->count > a->count){
+        out = a;
+        a = b;
+        b = out;
+    }
+    out = sized_set(a->keysize, (size_t) a->count + b->count);
+    sets_add_all(&set_ops, out, a, a->count, &a->alloc);
+    sets_probe_into(&set_ops, out, b, b->count, a, false, &b->alloc);
+    return out;
+}
+
+assoc* assoc_difference(assoc* a, assoc* b)
+{
+    assoc *out;
+
+    sets_check(a->slots != NULL && b->slots != NULL, a->keysize,
+               b->keysize);
+    out = sized_set(a->keysize, a->count);
+    sets_probe_into(&set_ops, out, a, a->count, b, false, &a->alloc);
+    return out;
+}
+
+/*
+   Growing an empty table costs next to nothing, and
+   afterwards filling it never has to grow it again
+*/
+static assoc* sized_set(size_t keysize, size_t n)
+{
+    assoc* out;
+
+    out = make_assoc(keysize, 0, NULL);
+    while(assoc_capacity(out) < n){
+        expand_assoc(out);
+    }
+    return out;
+}
+
+/*
+   Every key's home slot is prefetched before any of them is
+   probed, so the batch's cache misses overlap rather than
+   each waiting for the one before
+*/
+static void probe_batch(void* table, void** keys, int n, int* found)
+{
+    assoc *against;
+    assoc_size homes[SETBATCH], index;
+    int k;
+
+    against = (assoc *) table;
+    if(SMALL(against)){
+        for(k = 0; k < n; k += 1){
+            found[k] = small_find(against, keys[k]) != NOTFOUND;
         }
+        return;
     }
+    for(k = 0; k < n; k += 1){
+        homes[k] = hash_key(against->keysize, keys[k]) % against->length;
+        PREFETCH(&against->ctrl[homes[k]]);
+        PREFETCH(&against->slots[(size_t) homes[k] * against->slotsize]);
+    }
+    for(k = 0; k < n; k += 1){
+        index = homes[k];
+        while(against->ctrl[index] == SLOTFULL &&
+              !key_equal(against, index, keys[k])){
+            index = (index + ADDONE) % against->length;
+        }
+        found[k] = against->ctrl[index] == SLOTFULL;
+    }
+}
+
+static void add_key(void* out, void* key)
+{
+    find_or_insert((assoc *) out, key, NULL, true);
+}
+
+double assoc_compact_bytes(assoc* assocs)
+{
+    return compact_bytes_per_key(assocs->compact);
+}
+
+double assoc_frozen_bits(assoc* assocs)
+{
+    return frozen_bits_per_key(assocs->frozen);
+}
+
+void assoc_filter(assoc* assocs, int bits)
+{
+    if(bits > 0 && assocs->file != NULL){
+        on_error("A file-backed table can't have a filter");
+    }
+    if(bits > 0 && assocs->hitters != NULL){
+        on_error("A heavy-hitter table can't have a filter");
+    }
+    bloom_free(assocs->filter);
+    assocs->filter = NULL;
+    assocs->filter_bits = bits;
+    if(bits > 0){
+        filter_build(assocs);
+    }
+}
+
+double assoc_filter_fpr(assoc* assocs)
+{
+    return bloom_fpr(assocs->filter);
+}
+
+/*
+   Sized for the most keys the table holds before its
+   next resize, so the filter is rebuilt on each resize.
+   A read-only table never grows, so size it for its keys.
+*/
+static void filter_build(assoc* assocs)
+{
+    bloom_free(assocs->filter);
+    assocs->filter = bloom_build(collect_pairs, assocs, assoc_capacity(assocs),
+                                 assocs->filter_bits, assocs->keysize,
+                                 &assocs->alloc);
 }
 
-static void expand_general(assoc* assocs, void **old_values,
-                           void *old_keys, int old_length)
+static size_t slot_size(size_t keysize, size_t valuesize)
 {
-    char *buffer;
-    int index, memory_index, full_keysize;
+    size_t aligned;
 
-    memset(assocs->keys, 0, assocs->keysize * assocs->length);
-    full_keysize = assocs->keysize * assocs->length;
-    memset(assocs->keys, 0, full_keysize);
+    /* Special case of (char *) */
+    if(keysize == 0){
+        keysize = sizeof(char *);
+    }
+    if(valuesize == 0){
+        return keysize;
+    }
+    aligned = (keysize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    return valuesize + aligned;
+}
 
-    buffer = (char *) old_keys;
+/*
+   An expired pair in a cache is evicted as it is found
+   and reported missing; otherwise it's marked as used
+*/
+static void* found_data(assoc* assocs, assoc_size index, void* key)
+{
+    if(assocs->cache != NULL && !cache_touch(&SLOTCACHE(assocs, index))){
+        remove_slot(assocs, index);
+        return NULL;
+    }
+    if(assocs->valuesize == 0){
+        return key;
+    }
+    return SLOTVALUE(assocs, index);
+}
+/*
+   Slots are moved as they are: string keys go across as
+   pointers, not cloned again.
+*/
+static void place_slot(assoc* assocs, char* slot)
+{
+    void *key;
+    assoc_size index;
+
+    key = slot + assocs->valuesize;
+    if(assocs->keysize == 0){
+        key = *(char **) key;
+    }
+    index = hash_key(assocs->keysize, key) % assocs->length;
+    while(assocs->ctrl[index] == SLOTFULL){
+        index = (index + ADDONE) % assocs->length;
+    }
+    /* May be the very slot it came from */
+    memmove(&assocs->slots[(size_t) index * assocs->slotsize], slot,
+            assocs->slotsize);
+    assocs->ctrl[index] = SLOTFULL;
+}
+/*
+   With power of two lengths every key either stays in the
+   low half or moves up by exactly 'old_length'. Sweeping the
+   old slots from just after a never used one, each key's
+   home lies in the part already swept, so a key staying low
+   lands at or before where it was, and the sweep can rehash
+   in place. Only the run before that first unused slot,
+   which may have wrapped round from the end, is put aside
+   and placed last.
+*/
+static void rehash_in_place(assoc* assocs, assoc_size old_length)
+{
+    char *wrapped;
+    size_t bytes;
+    assoc_size first, index, moved;
 
-    for(index = 0; index < old_length; index += 1){
-        if(old_values[index] != NULL && old_values[index] != VACANT){
-            memory_index = index * assocs->keysize;
-            insert_one(assocs,
-                       &buffer[memory_index],
-                       old_values[index],
-                      /* Count = false */
-                       false);
-       }
+    for(first = 0; assocs->ctrl[first] != SLOTEMPTY; first += 1){
+        /* At most half full, so there is one */
+    }
+    bytes = (size_t) first * assocs->slotsize;
+    wrapped = NULL;
+    moved = 0;
+    if(first > 0){
+        wrapped = mem_alloc(&assocs->alloc, bytes);
+        for(index = 0; index < first; index += 1){
+            if(assocs->ctrl[index] == SLOTFULL){
+                memcpy(wrapped + (size_t) moved * assocs->slotsize,
+                       &assocs->slots[(size_t) index * assocs->slotsize],
+                       assocs->slotsize);
+                moved += 1;
+            }
+            assocs->ctrl[index] = SLOTEMPTY;
+        }
+    }
+    for(index = first + 1; index < old_length; index += 1){
+        if(assocs->ctrl[index] == SLOTFULL){
+            assocs->ctrl[index] = SLOTEMPTY;
+            place_slot(assocs,
+                       &assocs->slots[(size_t) index * assocs->slotsize]);
+        }
+        else{
+            assocs->ctrl[index] = SLOTEMPTY;
+        }
+    }
+    for(index = 0; index < moved; index += 1){
+        place_slot(assocs, wrapped + (size_t) index * assocs->slotsize);
+    }
+    if(wrapped != NULL){
+        mem_free(&assocs->alloc, wrapped, bytes);
     }
 }
 /*
    If 50% of the spaces are guaranteed to be empty,
    there's ~50% chance of no hash collisions when
-   trying to insert an element.
+   trying to insert an element. The arrays grow where they
+   are if the allocator can manage it (mremap() for big
+   ones), so a resize needs the new size, not old + new.
 */
 static void expand_assoc(assoc* assocs)
 {
-    void **old_values;
-    void *old_keys;
-    int old_length;
+    assoc_size old_length;
 
-    old_values = assocs->values;
-    old_keys = assocs->keys;
+    if(SMALL(assocs)){
+        spill(assocs);
+        return;
+    }
+    if(assocs->length > ASSOCMAX / DOUBLE){
+        on_error("Table has outgrown its index type");
+    }
     old_length = assocs->length;
+    assocs->length = old_length * DOUBLE;
+    assocs->slots = mem_realloc(&assocs->alloc, assocs->slots,
+                                (size_t) assocs->slotsize * old_length,
+                                (size_t) assocs->slotsize * assocs->length);
+    assocs->ctrl = mem_realloc(&assocs->alloc, assocs->ctrl,
+                               old_length, assocs->length);
+    /* Only the control bytes need to start out empty */
+    memset(assocs->ctrl + old_length, SLOTEMPTY, old_length);
+    rehash_in_place(assocs, old_length);
+
+    if(assocs->filter != NULL){
+        filter_build(assocs);
+    }
+}
 
-    assocs->length = assocs->length * DOUBLE;
-    assocs->values = malloc(sizeof(*assocs->values) * assocs->length);
-    memset(assocs->values, 0, sizeof(*assocs->values) * assocs->length);
+/*
+   Up to SMALLMAX pairs, one after another, compared in turn:
+   cheaper than hashing the key, and all of them share a
+   cache line or two with the struct. Strings are told apart
+   by their first character before calling strcmp().
+*/
+static assoc_size small_find(assoc* assocs, void* key)
+{
+    assoc_size index;
+    char *s;
 
     if(assocs->keysize == 0){
-        assocs->keys = malloc(sizeof(char *) * assocs->length);
-        expand_strings(assocs, old_values, (char **) old_keys, old_length);
+        s = (char *) key;
+        for(index = 0; index < assocs->count; index += 1){
+            if(SLOTSTRING(assocs, index)[0] == s[0] &&
+               strcmp(SLOTSTRING(assocs, index), s) == 0){
+                return index;
+            }
+        }
+        return NOTFOUND;
     }
-    else{
-        assocs->keys = malloc(assocs->keysize * assocs->length);
-        expand_general(assocs, old_values, old_keys, old_length);
+    for(index = 0; index < assocs->count; index += 1){
+        if(memcmp(SLOTKEY(assocs, index), key, assocs->keysize) == 0){
+            return index;
+        }
     }
-    free(old_values);
-    free(old_keys);
+    return NOTFOUND;
 }
-
-static int hash_key(int keysize, void* key)
+/*
+   Slots move as they are, as on a resize, into arrays with
+   room for the pair that is about to be added. The small
+   slots stay part of the struct's block, unused from now on.
+*/
+static void spill(assoc* assocs)
 {
-    char* buffer;
-    int hash_a, hash_b, hash_c, index;
-    unsigned long value_a, value_b;
+    char *small;
+    unsigned char *ctrl;
+    assoc_size index, length;
 
-    if(keysize == 0){
-        keysize = strlen((char *) key);
+    small = assocs->slots;
+    ctrl = assocs->ctrl;
+    length = assocs->length;
+    assocs->length = SIZE;
+    while(assocs->length / RESIZEHALF <= SMALLMAX){
+        assocs->length *= DOUBLE;
     }
-    hash_a = HASHVALUE;
-    hash_b = 0;
-
-    buffer = (char *) key;
-    for(index = 0; index < keysize; index += 1){
-        value_a = ((unsigned int) buffer[index]) + ADDBUFFER;
-        value_b = (int) buffer[index];
-        hash_a *= value_a;
-        hash_b -= value_b - hash_b;
+    assocs->slots = mem_alloc(&assocs->alloc, (size_t) assocs->slotsize *
+                                              assocs->length);
+    assocs->ctrl = mem_alloc(&assocs->alloc, assocs->length);
+    for(index = 0; index < length; index += 1){
+        if(ctrl[index] == SLOTFULL){
+            place_slot(assocs, &small[(size_t) index * assocs->slotsize]);
+        }
+    }
+    if(assocs->filter != NULL){
+        filter_build(assocs);
     }
-    hash_c = (hash_a ^ hash_b);
-    return hash_c < 0 ? -hash_c : hash_c;
 }
 
 static void insert_key_string(assoc* assocs, char* key,
-                              int index, int copy_this)
+                              assoc_size index, int copy_this)
 {
-    char **string_keys;
-    string_keys = (char **) assocs->keys;
-
-    if(copy_this){
-        string_keys[index] = clone_string(key);
+    if(copy_this && !assocs->borrowed){
+        SLOTSTRING(assocs, index) = mem_strdup(&assocs->alloc, key);
     }
     else{
-        string_keys[index] = key;
+        SLOTSTRING(assocs, index) = key;
     }
 }
 
 static void insert_key_general(assoc* assocs, void* key,
-                               int index)
+                               assoc_size index)
 {
-    char *buffer;
-    int memory_index;
-
-    buffer = (char *) assocs->keys;
-    memory_index = index * assocs->keysize;
-
-    memcpy(&buffer[memory_index], key, assocs->keysize);
+    memcpy(SLOTKEY(assocs, index), key, assocs->keysize);
 }
 /*
-   "Count" is also used in "expand_assoc", because when
-   the array is expanded,  everything is hashed again in
-   newer arrays. These insertions in "expand_assoc" should
-   not be counted.
+   Places a key without looking for an equal one first,
+   as assoc_test() does. Resizing used to come through here
+   with "count" false; it now moves whole slots instead.
 */
 static void insert_one(assoc* assocs, void* key, void* value,
                        int count)
 {
-    int index;
+    assoc_size index;
+
+    if(SMALL(assocs)){
+        spill(assocs);
+    }
     index = hash_key(assocs->keysize, key) % assocs->length;
 
-    while(assocs->values[index] != NULL && assocs->values[index] != VACANT){
+    while(assocs->ctrl[index] == SLOTFULL){
         index = (index + ADDONE) % assocs->length;
     }
     if(assocs->keysize == 0){
@@ -327,31 +1079,190 @@ static void insert_one(assoc* assocs, void* key, void* value,
     else{
         insert_key_general(assocs, key, index);
     }
-    assocs->values[index] = value;
+    if(assocs->valuesize){
+        SLOTVALUE(assocs, index) = value;
+    }
+    assocs->ctrl[index] = SLOTFULL;
     if(count){
         assocs->count += ADDONE;
+        if(assocs->filter != NULL){
+            bloom_add(assocs->filter, hash_key(assocs->keysize, key));
+        }
     }
 }
 
+static bool key_equal(assoc* assocs, assoc_size index, void* key)
+{
+    if(assocs->keysize == 0){
+        return strcmp(SLOTSTRING(assocs, index), (char *) key) == 0;
+    }
+    return memcmp(SLOTKEY(assocs, index), key, assocs->keysize) == 0;
+}
+
+static assoc_size find_key(assoc* assocs, void* key)
+{
+    assoc_size index;
+
+    if(SMALL(assocs)){
+        return small_find(assocs, key);
+    }
+    index = hash_key(assocs->keysize, key) % assocs->length;
+    while(assocs->ctrl[index] == SLOTFULL){
+        if(key_equal(assocs, index, key)){
+            return index;
+        }
+        index = (index + ADDONE) % assocs->length;
+    }
+    return NOTFOUND;
+}
 /*
-static int repeated_insert(assoc* assocs, void *key,
-                           void *value, int index)
+   A small table appends new keys until it's full, then
+   spills and carries on as a hashed one.
+*/
+static void** find_or_insert(assoc* assocs, void* key, void* value,
+                             bool overwrite)
 {
-    char *buffer;
-    int memory_index;
+    assoc_size index;
 
-    buffer = (char *) assocs->keys;
-    memory_index = index * assocs->keysize;
+    if(assocs->slots == NULL){
+        on_error("Cannot insert into a read-only table");
+    }
+    if(SMALL(assocs)){
+        index = small_find(assocs, key);
+        if(index != NOTFOUND){
+            if(assocs->valuesize == 0){
+                return NULL;
+            }
+            if(overwrite){
+                SLOTVALUE(assocs, index) = value;
+            }
+            return &SLOTVALUE(assocs, index);
+        }
+        if(assocs->count < SMALLMAX){
+            return fill_slot(assocs, assocs->count, key, value);
+        }
+        spill(assocs);
+    }
+
+    /* If array is 50% filled, resize it; caches evict instead */
+    if(assocs->cache == NULL &&
+       assocs->count == assocs->length / RESIZEHALF){
+        expand_assoc(assocs);
+    }
+    index = hash_key(assocs->keysize, key) % assocs->length;
+
+    while(assocs->ctrl[index] == SLOTFULL){
+        if(key_equal(assocs, index, key)){
+            if(assocs->cache != NULL){
+                overwrite = cache_hit(assocs->cache,
+                                      &SLOTCACHE(assocs, index), overwrite);
+            }
+            if(assocs->valuesize == 0){
+                return NULL;
+            }
+            if(overwrite){
+                SLOTVALUE(assocs, index) = value;
+            }
+            return &SLOTVALUE(assocs, index);
+        }
+        index = (index + ADDONE) % assocs->length;
+    }
+    /* Evicting moves slots about, so look again afterwards */
+    if(assocs->cache != NULL &&
+       assocs->count == assocs->cache->capacity){
+        remove_slot(assocs,
+                    (assoc_size) cache_victim(assocs->cache, assocs->ctrl,
+                                              SLOTFULL, assocs->slots,
+                                              assocs->slotsize,
+                                              assocs->length));
+        return find_or_insert(assocs, key, value, overwrite);
+    }
+    return fill_slot(assocs, index, key, value);
+}
 
-    if(memcmp(&buffer[memory_index], key, assocs->keysize) == 0){
-        assocs->values[index] = value;
-        return true;
+static void** fill_slot(assoc* assocs, assoc_size index, void* key,
+                        void* value)
+{
+    if(assocs->keysize == 0){
+        insert_key_string(assocs, (char *) key, index, true);
+    }
+    else{
+        insert_key_general(assocs, key, index);
+    }
+    assocs->ctrl[index] = SLOTFULL;
+    assocs->count += ADDONE;
+    if(assocs->filter != NULL){
+        bloom_add(assocs->filter, hash_key(assocs->keysize, key));
+    }
+    if(assocs->cache != NULL){
+        SLOTCACHE(assocs, index) = cache_fresh(assocs->cache);
     }
-    return false;
+    if(assocs->valuesize == 0){
+        return NULL;
+    }
+    SLOTVALUE(assocs, index) = value;
+    return &SLOTVALUE(assocs, index);
 }
+
+/*
+   Backward shift deletion: a tombstone would do, but a
+   cache never resizes, so nothing would ever clear them out.
+   Instead each later key in the run moves back into the gap,
+   unless that would put it before its home slot. So a slot
+   is only ever EMPTY or FULL, and the first EMPTY one ends
+   any probe.
 */
+static void remove_slot(assoc* assocs, assoc_size index)
+{
+    assoc_size next, home;
+    void *key;
+
+    if(assocs->keysize == 0 && !assocs->borrowed){
+        mem_free(&assocs->alloc, SLOTSTRING(assocs, index),
+                 strlen(SLOTSTRING(assocs, index)) + ADDONE);
+    }
+    assocs->ctrl[index] = SLOTEMPTY;
+    assocs->count -= ADDONE;
+
+    /* A small table stays dense: its last pair fills the gap */
+    if(SMALL(assocs)){
+        if(index != assocs->count){
+            memcpy(&assocs->slots[(size_t) index * assocs->slotsize],
+                   &assocs->slots[(size_t) assocs->count *
+                                  assocs->slotsize],
+                   assocs->slotsize);
+            assocs->ctrl[index] = SLOTFULL;
+            assocs->ctrl[assocs->count] = SLOTEMPTY;
+        }
+        return;
+    }
+
+    next = (index + ADDONE) % assocs->length;
+    while(assocs->ctrl[next] == SLOTFULL){
+        key = SLOTKEY(assocs, next);
+        if(assocs->keysize == 0){
+            key = *(char **) key;
+        }
+        home = hash_key(assocs->keysize, key) % assocs->length;
+        /* Stays put if its home lies (cyclically) in (index, next] */
+        if(index < next ? home <= index || home > next
+                        : home <= index && home > next){
+            memcpy(&assocs->slots[(size_t) index * assocs->slotsize],
+                   &assocs->slots[(size_t) next * assocs->slotsize],
+                   assocs->slotsize);
+            assocs->ctrl[index] = SLOTFULL;
+            assocs->ctrl[next] = SLOTEMPTY;
+            index = next;
+        }
+        next = (next + ADDONE) % assocs->length;
+    }
+    if(assocs->filter != NULL && assocs->cache != NULL &&
+       cache_forget(assocs->cache)){
+        filter_build(assocs);
+    }
+}
 
-/* Testing on clone_string, insert_one and expand_assoc */
+/* Testing on mem_strdup(), insert_one and expand_assoc */
 
 void assoc_test()
 {
@@ -364,29 +1275,29 @@ void assoc_test()
     char *string_p, *string_q, *string_r;
     char *string_s, *string_t, *string_v;
 
-    int old_length;
-
-    string_a = clone_string("abc");
-    string_b = clone_string("def");
-    string_c = clone_string("ghi");
-    string_d = clone_string("jkl");
-    string_e = clone_string("mno");
-    string_f = clone_string("pqr");
-    string_g = clone_string("stv");
-    string_h = clone_string("uwx");
-    string_i = clone_string("dance");
-    string_j = clone_string("woodland");
-    string_k = clone_string("wizard");
-    string_l = clone_string("lizard");
-    string_m = clone_string("fiver");
-    string_n = clone_string("household");
-    string_o = clone_string("lockdown");
-    string_p = clone_string("jumping");
-    string_q = clone_string("turkey");
-    string_r = clone_string("fireplace");
-    string_s = clone_string("snowman");
-    string_t = clone_string("dancing");
-    string_v = clone_string("whiskey");
+    assoc_size old_length;
+
+    string_a = mem_strdup(&heap_allocator, "abc");
+    string_b = mem_strdup(&heap_allocator, "def");
+    string_c = mem_strdup(&heap_allocator, "ghi");
+    string_d = mem_strdup(&heap_allocator, "jkl");
+    string_e = mem_strdup(&heap_allocator, "mno");
+    string_f = mem_strdup(&heap_allocator, "pqr");
+    string_g = mem_strdup(&heap_allocator, "stv");
+    string_h = mem_strdup(&heap_allocator, "uwx");
+    string_i = mem_strdup(&heap_allocator, "dance");
+    string_j = mem_strdup(&heap_allocator, "woodland");
+    string_k = mem_strdup(&heap_allocator, "wizard");
+    string_l = mem_strdup(&heap_allocator, "lizard");
+    string_m = mem_strdup(&heap_allocator, "fiver");
+    string_n = mem_strdup(&heap_allocator, "household");
+    string_o = mem_strdup(&heap_allocator, "lockdown");
+    string_p = mem_strdup(&heap_allocator, "jumping");
+    string_q = mem_strdup(&heap_allocator, "turkey");
+    string_r = mem_strdup(&heap_allocator, "fireplace");
+    string_s = mem_strdup(&heap_allocator, "snowman");
+    string_t = mem_strdup(&heap_allocator, "dancing");
+    string_v = mem_strdup(&heap_allocator, "whiskey");
 
     assert(strcmp(string_a, "abc") == 0);
     assert(strcmp(string_b, "def") == 0);
@@ -0,0 +1,47 @@
+#include "sets.h"
+#include "../../../ADTs/General/general.h"
+
+void sets_check(int live, size_t keysize_a, size_t keysize_b)
+{
+    if(!live){
+        on_error("Set operations need live (not read-only) tables");
+    }
+    if(keysize_a != keysize_b){
+        on_error("Set operations need tables with the same keys");
+    }
+}
+
+void sets_add_all(const sets_ops* ops, void* out, void* from,
+                  unsigned long most, const assoc_allocator* al)
+{
+    pairs p;
+    unsigned long index;
+
+    pairs_collect(&p, ops->walk, from, most, al);
+    for(index = 0; index < p.count; index += 1){
+        ops->add(out, p.keys[index]);
+    }
+    pairs_free(&p);
+}
+/* The last batch is whatever is left over, so may be short */
+void sets_probe_into(const sets_ops* ops, void* out, void* from,
+                     unsigned long most, void* against, int want,
+                     const assoc_allocator* al)
+{
+    pairs p;
+    unsigned long start;
+    int found[SETBATCH];
+    int n, k;
+
+    pairs_collect(&p, ops->walk, from, most, al);
+    for(start = 0; start < p.count; start += SETBATCH){
+        n = p.count - start < SETBATCH ? (int) (p.count - start) : SETBATCH;
+        ops->probe(against, &p.keys[start], n, found);
+        for(k = 0; k < n; k += 1){
+            if((found[k] != 0) == (want != 0)){
+                ops->add(out, p.keys[start + k]);
+            }
+        }
+    }
+    pairs_free(&p);
+}
@@ -0,0 +1,58 @@
+/*
+   The work of the set operations, whatever the backend:
+   the keys of one table, listed by its pairs_walk, are
+   looked up in another a batch at a time, so a backend
+   that prefetches every key's slot before probing any of
+   them has the batch's cache misses overlap rather than
+   each wait for the one before. Only the batch lookup and
+   the insert into the result are each backend's own.
+*/
+
+#ifndef SETS_H
+#define SETS_H
+
+#include "../Pairs/pairs.h"
+
+/* Keys looked up together */
+#define SETBATCH 16
+
+/*
+   Sets found[k] non-zero if keys[k] is in 'table', zero
+   if not, for each k below 'n' (at most SETBATCH)
+*/
+typedef void (*sets_probe)(void* table, void** keys, int n, int* found);
+
+/* Puts 'key' into the set 'out' */
+typedef void (*sets_add)(void* out, void* key);
+
+/* What the set operations need from a backend */
+typedef struct sets_ops {
+
+    pairs_walk walk;
+    sets_probe probe;
+    sets_add add;
+
+} sets_ops;
+
+/*
+   Checks two tables can be combined: both live ('live'
+   non-zero) and with keys of the same size
+*/
+void sets_check(int live, size_t keysize_a, size_t keysize_b);
+
+/*
+   Puts every key of 'from', which holds at most 'most',
+   into 'out'. The key lists come from 'al'.
+*/
+void sets_add_all(const sets_ops* ops, void* out, void* from,
+                  unsigned long most, const assoc_allocator* al);
+
+/*
+   As sets_add_all(), for just the keys of 'from' that are
+   ('want' non-zero) or are not ('want' 0) in 'against'
+*/
+void sets_probe_into(const sets_ops* ops, void* out, void* from,
+                     unsigned long most, void* against, int want,
+                     const assoc_allocator* al);
+
+#endif
@@ -0,0 +1,368 @@
+/* shm_open(), mmap() and ftruncate() aren't C90 */
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+#include "../Hash/hash.h"
+#include "../../../ADTs/General/general.h"
+
+#define SHMMAGIC 0x41535348UL
+#define CONTROLMAGIC 0x4153434EUL
+/* The control segment: magic, then the current version */
+#define CONTROLWORDS 2
+#define VERSION 1
+/* Readers may race the unlinking of the version they read */
+#define ATTACHTRIES 16
+/* Slots are kept at most half full */
+#define LOADFACTOR 2
+/* Room for ".<version>" after the name */
+#define VERSIONCHARS 24
+#define SHMMODE 0644
+
+#define ALIGNUP(n) (((n) + SHMALIGN - 1) & ~((size_t) SHMALIGN - 1))
+
+/*
+   A reader must never see the new version number before
+   the segment it names has been completely written
+*/
+#ifdef __GNUC__
+#define PUBLISH_BARRIER() __sync_synchronize()
+#else
+#define PUBLISH_BARRIER()
+#endif
+
+/* "name.<version>", to be free()d */
+static char* version_name(const char* name, unsigned long version);
+/* Maps the control segment, creating it if 'create' */
+static volatile unsigned long* map_control(const char* name, int create);
+/* Maps whichever version the control segment currently names */
+static void map_current(shm_table* t);
+static size_t key_bytes(size_t keysize, const void* key);
+
+void shm_publish(const char* name, void** keys, void** values,
+                 unsigned long count, size_t keysize, size_t datasize)
+{
+    volatile unsigned long *control;
+    unsigned long version, nslots, n, index, h;
+    shm_header *header;
+    shm_slot *slots;
+    char *base, *segment, *old;
+    size_t size, offset;
+    int fd;
+
+    control = map_control(name, 1);
+    version = control[VERSION];
+
+    nslots = 1;
+    while(nslots < count * LOADFACTOR){
+        nslots *= 2;
+    }
+    size = ALIGNUP(sizeof(shm_header)) + nslots * sizeof(shm_slot);
+    for(n = 0; n < count; n += 1){
+        size += ALIGNUP(key_bytes(keysize, keys[n]));
+        if(values != NULL && values[n] != NULL){
+            size += ALIGNUP(datasize);
+        }
+    }
+
+    /* A builder that died mid-publish may have left this behind */
+    segment = version_name(name, version + 1);
+    shm_unlink(segment);
+    fd = shm_open(segment, O_CREAT | O_EXCL | O_RDWR, SHMMODE);
+    if(fd < 0 || ftruncate(fd, (off_t) size) != 0){
+        on_error("Cannot create shared memory segment");
+    }
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED){
+        on_error("Cannot mmap() shared memory segment");
+    }
+    close(fd);
+
+    /* ftruncate() zero fills, so every slot starts empty */
+    header = (shm_header*) base;
+    header->magic = SHMMAGIC;
+    header->keysize = keysize;
+    header->datasize = datasize;
+    header->count = count;
+    header->nslots = nslots;
+    header->size = size;
+    slots = (shm_slot*) (base + ALIGNUP(sizeof(shm_header)));
+    offset = ALIGNUP(sizeof(shm_header)) + nslots * sizeof(shm_slot);
+
+    for(n = 0; n < count; n += 1){
+        h = hash_key(keysize, keys[n]);
+        index = h & (nslots - 1);
+        while(slots[index].key != 0){
+            index = (index + 1) & (nslots - 1);
+        }
+        slots[index].hash = h;
+        slots[index].key = offset;
+        memcpy(base + offset, keys[n], key_bytes(keysize, keys[n]));
+        offset += ALIGNUP(key_bytes(keysize, keys[n]));
+        if(values != NULL && values[n] != NULL){
+            slots[index].data = offset;
+            memcpy(base + offset, values[n], datasize);
+            offset += ALIGNUP(datasize);
+        }
+    }
+    munmap(base, size);
+
+    PUBLISH_BARRIER();
+    control[VERSION] = version + 1;
+    PUBLISH_BARRIER();
+    munmap((void*) control, CONTROLWORDS * sizeof(unsigned long));
+
+    /* Readers still mapping it keep it until they let go */
+    if(version > 0){
+        old = version_name(name, version);
+        shm_unlink(old);
+        free(old);
+    }
+    free(segment);
+}
+
+void shm_publish_walk(const char* name, pairs_walk walk, void* table,
+                      unsigned long most, size_t keysize, size_t datasize,
+                      const assoc_allocator* al)
+{
+    pairs p;
+
+    pairs_collect(&p, walk, table, most, al);
+    shm_publish(name, p.keys, datasize ? p.values : NULL, p.count, keysize,
+                datasize);
+    pairs_free(&p);
+}
+
+shm_table* shm_attach(const char* name)
+{
+    shm_table* t;
+
+    t = (shm_table*) ncalloc(1, sizeof(shm_table));
+    t->name = (char*) ncalloc(strlen(name) + 1, 1);
+    strcpy(t->name, name);
+    t->control = map_control(name, 0);
+    map_current(t);
+    return t;
+}
+
+int shm_refresh(shm_table* t)
+{
+    char *base;
+    size_t size;
+
+    if(t->control[VERSION] == t->version){
+        return 0;
+    }
+    /* Keep the old one until the new one is in place */
+    base = t->base;
+    size = t->size;
+    map_current(t);
+    munmap(base, size);
+    return 1;
+}
+
+void* shm_lookup(shm_table* t, void* key)
+{
+    unsigned long h, index, mask;
+    const shm_slot *s;
+
+    h = hash_key(t->header->keysize, key);
+    mask = t->header->nslots - 1;
+    index = h & mask;
+
+    /* An empty slot ends the probe: no equal key found */
+    while((s = &t->slots[index])->key != 0){
+        if(s->hash == h &&
+           (t->header->keysize == 0
+                ? strcmp(t->base + s->key, (char*) key) == 0
+                : memcmp(t->base + s->key, key,
+                         t->header->keysize) == 0)){
+            if(t->header->datasize == 0){
+                return t->base + s->key;
+            }
+            return s->data ? t->base + s->data : NULL;
+        }
+        index = (index + 1) & mask;
+    }
+    return NULL;
+}
+
+void* shm_key(shm_table* t, unsigned long index)
+{
+    if(t->slots[index].key == 0){
+        return NULL;
+    }
+    return t->base + t->slots[index].key;
+}
+
+unsigned long shm_walk(void* table, void** keys, void** values)
+{
+    shm_table *t;
+    unsigned long index, found;
+
+    t = (shm_table *) table;
+    found = 0;
+    for(index = 0; index < t->header->nslots; index += 1){
+        if(t->slots[index].key != 0){
+            keys[found] = t->base + t->slots[index].key;
+            values[found] = t->slots[index].data != 0
+                            ? t->base + t->slots[index].data : NULL;
+            found += 1;
+        }
+    }
+    return found;
+}
+
+unsigned long shm_slots(shm_table* t)
+{
+    return t->header->nslots;
+}
+
+unsigned long shm_count(shm_table* t)
+{
+    return t->header->count;
+}
+
+size_t shm_keysize(shm_table* t)
+{
+    return t->header->keysize;
+}
+
+size_t shm_datasize(shm_table* t)
+{
+    return t->header->datasize;
+}
+
+void shm_detach(shm_table* t)
+{
+    munmap(t->base, t->size);
+    munmap((void*) t->control, CONTROLWORDS * sizeof(unsigned long));
+    free(t->name);
+    free(t);
+}
+
+void shm_unpublish(const char* name)
+{
+    volatile unsigned long *control;
+    char *current;
+    int fd;
+
+    /* Nothing to remove if it was never published */
+    fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0){
+        return;
+    }
+    close(fd);
+    control = map_control(name, 0);
+    current = version_name(name, control[VERSION]);
+    shm_unlink(current);
+    shm_unlink(name);
+    munmap((void*) control, CONTROLWORDS * sizeof(unsigned long));
+    free(current);
+}
+
+static char* version_name(const char* name, unsigned long version)
+{
+    char* s;
+
+    s = (char*) ncalloc(strlen(name) + VERSIONCHARS, 1);
+    sprintf(s, "%s.%lu", name, version);
+    return s;
+}
+
+static volatile unsigned long* map_control(const char* name, int create)
+{
+    volatile unsigned long *control;
+    struct stat st;
+    size_t size;
+    int fd;
+
+    size = CONTROLWORDS * sizeof(unsigned long);
+    if(create){
+        fd = shm_open(name, O_CREAT | O_RDWR, SHMMODE);
+    }
+    else{
+        fd = shm_open(name, O_RDONLY, 0);
+    }
+    if(fd < 0 || fstat(fd, &st) != 0){
+        on_error("Cannot open shared memory control segment");
+    }
+    /* First publication: version 0, i.e. nothing to attach yet */
+    if(create && st.st_size == 0 && ftruncate(fd, (off_t) size) != 0){
+        on_error("Cannot size shared memory control segment");
+    }
+    control = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, fd, 0);
+    if(control == MAP_FAILED){
+        on_error("Cannot mmap() shared memory control segment");
+    }
+    close(fd);
+    if(create && control[0] == 0){
+        control[0] = CONTROLMAGIC;
+    }
+    if(control[0] != CONTROLMAGIC){
+        on_error("Not a shared memory table");
+    }
+    return control;
+}
+/*
+   Between reading the version and opening its segment, the
+   builder may publish again and unlink it; the control
+   segment then names a newer one, so try that instead.
+*/
+static void map_current(shm_table* t)
+{
+    unsigned long version;
+    struct stat st;
+    char *segment;
+    void *base;
+    int fd, tries;
+
+    for(tries = 0; tries < ATTACHTRIES; tries += 1){
+        version = t->control[VERSION];
+        if(version == 0){
+            on_error("Nothing published under that name yet");
+        }
+        segment = version_name(t->name, version);
+        fd = shm_open(segment, O_RDONLY, 0);
+        free(segment);
+        if(fd < 0){
+            continue;
+        }
+        if(fstat(fd, &st) != 0){
+            on_error("Cannot stat shared memory segment");
+        }
+        base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED,
+                    fd, 0);
+        close(fd);
+        if(base == MAP_FAILED){
+            on_error("Cannot mmap() shared memory segment");
+        }
+        t->version = version;
+        t->base = (char*) base;
+        t->size = (size_t) st.st_size;
+        t->header = (const shm_header*) base;
+        if(t->header->magic != SHMMAGIC || t->header->size != t->size){
+            on_error("Corrupt shared memory segment");
+        }
+        t->slots = (const shm_slot*) (t->base +
+                                      ALIGNUP(sizeof(shm_header)));
+        return;
+    }
+    on_error("Shared memory table keeps changing, cannot attach");
+}
+
+static size_t key_bytes(size_t keysize, const void* key)
+{
+    if(keysize == 0){
+        return strlen((const char*) key) + 1;
+    }
+    return keysize;
+}
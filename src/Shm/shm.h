@@ -0,0 +1,122 @@
+/*
+   A read-only table living in a named POSIX shared-memory
+   segment, so many processes can look keys up in a single
+   copy. Nothing in the segment is a pointer: slots hold the
+   offsets of their key and data from the segment's start,
+   so it reads the same wherever each process maps it.
+
+   One builder publishes, any number of readers attach. Each
+   publication is a new segment "name.<version>"; the small
+   control segment "name" holds the current version, bumped
+   only once the new segment is complete. Readers notice the
+   bump with shm_refresh() and remap, while the superseded
+   segment is unlinked and lives on until its last reader
+   lets go of it.
+*/
+
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdlib.h>
+
+#include "../Pairs/pairs.h"
+
+/* Keys and data start on these boundaries in the segment */
+#define SHMALIGN 8
+
+/* What a published segment starts with */
+typedef struct shm_header {
+
+    unsigned long magic;
+    unsigned long keysize;
+    /* Bytes of data copied per key, 0 => keys only */
+    unsigned long datasize;
+    unsigned long count;
+    /* A power of two, at least twice 'count' */
+    unsigned long nslots;
+    unsigned long size;
+
+} shm_header;
+
+/* Key at offset 'key' (0 => empty slot), data at 'data' */
+typedef struct shm_slot {
+
+    unsigned long hash;
+    unsigned long key;
+    unsigned long data;
+
+} shm_slot;
+
+/* One reader's view of a published table */
+typedef struct shm_table {
+
+    char *name;
+    /* The control segment: its magic, then the version */
+    volatile unsigned long *control;
+    unsigned long version;
+
+    /* The mapping of "name.<version>" */
+    char *base;
+    size_t size;
+    const shm_header *header;
+    const shm_slot *slots;
+
+} shm_table;
+
+/*
+   Writes 'count' keys and the 'datasize' bytes each of their
+   'values' points at (NULL => none) into a new segment, then
+   makes it current. 'keysize' as for assoc_init(), 0 =>
+   '\0' terminated strings. 'name' is as for shm_open(),
+   i.e. "/something". Only one process may publish a name.
+*/
+void shm_publish(const char* name, void** keys, void** values,
+                 unsigned long count, size_t keysize, size_t datasize);
+
+/*
+   shm_publish() of every pair 'walk' finds in 'table', which
+   holds at most 'most', listed with arrays from 'al'. With
+   'datasize' 0 only the keys are published.
+*/
+void shm_publish_walk(const char* name, pairs_walk walk, void* table,
+                      unsigned long most, size_t keysize, size_t datasize,
+                      const assoc_allocator* al);
+
+/* Maps the current version of 'name' read-only */
+shm_table* shm_attach(const char* name);
+
+/*
+   Moves on to the current version if a newer one has been
+   published, returning 1 if so, 0 otherwise. Pointers from
+   shm_lookup() into the old version are then invalid.
+*/
+int shm_refresh(shm_table* t);
+
+/*
+   The data stored against 'key' (NULL => not found, or
+   published without data). Tables without data return the
+   segment's copy of the key instead.
+*/
+void* shm_lookup(shm_table* t, void* key);
+
+/* The key in slot 'index' (0 .. shm_slots()-1), NULL => empty */
+void* shm_key(shm_table* t, unsigned long index);
+
+/*
+   A pairs_walk over the shm_table* 'table': keys and data
+   are the segment's copies, data NULL if there is none
+*/
+unsigned long shm_walk(void* table, void** keys, void** values);
+
+unsigned long shm_slots(shm_table* t);
+unsigned long shm_count(shm_table* t);
+size_t shm_keysize(shm_table* t);
+size_t shm_datasize(shm_table* t);
+
+/* Unmaps everything; the segments themselves stay published */
+void shm_detach(shm_table* t);
+
+/* Removes 'name' and its current version from the system */
+void shm_unpublish(const char* name);
+
+#endif
@@ -0,0 +1,192 @@
+/* clock_gettime() isn't C90 */
+#define _POSIX_C_SOURCE 200112L
+
+#include "specific.h"
+#include "../assoc.h"
+#include "trace.h"
+#include "../Hash/hash.h"
+
+#define MAGIC "ATRC"
+#define MAGICLEN 4
+#define NANO 1000000000UL
+/* Starting sizes for the arrays of a trace being read */
+#define FIRSTOPS 1024
+#define FIRSTKEYS 16384
+#define GROW 2
+
+/* Writes 'value' as a varint */
+static void put_varint(FILE* fp, unsigned long value);
+
+/* Reads a varint, on_error() at end of file */
+static unsigned long get_varint(FILE* fp);
+
+/* Appends 'n' bytes of key plus a '\0' to the log */
+static void add_key(trace_log* l, size_t* room, FILE* fp, size_t n);
+
+tracer* trace_begin(FILE* fp, size_t keysize)
+{
+    tracer* t;
+
+    t = (tracer*) ncalloc(1, sizeof(tracer));
+    t->fp = fp;
+    t->keysize = keysize;
+    fwrite(MAGIC, 1, MAGICLEN, fp);
+    fputc(TRACEVERSION, fp);
+    put_varint(fp, (unsigned long) keysize);
+    t->last = trace_clock();
+    return t;
+}
+
+void trace_record(tracer* t, int kind, const void* key)
+{
+    unsigned long now;
+    size_t length;
+
+    now = trace_clock();
+    fputc(kind, t->fp);
+    put_varint(t->fp, now - t->last);
+    t->last = now;
+    if(t->keysize == 0){
+        length = strlen((const char*) key);
+        put_varint(t->fp, (unsigned long) length);
+    }
+    else{
+        length = t->keysize;
+    }
+    fwrite(key, 1, length, t->fp);
+    t->records++;
+}
+
+void trace_insert(tracer* t, assoc** a, void* key, void* data)
+{
+    trace_record(t, TRACE_INSERT, key);
+    assoc_insert(a, key, data);
+}
+
+void* trace_lookup(tracer* t, assoc* a, void* key)
+{
+    trace_record(t, TRACE_LOOKUP, key);
+    return assoc_lookup(a, key);
+}
+
+void trace_end(tracer* t)
+{
+    fflush(t->fp);
+    free(t);
+}
+
+trace_log* trace_read(FILE* fp)
+{
+    char magic[MAGICLEN];
+    trace_log* l;
+    size_t opsroom, keyroom, length;
+    unsigned long time;
+    int kind;
+
+    if(fread(magic, 1, MAGICLEN, fp) != MAGICLEN ||
+       memcmp(magic, MAGIC, MAGICLEN) != 0){
+        on_error("Not a trace file?");
+    }
+    if(fgetc(fp) != TRACEVERSION){
+        on_error("Unknown trace version?");
+    }
+    l = (trace_log*) ncalloc(1, sizeof(trace_log));
+    l->keysize = (size_t) get_varint(fp);
+    opsroom = FIRSTOPS;
+    keyroom = FIRSTKEYS;
+    l->ops = (trace_op*) ncalloc(opsroom, sizeof(trace_op));
+    l->keys = (char*) ncalloc(keyroom, 1);
+    time = 0;
+
+    while((kind = fgetc(fp)) != EOF){
+        if(kind != TRACE_INSERT && kind != TRACE_LOOKUP){
+            on_error("Unknown operation in trace?");
+        }
+        if(l->count == opsroom){
+            opsroom *= GROW;
+            l->ops = (trace_op*) nremalloc(l->ops,
+                                 opsroom * sizeof(trace_op));
+        }
+        time += get_varint(fp);
+        length = l->keysize ? l->keysize : (size_t) get_varint(fp);
+        l->ops[l->count].kind = kind;
+        l->ops[l->count].time = time;
+        l->ops[l->count].key = l->keybytes;
+        add_key(l, &keyroom, fp, length);
+        l->count++;
+    }
+    return l;
+}
+
+void* trace_key(trace_log* l, size_t n)
+{
+    return l->keys + l->ops[n].key;
+}
+
+void trace_log_free(trace_log* l)
+{
+    free(l->ops);
+    free(l->keys);
+    free(l);
+}
+
+unsigned long trace_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * NANO + (unsigned long) ts.tv_nsec;
+}
+
+/*
+   Fixed size keys are kept at pointer alignment, so that
+   replaying int keys doesn't read misaligned memory
+*/
+static void add_key(trace_log* l, size_t* room, FILE* fp, size_t n)
+{
+    size_t need;
+
+    need = l->keybytes + n + 1;
+    if(l->keysize){
+        need += sizeof(void*) - need % sizeof(void*);
+    }
+    while(need > *room){
+        *room *= GROW;
+        l->keys = (char*) nremalloc(l->keys, *room);
+    }
+    if(fread(l->keys + l->keybytes, 1, n, fp) != n){
+        on_error("Trace ends inside a key?");
+    }
+    l->keys[l->keybytes + n] = '\0';
+    l->keybytes = need;
+}
+
+static void put_varint(FILE* fp, unsigned long value)
+{
+    unsigned char bytes[VARINTMAX];
+
+    fwrite(bytes, 1, varint_put(bytes, value), fp);
+}
+
+/* Gathers the bytes up to the last one, then decodes them */
+static unsigned long get_varint(FILE* fp)
+{
+    unsigned char bytes[VARINTMAX];
+    const unsigned char *in;
+    size_t used;
+    int c;
+
+    used = 0;
+    do{
+        if(used == VARINTMAX){
+            on_error("Trace has an overlong varint?");
+        }
+        if((c = fgetc(fp)) == EOF){
+            on_error("Trace ends inside a record?");
+        }
+        bytes[used] = (unsigned char) c;
+        used += 1;
+    }while(c & VARINTMORE);
+    in = bytes;
+    return varint_get(&in);
+}
@@ -0,0 +1,83 @@
+/*
+   Binary traces of table operations, so that captured
+   traffic can be replayed against any backend. A trace is
+   a header ("ATRC", version, keysize) followed by records:
+      op (1 byte)
+      nanoseconds since the previous record (varint)
+      key length (varint, string keys only)
+      key bytes (no '\0')
+   Recording goes through trace_insert()/trace_lookup(),
+   which log the operation and then perform it.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+
+#define TRACEVERSION 1
+
+enum trace_kind {
+    TRACE_INSERT,
+    TRACE_LOOKUP
+};
+
+/* Writing */
+typedef struct tracer {
+
+    FILE *fp;
+    size_t keysize;
+    unsigned long last;
+    unsigned long records;
+
+} tracer;
+
+/* One operation of a trace read back into memory */
+typedef struct trace_op {
+
+    int kind;
+    /* Nanoseconds since the start of the trace */
+    unsigned long time;
+    /* Where the key starts in trace_log.keys */
+    size_t key;
+
+} trace_op;
+
+/* A whole trace, keys '\0' terminated back to back */
+typedef struct trace_log {
+
+    trace_op *ops;
+    size_t count;
+    char *keys;
+    size_t keybytes;
+    size_t keysize;
+
+} trace_log;
+
+struct assoc;
+
+/* Starts a trace on 'fp' of a table with this keysize */
+tracer* trace_begin(FILE* fp, size_t keysize);
+
+/* Logs the operation, then does it */
+void trace_insert(tracer* t, struct assoc** a, void* key, void* data);
+void* trace_lookup(tracer* t, struct assoc* a, void* key);
+
+/* Just the logging, for callers with their own wrappers */
+void trace_record(tracer* t, int kind, const void* key);
+
+/* Flushes and frees 't' (the file is left open) */
+void trace_end(tracer* t);
+
+/* Reads a whole trace, on_error() if it is malformed */
+trace_log* trace_read(FILE* fp);
+
+/* The key of operation 'n' */
+void* trace_key(trace_log* l, size_t n);
+
+void trace_log_free(trace_log* l);
+
+/* Monotonic nanoseconds */
+unsigned long trace_clock(void);
+
+#endif
@@ -0,0 +1,412 @@
+/* open(), mmap(), fdatasync() and ftruncate() aren't C90 */
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wal.h"
+#include "../Hash/hash.h"
+#include "../../../ADTs/General/general.h"
+
+#define LOGMAGIC 0x4157414CUL
+#define SNAPMAGIC 0x41534E50UL
+/* Records are gathered into this many bytes per write() */
+#define WALBUFFER (1 << 16)
+#define WALMODE 0644
+/* Marks an insert logged without data */
+#define NODATA 0x100U
+
+#define ALIGNUP(n) (((n) + WALALIGN - 1) & ~((size_t) WALALIGN - 1))
+#define HEADERBYTES ALIGNUP(sizeof(wal_header))
+#define RECORDBYTES ALIGNUP(sizeof(wal_record))
+
+/* 'path' followed by 'suffix', to be free()d */
+static char* suffixed(const char* path, const char* suffix);
+/*
+   Maps 'path' privately, checking its header, and sets
+   *size. NULL if there's no such file, or it never got as
+   far as a whole header.
+*/
+static char* map_file(wal* w, const char* path, unsigned long magic,
+                      size_t* size);
+/* Creates 'path' afresh, with just its header buffered */
+static int start_file(wal* w, const char* path, unsigned long magic);
+/* Makes a file from start_file() durable and renames it 'path' */
+static void commit_file(wal* w, const char* from, const char* path);
+/* Starts the log again, empty, appending from now on */
+static void new_log(wal* w);
+/* Buffers one record */
+static void add_record(wal* w, int op, const void* key, const void* data);
+/* Writes the buffer out, without waiting for the disk */
+static void write_out(wal* w);
+/* Bytes in the whole record at 'pos', 0 => torn or damaged */
+static size_t record_bytes(wal* w, const char* base, size_t size,
+                           size_t pos);
+/* Makes a rename in the directory holding 'path' durable */
+static void sync_dir(const char* path);
+
+wal* wal_open(const char* path, size_t keysize, size_t datasize,
+              unsigned int group)
+{
+    wal* w;
+    char* snap;
+
+    w = (wal*) ncalloc(1, sizeof(wal));
+    w->path = suffixed(path, "");
+    w->keysize = keysize;
+    w->datasize = datasize;
+    w->group = group;
+    w->room = WALBUFFER;
+    w->buffer = (char*) ncalloc(1, w->room);
+
+    snap = suffixed(path, ".snap");
+    w->snap = map_file(w, snap, SNAPMAGIC, &w->snapsize);
+    free(snap);
+    w->log = map_file(w, path, LOGMAGIC, &w->logsize);
+    if(w->log == NULL){
+        new_log(w);
+    }
+    else{
+        w->fd = open(path, O_WRONLY | O_APPEND);
+        if(w->fd < 0){
+            on_error("Cannot open the log for appending");
+        }
+    }
+    w->pos = HEADERBYTES;
+    w->replaying_log = w->snap == NULL;
+    return w;
+}
+
+/*
+   Replayed keys and data are pointers straight into the
+   mappings: nothing is copied until the table copies it
+*/
+int wal_next(wal* w, void** key, void** data)
+{
+    wal_record* r;
+    char *base, *p;
+    size_t size, bytes;
+
+    if(!w->replaying_log && w->pos >= w->snapsize){
+        w->replaying_log = 1;
+        w->pos = HEADERBYTES;
+    }
+    base = w->replaying_log ? w->log : w->snap;
+    size = w->replaying_log ? w->logsize : w->snapsize;
+    if(base == NULL || w->pos >= size){
+        return WALEND;
+    }
+    bytes = record_bytes(w, base, size, w->pos);
+    if(bytes == 0){
+        if(!w->replaying_log){
+            on_error("Snapshot is damaged");
+        }
+        /* Torn by a crash mid-write: new records go here instead */
+        if(ftruncate(w->fd, (off_t) w->pos) != 0 || fdatasync(w->fd) != 0){
+            on_error("Cannot cut the torn tail off the log");
+        }
+        w->logsize = w->pos;
+        return WALEND;
+    }
+    r = (wal_record*) &base[w->pos];
+    p = &base[w->pos + RECORDBYTES];
+    *data = NULL;
+    if(!(r->op & NODATA)){
+        *data = p;
+        p += ALIGNUP(w->datasize);
+    }
+    *key = p;
+    w->pos += bytes;
+    return (int) (r->op & ~NODATA);
+}
+
+void wal_replay(wal* w, wal_apply apply, void* table)
+{
+    void *key, *data;
+    int op;
+
+    while((op = wal_next(w, &key, &data)) != WALEND){
+        apply(table, op, key, data);
+    }
+}
+
+void wal_append(wal* w, int op, const void* key, const void* data)
+{
+    add_record(w, op, key, data);
+    w->pending += 1;
+    if(w->group != 0 && w->pending >= w->group){
+        wal_sync(w);
+    }
+}
+
+void wal_sync(wal* w)
+{
+    write_out(w);
+    if(fdatasync(w->fd) != 0){
+        on_error("Cannot sync the log");
+    }
+    w->pending = 0;
+}
+
+/*
+   The log is synced first, so whichever file a crash
+   leaves current, nothing already durable goes missing
+*/
+void wal_snapshot(wal* w, void** keys, void** values,
+                  unsigned long count)
+{
+    char *from, *to;
+    unsigned long n;
+    int log;
+
+    wal_sync(w);
+    log = w->fd;
+    from = suffixed(w->path, ".snap.new");
+    to = suffixed(w->path, ".snap");
+    w->fd = start_file(w, from, SNAPMAGIC);
+    for(n = 0; n < count; n += 1){
+        add_record(w, WALINSERT, keys[n],
+                   values == NULL ? NULL : values[n]);
+    }
+    commit_file(w, from, to);
+    close(w->fd);
+    free(from);
+    free(to);
+
+    new_log(w);
+    close(log);
+}
+
+void wal_checkpoint(wal* w, pairs_walk walk, void* table,
+                    unsigned long most, int values,
+                    const assoc_allocator* al)
+{
+    pairs p;
+
+    pairs_collect(&p, walk, table, most, al);
+    wal_snapshot(w, p.keys, values ? p.values : NULL, p.count);
+    pairs_free(&p);
+}
+
+void wal_close(wal* w)
+{
+    wal_sync(w);
+    close(w->fd);
+    if(w->snap != NULL){
+        munmap(w->snap, w->snapsize);
+    }
+    if(w->log != NULL){
+        munmap(w->log, w->logsize);
+    }
+    free(w->buffer);
+    free(w->path);
+    free(w);
+}
+
+static char* suffixed(const char* path, const char* suffix)
+{
+    char* s;
+
+    s = (char*) ncalloc(1, strlen(path) + strlen(suffix) + 1);
+    strcpy(s, path);
+    strcat(s, suffix);
+    return s;
+}
+
+/*
+   Private and writable, so the table can update replayed
+   data in place (as it could any other data) without it
+   reaching the file
+*/
+static char* map_file(wal* w, const char* path, unsigned long magic,
+                      size_t* size)
+{
+    const wal_header* h;
+    struct stat st;
+    char* base;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return NULL;
+    }
+    if(fstat(fd, &st) != 0){
+        on_error("Cannot stat the log");
+    }
+    *size = (size_t) st.st_size;
+    if(*size < HEADERBYTES){
+        close(fd);
+        *size = 0;
+        return NULL;
+    }
+    base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(base == MAP_FAILED){
+        on_error("Cannot mmap() the log");
+    }
+    close(fd);
+    h = (const wal_header*) base;
+    if(h->magic != magic){
+        on_error("Not a log or snapshot of a table");
+    }
+    if(h->keysize != w->keysize || h->datasize != w->datasize){
+        on_error("Log was written for a different size of key or data");
+    }
+    return base;
+}
+
+static int start_file(wal* w, const char* path, unsigned long magic)
+{
+    wal_header* h;
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, WALMODE);
+    if(fd < 0){
+        on_error("Cannot create log file");
+    }
+    memset(w->buffer, 0, HEADERBYTES);
+    h = (wal_header*) w->buffer;
+    h->magic = magic;
+    h->keysize = w->keysize;
+    h->datasize = w->datasize;
+    w->used = HEADERBYTES;
+    return fd;
+}
+
+static void commit_file(wal* w, const char* from, const char* path)
+{
+    wal_sync(w);
+    if(rename(from, path) != 0){
+        on_error("Cannot rename log file into place");
+    }
+    sync_dir(path);
+}
+
+/*
+   A new file renamed over the old, not a truncation: the
+   old one may still be mapped for the keys replayed from it
+*/
+static void new_log(wal* w)
+{
+    char* from;
+
+    from = suffixed(w->path, ".new");
+    w->fd = start_file(w, from, LOGMAGIC);
+    commit_file(w, from, w->path);
+    free(from);
+}
+
+/* Padding is zeroed, as the checksum covers it too */
+static void add_record(wal* w, int op, const void* key, const void* data)
+{
+    wal_record* r;
+    char* p;
+    size_t keybytes, bytes;
+    int hasdata;
+
+    keybytes = w->keysize ? w->keysize : strlen((const char*) key) + 1;
+    hasdata = op == WALINSERT && data != NULL && w->datasize > 0;
+    bytes = RECORDBYTES + (hasdata ? ALIGNUP(w->datasize) : 0) +
+            ALIGNUP(keybytes);
+    if(w->used + bytes > w->room){
+        write_out(w);
+        if(bytes > w->room){
+            free(w->buffer);
+            w->room = bytes;
+            w->buffer = (char*) ncalloc(1, w->room);
+        }
+    }
+    p = &w->buffer[w->used];
+    memset(p, 0, bytes);
+    r = (wal_record*) p;
+    r->op = (unsigned int) op | (hasdata ? 0 : NODATA);
+    r->keybytes = (unsigned int) keybytes;
+    p += RECORDBYTES;
+    if(hasdata){
+        memcpy(p, data, w->datasize);
+        p += ALIGNUP(w->datasize);
+    }
+    memcpy(p, key, keybytes);
+    r->check = hash_bytes(&w->buffer[w->used + sizeof(unsigned long)],
+                          bytes - sizeof(unsigned long));
+    w->used += bytes;
+}
+
+static void write_out(wal* w)
+{
+    size_t done;
+    ssize_t n;
+
+    done = 0;
+    while(done < w->used){
+        n = write(w->fd, &w->buffer[done], w->used - done);
+        if(n < 0){
+            on_error("Cannot write to the log");
+        }
+        done += (size_t) n;
+    }
+    w->used = 0;
+}
+
+static size_t record_bytes(wal* w, const char* base, size_t size,
+                           size_t pos)
+{
+    const wal_record* r;
+    unsigned int op;
+    size_t bytes;
+
+    if(size - pos < RECORDBYTES){
+        return 0;
+    }
+    r = (const wal_record*) &base[pos];
+    op = r->op & ~NODATA;
+    if(op != WALINSERT && op != WALREMOVE){
+        return 0;
+    }
+    if(w->keysize ? r->keybytes != w->keysize : r->keybytes == 0){
+        return 0;
+    }
+    bytes = RECORDBYTES + ALIGNUP((size_t) r->keybytes);
+    if(!(r->op & NODATA)){
+        bytes += ALIGNUP(w->datasize);
+    }
+    if(bytes > size - pos ||
+       hash_bytes(&base[pos + sizeof(unsigned long)],
+                  bytes - sizeof(unsigned long)) != r->check){
+        return 0;
+    }
+    /* A string key must end where its length says */
+    if(w->keysize == 0 && base[pos + bytes - ALIGNUP((size_t) r->keybytes) +
+                               r->keybytes - 1] != '\0'){
+        return 0;
+    }
+    return bytes;
+}
+
+static void sync_dir(const char* path)
+{
+    char *dir, *slash;
+    int fd;
+
+    dir = suffixed(path, "");
+    slash = strrchr(dir, '/');
+    if(slash == NULL){
+        strcpy(dir, ".");
+    }
+    else if(slash == dir){
+        slash[1] = '\0';
+    }
+    else{
+        *slash = '\0';
+    }
+    fd = open(dir, O_RDONLY);
+    if(fd < 0 || fsync(fd) != 0){
+        on_error("Cannot sync the log's directory");
+    }
+    close(fd);
+    free(dir);
+}
@@ -0,0 +1,145 @@
+/*
+   A write-ahead log of a table's changes, so that after a
+   restart the table comes back from its latest snapshot plus
+   the changes made since, rather than from its source.
+
+   Two files: 'path' is the log, appended to as the table
+   changes, and "path.snap" the snapshot, every pair the
+   table held when it was last taken. Records are buffered
+   and written out together, one fdatasync() per 'group' of
+   them (group commit), so a crash loses at most the last
+   group. Each record carries a checksum; replay stops at
+   the first one that was torn or damaged.
+
+   A snapshot is written beside the old one and renamed over
+   it, then the log is replaced by an empty one in the same
+   way. A crash between the two leaves a log the snapshot
+   already covers: replaying it again changes nothing, as
+   each key still ends up as its last change left it.
+*/
+
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdlib.h>
+
+#include "../Pairs/pairs.h"
+
+/* What wal_next() found */
+#define WALEND 0
+#define WALINSERT 1
+#define WALREMOVE 2
+
+/* Records, keys and data start on these boundaries */
+#define WALALIGN 8
+
+/* What the log and the snapshot start with */
+typedef struct wal_header {
+
+    unsigned long magic;
+    unsigned long keysize;
+    /* Bytes of data kept per insert, 0 => keys only */
+    unsigned long datasize;
+
+} wal_header;
+
+/*
+   Followed by the data (inserts only, padded to WALALIGN)
+   and then the key, 'keybytes' long ('\0' included)
+*/
+typedef struct wal_record {
+
+    /* hash_bytes() of the rest of the record */
+    unsigned long check;
+    unsigned int op;
+    unsigned int keybytes;
+
+} wal_record;
+
+typedef struct wal {
+
+    char *path;
+    /* The log, open for appending */
+    int fd;
+    size_t keysize;
+    size_t datasize;
+
+    /* Records not yet written */
+    char *buffer;
+    size_t used;
+    size_t room;
+    /* Records per fdatasync(), 0 => only on wal_sync() */
+    unsigned int group;
+    /* Records appended since the last fdatasync() */
+    unsigned int pending;
+
+    /*
+       The snapshot and the log as they were at wal_open(),
+       mapped privately: replayed keys and data point into
+       them, so they stay until wal_close()
+    */
+    char *snap;
+    size_t snapsize;
+    char *log;
+    size_t logsize;
+    /* Replay position, in the snapshot then in the log */
+    size_t pos;
+    int replaying_log;
+
+} wal;
+
+/*
+   Opens (creating if need be) the log at 'path' for a table
+   with keys of 'keysize' bytes (0 => strings) and 'datasize'
+   bytes of data per pair, ready to replay whatever the files
+   hold. on_error() if they were written for other sizes.
+*/
+wal* wal_open(const char* path, size_t keysize, size_t datasize,
+              unsigned int group);
+
+/*
+   The next change to replay: WALINSERT or WALREMOVE, with
+   its key and (inserts with data only, else NULL) its data,
+   or WALEND once everything has been replayed, when a torn
+   tail of the log is cut off so new records follow on
+*/
+int wal_next(wal* w, void** key, void** data);
+
+/* What wal_replay() hands each change to, as from wal_next() */
+typedef void (*wal_apply)(void* table, int op, void* key, void* data);
+
+/*
+   Replays every change into 'table' by 'apply', which
+   mustn't log them again: the log isn't the table's yet
+*/
+void wal_replay(wal* w, wal_apply apply, void* table);
+
+/*
+   Logs a change, copying 'datasize' bytes from 'data' for
+   an insert (NULL => none). Durable once its group is.
+*/
+void wal_append(wal* w, int op, const void* key, const void* data);
+
+/* Writes out every record so far and waits for the disk */
+void wal_sync(wal* w);
+
+/*
+   Makes 'count' pairs the new snapshot and empties the log.
+   'values' as for wal_append()'s data (NULL => none).
+*/
+void wal_snapshot(wal* w, void** keys, void** values,
+                  unsigned long count);
+
+/*
+   wal_snapshot() of the pairs of 'table' (at most 'most')
+   that 'walk' lists, values included unless 'values' is 0.
+   The lists themselves come from 'al'.
+*/
+void wal_checkpoint(wal* w, pairs_walk walk, void* table,
+                    unsigned long most, int values,
+                    const assoc_allocator* al);
+
+/* Syncs, closes and frees everything */
+void wal_close(wal* w);
+
+#endif
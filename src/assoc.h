@@ -2,7 +2,9 @@
    A Hash Table, storing void pointers to a key/data pair.
    The user is responsible for keeping the data persistent
    (i.e. pointing at objects that haven't been freed)
-   No copying of key/data is done.
+   Data is never copied. Keys are: fixed size keys into the
+   table's slots, strings into a clone of their own, unless
+   the table is told to borrow them (assoc_borrow_keys).
 */
 
 #include "../../ADTs/General/general.h"
@@ -19,27 +21,277 @@
    This is important when comparing keys since
    we'll need to use either memcmp() or strcmp()
 */
-assoc* assoc_init(int keysize);
+assoc* assoc_init(size_t keysize);
+
+/*
+   As assoc_init(), but every allocation the table makes
+   (slots, copies of keys, resize buffers) goes through
+   'alloc' rather than the heap. NULL => heap_allocator
+*/
+assoc* assoc_init_ex(size_t keysize, const assoc_allocator* alloc);
+
+/*
+   A set: keys only, no data stored alongside them, so each
+   slot is just the key. Insert with any data (it's ignored);
+   assoc_lookup() returns the key passed to it if present,
+   NULL otherwise. assoc_upsert() and assoc_get_or_insert()
+   have no data to hand back, so are errors on a set.
+*/
+assoc* assoc_set_init(size_t keysize);
+
+/* As assoc_set_init(), allocating through 'alloc' */
+assoc* assoc_set_init_ex(size_t keysize, const assoc_allocator* alloc);
+
+/*
+   String keys are stored as the caller's own pointers
+   from now on - no clone per insert, nothing freed per key.
+   The caller must keep every key alive, unchanged, until
+   assoc_free(). Only allowed while the table is empty.
+*/
+void assoc_borrow_keys(assoc* a);
+
+/*
+   A cache: a map that holds at most 'capacity' pairs and
+   never grows. Once full, each new key evicts an old one,
+   chosen by CLOCK: a pair looked up since the clock hand
+   last passed it gets a second chance, so keys in use stay
+   while one-off keys come and go. Evicted string keys are
+   freed as usual; data is the caller's, as ever.
+*/
+assoc* assoc_cache_init(size_t keysize, size_t capacity);
+
+/*
+   Pairs a cache inserts (or replaces) from now on expire 'ms'
+   milliseconds later, 0 => never. Expired pairs are dropped
+   when next looked up, or first when evicting.
+*/
+void assoc_cache_ttl(assoc* a, unsigned long ms);
+
+/*
+   A table kept in the file 'path' (and "path.ovf") rather
+   than in memory, for key sets bigger than RAM: created if
+   need be, otherwise reopened as it was left. Buckets are
+   pages of the file, and growth splits one bucket at a time
+   (linear hashing, see Linear/linear.h), so the file grows
+   a page at a time. Data pointers would mean nothing to the
+   next process, so inserts copy the 'datasize' bytes each
+   one's data points at (0 => a set), and lookups return the
+   file's copy, valid until the next insert or remove.
+   assoc_upsert() and assoc_get_or_insert() hand back data
+   pointers, so are errors on it, as is a filter. Only the
+   Realloc backend (and so libassoc) provides it.
+*/
+assoc* assoc_file_init(const char* path, size_t keysize, size_t datasize);
+
+/*
+   A set that doesn't keep every key it is given, only the
+   'capacity' seen most often, in memory fixed from the start
+   (see Heavy/heavy.h): for the top words of a stream with
+   more distinct ones than fit. Each insert counts one more
+   sighting of its key, data ignored; assoc_lookup() finds a
+   key only while it is one of those kept, and assoc_count()
+   is how many are kept. Counts may be overestimates, by at
+   most the least count kept, never underestimates.
+   assoc_upsert(), assoc_get_or_insert() and a filter are
+   errors on it, and like a read-only table it can't be
+   removed from. Only the Realloc backend (and so libassoc)
+   provides it, and assoc_topk().
+*/
+assoc* assoc_topk_init(size_t keysize, size_t capacity);
+
+/*
+   Fills in the (up to) 'k' keys of a table made by
+   assoc_topk_init() with the highest estimated counts,
+   highest first, and returns how many. The keys are the
+   table's own, valid until its next insert; 'counts' may be
+   NULL. An error on any other table.
+*/
+size_t assoc_topk(assoc* a, void** keys, unsigned long* counts, size_t k);
 
 /*
    Insert key/data pair
    - may cause resize, therefore 'a' might
    be changed due to a realloc() etc.
+   If the key is already present its data is replaced,
+   keys are never stored twice.
 */
 void assoc_insert(assoc** a, void* key, void* data);
 
+/*
+   As assoc_insert(), but returns a pointer to the stored
+   data so it can be updated in place. The pointer is only
+   valid until the next insertion (which may resize).
+*/
+void** assoc_upsert(assoc** a, void* key, void* data);
+
+/*
+   Returns a pointer to the data stored against 'key',
+   inserting 'data' first if the key is new. One probe,
+   rather than an assoc_lookup() followed by an insert.
+*/
+void** assoc_get_or_insert(assoc** a, void* key, void* data);
+
+/*
+   Takes 'key' and its data out of the table, returning 1
+   if it was there, 0 if not. The table's own copy of a
+   string key is freed; data is the caller's, as ever.
+*/
+int assoc_remove(assoc* a, void* key);
+
+/*
+   Inserts every whitespace separated word of the file at
+   'path' into a table of strings, with NULL data, returning
+   how many words were read (repeats included). If the table
+   borrows its keys they point straight into a private
+   mapping of the file, which the table keeps until freed.
+*/
+size_t assoc_load_words(assoc** a, const char* path);
+
 /*
    Returns the number of key/data pairs
    currently stored in the table
 */
-unsigned int assoc_count(assoc* a);
+size_t assoc_count(assoc* a);
+
+/*
+   Returns how many pairs the table holds before the
+   next insertion of a new key makes it grow. A table
+   that never resizes, such as a live Hamt trie, gives
+   (size_t) -1
+*/
+size_t assoc_capacity(assoc* a);
 
 /*
    Returns a pointer to the data, given a key
-   NULL => not found
+   NULL => not found (or the data stored was NULL)
 */
 void* assoc_lookup(assoc* a, void* key);
 
+/*
+   Set operations on the keys of two live tables with the
+   same keysize, maps or sets. Each returns a new set (keys
+   copied as for any insert) sized up front for its result;
+   'a' and 'b' are unchanged. Keys are looked up in batches,
+   with the slots for a whole batch prefetched at once.
+   intersect  : keys in both, probing the smaller table's
+                keys against the larger
+   union      : keys in either
+   difference : keys in 'a' but not in 'b'
+*/
+assoc* assoc_intersect(assoc* a, assoc* b);
+assoc* assoc_union(assoc* a, assoc* b);
+assoc* assoc_difference(assoc* a, assoc* b);
+
+/*
+   Attach a membership filter of 'bits' bits per key,
+   kept up to date on insert and resize. Lookups of absent
+   keys are then mostly answered by the filter alone.
+   bits = 0 => remove the filter
+*/
+void assoc_filter(assoc* a, int bits);
+
+/*
+   Estimated chance that the filter lets an absent key
+   through to the table (0.0 if there is no filter)
+*/
+double assoc_filter_fpr(assoc* a);
+
+/*
+   Rebuilds the table as a read-only minimal perfect hash:
+   keys packed into one block, values in a dense array, no
+   empty slots. Lookups still use assoc_lookup(); inserting
+   into a frozen table is an error.
+*/
+void assoc_freeze(assoc* a);
+
+/* Bits of perfect hash per key (0.0 if not frozen) */
+double assoc_frozen_bits(assoc* a);
+
+/*
+   Rebuilds the table read-only with its keys sorted and
+   front-coded in small blocks, for very large key sets
+   where the copies of the keys dominate memory. Lookups
+   still use assoc_lookup(); inserting is an error.
+*/
+void assoc_compact(assoc* a);
+
+/* Bytes used per key once compacted (0.0 if not compacted) */
+double assoc_compact_bytes(assoc* a);
+
+/*
+   Copies the table into the POSIX shared-memory segment
+   'name' ("/something", as for shm_open()) for other
+   processes to attach to, replacing any earlier version
+   once it is complete. Data pointers mean nothing in
+   another process, so the 'datasize' bytes each one points
+   at are copied instead (0 => keys only). Only one process
+   should publish a given name. The table itself is unchanged.
+*/
+void assoc_publish(assoc* a, const char* name, size_t datasize);
+
+/*
+   A read-only table onto the current version of 'name',
+   shared with every other process attached to it. Lookups
+   return pointers into the segment; tables published with
+   no data behave as sets. Inserting is an error.
+*/
+assoc* assoc_attach(const char* name);
+
+/*
+   Moves an attached table on to the latest version, if one
+   has been published since: returns 1 if so, 0 otherwise.
+   Pointers returned by earlier lookups are then invalid.
+*/
+int assoc_refresh(assoc* a);
+
+/* Removes 'name' from the system; attached tables carry on */
+void assoc_unpublish(const char* name);
+
+/*
+   Makes the table durable, with a write-ahead log at 'path'
+   and snapshots of the table at "path.snap". The table, which
+   must be empty, first gets back whatever pairs the files
+   hold, then every insert and remove is logged along with
+   the 'datasize' bytes each insert's data points at (0 =>
+   keys only, which come back with NULL data). Changes are
+   written out and fdatasync()ed 'group' at a time, so a crash
+   loses at most the last 'group' of them (0 => only synced
+   by assoc_sync()). Returns how many pairs were recovered,
+   their data pointing into a private mapping of the files
+   that lasts until assoc_free(). Data changed in place, e.g.
+   through assoc_upsert(), is only saved by a checkpoint.
+   A cache can't be logged.
+*/
+size_t assoc_log(assoc** a, const char* path, size_t datasize,
+                 unsigned int group);
+
+/*
+   Writes every pair to a new snapshot and empties the log,
+   so recovery replays only what changes after this
+*/
+void assoc_checkpoint(assoc* a);
+
+/* Makes every change logged so far durable */
+void assoc_sync(assoc* a);
+
+/*
+   A read-only copy of the table as it is now, for readers
+   that need one consistent version while the table goes on
+   changing: lookups, set operations and assoc_publish() all
+   work on it, inserting is an error. Free it with
+   assoc_free() like any table, in any order. What it costs
+   depends on the backend:
+   HAMT      : O(1), sharing every node until the table
+               changes it; may be freed on any thread (with
+               the heap allocator), and shares any keys the
+               table borrows, so such a table must outlive
+               its snapshots
+   the rest  : O(n), every pair copied into a frozen table
+               (see frozen_copy()), since their slots change
+               in place and there is nothing to share
+*/
+assoc* assoc_snapshot(assoc* a);
+
 void assoc_todot(assoc* a);
 
 /* Free up all allocated space from 'a' */
@@ -4,33 +4,161 @@ DEBUG= -g3
 SANITIZE= $(COMMON) -fsanitize=undefined -fsanitize=address $(DEBUG)
 VALGRIND= $(COMMON) $(DEBUG)
 PRODUCTION= $(COMMON) -O3
-LDLIBS =
+LDLIBS = -lrt
+SHARED = Hash/hash.c Bloom/bloom.c Alloc/alloc.c Alloc/arena.c Pairs/pairs.c Frozen/frozen.c Compact/compact.c Load/load.c Shm/shm.c Cache/cache.c Wal/wal.c Linear/linear.c Heavy/heavy.c Sets/sets.c
+SHAREDH = Hash/hash.h Bloom/bloom.h Alloc/alloc.h Alloc/arena.h Pairs/pairs.h Frozen/frozen.h Compact/compact.h Load/load.h Shm/shm.h Cache/cache.h Wal/wal.h Linear/linear.h Heavy/heavy.h Sets/sets.h
 
-testrealloc : assoc.h Realloc/specific.h Realloc/realloc.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c
-	$(CC) testassoc.c Realloc/realloc.c ../../ADTs/General/general.c -o testrealloc -I./Realloc $(PRODUCTION) $(LDLIBS)
+testrealloc : assoc.h Realloc/specific.h Realloc/realloc.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Realloc/realloc.c ../../ADTs/General/general.c $(SHARED) -o testrealloc -I./Realloc $(PRODUCTION) $(LDLIBS)
 
-testrealloc_s : assoc.h Realloc/specific.h Realloc/realloc.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c
-	$(CC) testassoc.c Realloc/realloc.c ../../ADTs/General/general.c -o testrealloc_s -I./Realloc $(SANITIZE) $(LDLIBS)
+testrealloc_s : assoc.h Realloc/specific.h Realloc/realloc.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Realloc/realloc.c ../../ADTs/General/general.c $(SHARED) -o testrealloc_s -I./Realloc $(SANITIZE) $(LDLIBS)
 
-testrealloc_v : assoc.h Realloc/specific.h Realloc/realloc.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c
-	$(CC) testassoc.c Realloc/realloc.c ../../ADTs/General/general.c -o testrealloc_v -I./Realloc $(VALGRIND) $(LDLIBS)
+testrealloc_v : assoc.h Realloc/specific.h Realloc/realloc.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Realloc/realloc.c ../../ADTs/General/general.c $(SHARED) -o testrealloc_v -I./Realloc $(VALGRIND) $(LDLIBS)
 
-testcuckoo_s : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c
-	$(CC) testassoc.c Cuckoo/cuckoo.c ../../ADTs/General/general.c -o testcuckoo_s -I./Cuckoo $(SANITIZE) $(LDLIBS)
+testcuckoo_s : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Cuckoo/cuckoo.c ../../ADTs/General/general.c $(SHARED) -o testcuckoo_s -I./Cuckoo $(SANITIZE) $(LDLIBS)
 
-testcuckoo_v : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c
-	$(CC) testassoc.c Cuckoo/cuckoo.c ../../ADTs/General/general.c -o testcuckoo_v -I./Cuckoo $(VALGRIND) $(LDLIBS)
+testcuckoo_v : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Cuckoo/cuckoo.c ../../ADTs/General/general.c $(SHARED) -o testcuckoo_v -I./Cuckoo $(VALGRIND) $(LDLIBS)
 
-testcuckoo : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c
-	$(CC) testassoc.c Cuckoo/cuckoo.c ../../ADTs/General/general.c -o testcuckoo -I./Cuckoo $(PRODUCTION) $(LDLIBS)
+testcuckoo : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Cuckoo/cuckoo.c ../../ADTs/General/general.c $(SHARED) -o testcuckoo -I./Cuckoo $(PRODUCTION) $(LDLIBS)
+
+testrealloc32_s : assoc.h Realloc/specific.h Realloc/realloc.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Realloc/realloc.c ../../ADTs/General/general.c $(SHARED) -o testrealloc32_s -I./Realloc -DASSOC32 $(SANITIZE) $(LDLIBS)
+
+benchrealloc : assoc.h Realloc/specific.h Realloc/realloc.c benchassoc.c Perf/perf.h Perf/perf.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) benchassoc.c Realloc/realloc.c Perf/perf.c ../../ADTs/General/general.c $(SHARED) -o benchrealloc -I./Realloc $(PRODUCTION) $(LDLIBS)
+
+testcuckoo32_s : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Cuckoo/cuckoo.c ../../ADTs/General/general.c $(SHARED) -o testcuckoo32_s -I./Cuckoo -DASSOC32 $(SANITIZE) $(LDLIBS)
+
+benchcuckoo : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c benchassoc.c Perf/perf.h Perf/perf.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) benchassoc.c Cuckoo/cuckoo.c Perf/perf.c ../../ADTs/General/general.c $(SHARED) -o benchcuckoo -I./Cuckoo $(PRODUCTION) $(LDLIBS)
+
+replayrealloc : assoc.h Realloc/specific.h Realloc/realloc.c replayassoc.c Trace/trace.h Trace/trace.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) replayassoc.c Realloc/realloc.c Trace/trace.c ../../ADTs/General/general.c $(SHARED) -o replayrealloc -I./Realloc $(PRODUCTION) $(LDLIBS)
+
+replaycuckoo : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c replayassoc.c Trace/trace.h Trace/trace.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) replayassoc.c Cuckoo/cuckoo.c Trace/trace.c ../../ADTs/General/general.c $(SHARED) -o replaycuckoo -I./Cuckoo $(PRODUCTION) $(LDLIBS)
+
+threadrealloc : assoc.h Realloc/specific.h Realloc/realloc.c threadassoc.c Locked/locked.h Locked/locked.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) threadassoc.c Realloc/realloc.c Locked/locked.c ../../ADTs/General/general.c $(SHARED) -o threadrealloc -I./Realloc $(PRODUCTION) -pthread $(LDLIBS) -lm
+
+threadcuckoo : assoc.h Cuckoo/specific.h Cuckoo/cuckoo.c threadassoc.c Locked/locked.h Locked/locked.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) threadassoc.c Cuckoo/cuckoo.c Locked/locked.c ../../ADTs/General/general.c $(SHARED) -o threadcuckoo -I./Cuckoo $(PRODUCTION) -pthread $(LDLIBS) -lm
+
+testhopscotch : assoc.h Hopscotch/specific.h Hopscotch/hopscotch.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hopscotch/hopscotch.c ../../ADTs/General/general.c $(SHARED) -o testhopscotch -I./Hopscotch $(PRODUCTION) $(LDLIBS)
+
+testhopscotch_s : assoc.h Hopscotch/specific.h Hopscotch/hopscotch.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hopscotch/hopscotch.c ../../ADTs/General/general.c $(SHARED) -o testhopscotch_s -I./Hopscotch $(SANITIZE) $(LDLIBS)
+
+testhopscotch_v : assoc.h Hopscotch/specific.h Hopscotch/hopscotch.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hopscotch/hopscotch.c ../../ADTs/General/general.c $(SHARED) -o testhopscotch_v -I./Hopscotch $(VALGRIND) $(LDLIBS)
+
+testhopscotch32_s : assoc.h Hopscotch/specific.h Hopscotch/hopscotch.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hopscotch/hopscotch.c ../../ADTs/General/general.c $(SHARED) -o testhopscotch32_s -I./Hopscotch -DASSOC32 $(SANITIZE) $(LDLIBS)
+
+benchhopscotch : assoc.h Hopscotch/specific.h Hopscotch/hopscotch.c benchassoc.c Perf/perf.h Perf/perf.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) benchassoc.c Hopscotch/hopscotch.c Perf/perf.c ../../ADTs/General/general.c $(SHARED) -o benchhopscotch -I./Hopscotch $(PRODUCTION) $(LDLIBS)
+
+replayhopscotch : assoc.h Hopscotch/specific.h Hopscotch/hopscotch.c replayassoc.c Trace/trace.h Trace/trace.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) replayassoc.c Hopscotch/hopscotch.c Trace/trace.c ../../ADTs/General/general.c $(SHARED) -o replayhopscotch -I./Hopscotch $(PRODUCTION) $(LDLIBS)
+
+threadhopscotch : assoc.h Hopscotch/specific.h Hopscotch/hopscotch.c threadassoc.c Locked/locked.h Locked/locked.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) threadassoc.c Hopscotch/hopscotch.c Locked/locked.c ../../ADTs/General/general.c $(SHARED) -o threadhopscotch -I./Hopscotch $(PRODUCTION) -pthread $(LDLIBS) -lm
+
+testhamt : assoc.h Hamt/specific.h Hamt/hamt.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hamt/hamt.c ../../ADTs/General/general.c $(SHARED) -o testhamt -I./Hamt $(PRODUCTION) $(LDLIBS)
+
+testhamt_s : assoc.h Hamt/specific.h Hamt/hamt.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hamt/hamt.c ../../ADTs/General/general.c $(SHARED) -o testhamt_s -I./Hamt $(SANITIZE) $(LDLIBS)
+
+testhamt_v : assoc.h Hamt/specific.h Hamt/hamt.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hamt/hamt.c ../../ADTs/General/general.c $(SHARED) -o testhamt_v -I./Hamt $(VALGRIND) $(LDLIBS)
+
+testhamt32_s : assoc.h Hamt/specific.h Hamt/hamt.c testassoc.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) testassoc.c Hamt/hamt.c ../../ADTs/General/general.c $(SHARED) -o testhamt32_s -I./Hamt -DASSOC32 $(SANITIZE) $(LDLIBS)
+
+benchhamt : assoc.h Hamt/specific.h Hamt/hamt.c benchassoc.c Perf/perf.h Perf/perf.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) benchassoc.c Hamt/hamt.c Perf/perf.c ../../ADTs/General/general.c $(SHARED) -o benchhamt -I./Hamt $(PRODUCTION) $(LDLIBS)
+
+replayhamt : assoc.h Hamt/specific.h Hamt/hamt.c replayassoc.c Trace/trace.h Trace/trace.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) replayassoc.c Hamt/hamt.c Trace/trace.c ../../ADTs/General/general.c $(SHARED) -o replayhamt -I./Hamt $(PRODUCTION) $(LDLIBS)
+
+threadhamt : assoc.h Hamt/specific.h Hamt/hamt.c threadassoc.c Locked/locked.h Locked/locked.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+	$(CC) threadassoc.c Hamt/hamt.c Locked/locked.c ../../ADTs/General/general.c $(SHARED) -o threadhamt -I./Hamt $(PRODUCTION) -pthread $(LDLIBS) -lm
+
+LIBSRC = Lib/specific.h Lib/rename.h Lib/libassoc.c assoc.h Realloc/specific.h Realloc/realloc.c Cuckoo/specific.h Cuckoo/cuckoo.c Hopscotch/specific.h Hopscotch/hopscotch.c Hamt/specific.h Hamt/hamt.c ../../ADTs/General/general.h ../../ADTs/General/general.c $(SHARED) $(SHAREDH)
+SHAREDO = $(notdir $(SHARED:.c=.o)) general.o
+
+libassoc.a : $(LIBSRC)
+	$(CC) -c Realloc/realloc.c -o lib_realloc.o -I./Realloc -DASSOC_PREFIX=realloc_ $(PRODUCTION)
+	$(CC) -c Cuckoo/cuckoo.c -o lib_cuckoo.o -I./Cuckoo -DASSOC_PREFIX=cuckoo_ $(PRODUCTION)
+	$(CC) -c Hopscotch/hopscotch.c -o lib_hopscotch.o -I./Hopscotch -DASSOC_PREFIX=hopscotch_ $(PRODUCTION)
+	$(CC) -c Hamt/hamt.c -o lib_hamt.o -I./Hamt -DASSOC_PREFIX=hamt_ $(PRODUCTION)
+	$(CC) -c Lib/libassoc.c -o lib_front.o -I./Lib $(PRODUCTION)
+	$(CC) -c $(SHARED) ../../ADTs/General/general.c $(PRODUCTION)
+	ar rcs libassoc.a lib_realloc.o lib_cuckoo.o lib_hopscotch.o lib_hamt.o lib_front.o $(SHAREDO)
+
+testlib : testassoc.c libassoc.a
+	$(CC) testassoc.c libassoc.a -o testlib -I./Lib $(PRODUCTION) $(LDLIBS)
+
+testlib_s : testassoc.c $(LIBSRC)
+	$(CC) -c Realloc/realloc.c -o lib_realloc_s.o -I./Realloc -DASSOC_PREFIX=realloc_ $(SANITIZE)
+	$(CC) -c Cuckoo/cuckoo.c -o lib_cuckoo_s.o -I./Cuckoo -DASSOC_PREFIX=cuckoo_ $(SANITIZE)
+	$(CC) -c Hopscotch/hopscotch.c -o lib_hopscotch_s.o -I./Hopscotch -DASSOC_PREFIX=hopscotch_ $(SANITIZE)
+	$(CC) -c Hamt/hamt.c -o lib_hamt_s.o -I./Hamt -DASSOC_PREFIX=hamt_ $(SANITIZE)
+	$(CC) testassoc.c Lib/libassoc.c lib_realloc_s.o lib_cuckoo_s.o lib_hopscotch_s.o lib_hamt_s.o ../../ADTs/General/general.c $(SHARED) -o testlib_s -I./Lib $(SANITIZE) $(LDLIBS)
 
 clean:
-	rm -f testrealloc_s testrealloc_v testrealloc testcuckoo_s testcuckoo_v testcuckoo
+	rm -f testhamt_s testhamt_v testhamt testhamt32_s benchhamt replayhamt threadhamt lib_hamt.o lib_hamt_s.o testhopscotch_s testhopscotch_v testhopscotch testhopscotch32_s benchhopscotch replayhopscotch threadhopscotch testrealloc_s testrealloc_v testrealloc testcuckoo_s testcuckoo_v testcuckoo testrealloc32_s testcuckoo32_s benchrealloc benchcuckoo replayrealloc replaycuckoo words.trc threadrealloc threadcuckoo libassoc.a testlib testlib_s lib_realloc.o lib_cuckoo.o lib_front.o lib_realloc_s.o lib_cuckoo_s.o lib_hopscotch.o lib_hopscotch_s.o $(SHAREDO)
 
-basic: testrealloc_s testrealloc_v
+basic: testrealloc_s testrealloc_v testrealloc32_s
 	./testrealloc_s
+	./testrealloc32_s
 	valgrind ./testrealloc_v
 
-cuckoo: testcuckoo_s testcuckoo_v
+cuckoo: testcuckoo_s testcuckoo_v testcuckoo32_s
 	./testcuckoo_s
+	./testcuckoo32_s
 	valgrind ./testcuckoo_v
+
+hopscotch: testhopscotch_s testhopscotch_v testhopscotch32_s
+	./testhopscotch_s
+	./testhopscotch32_s
+	valgrind ./testhopscotch_v
+
+hamt: testhamt_s testhamt_v testhamt32_s
+	./testhamt_s
+	./testhamt32_s
+	valgrind ./testhamt_v
+
+bench: benchrealloc benchcuckoo benchhopscotch benchhamt
+	./benchrealloc -p
+	./benchcuckoo -p
+	./benchhopscotch -p
+	./benchhamt -p
+
+replay: replayrealloc replaycuckoo replayhopscotch replayhamt
+	./replayrealloc -record words.trc
+	./replayrealloc words.trc
+	./replaycuckoo words.trc
+	./replayhopscotch words.trc
+	./replayhamt words.trc
+
+threads: threadrealloc threadcuckoo threadhopscotch threadhamt
+	./threadrealloc
+	./threadcuckoo
+	./threadhopscotch
+	./threadhamt
+
+lib: testlib_s testlib
+	./testlib_s
+	ASSOC_BACKEND=cuckoo ./testlib_s
+	ASSOC_BACKEND=hopscotch ./testlib_s
+	ASSOC_BACKEND=hamt ./testlib_s
+	./testlib
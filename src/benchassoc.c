@@ -0,0 +1,115 @@
+#include "specific.h"
+#include "assoc.h"
+#include "Perf/perf.h"
+
+/*
+   Times the table phase by phase - inserting, looking up keys
+   that are there, looking up keys that aren't, and growing -
+   and with "-p" also reads the hardware counters around each
+   phase, reporting everything per operation:
+      ./benchrealloc -p
+   Without permission for perf_event_open (see
+   /proc/sys/kernel/perf_event_paranoid) only times are shown.
+*/
+
+#define WORDS 370119
+#define WORDLEN 50
+#define ROUNDS 5
+
+int main(int argc, char* argv[])
+{
+
+   static char strs[WORDS][WORDLEN];
+   static char miss[WORDS][WORDLEN];
+   static int i[WORDS];
+   FILE *fp;
+   assoc* a;
+   perf p;
+   unsigned int j, r, resizes;
+   unsigned long found;
+
+   perf_init(&p, argc > 1 && strcmp(argv[1], "-p") == 0);
+   if(argc > 1 && !perf_available(&p)){
+      fprintf(stderr, "Hardware counters unavailable, timing only\n");
+   }
+
+   fp = nfopen("../../Data/Words/eng_370k_shuffle.txt", "rt");
+   for(j=0; j<WORDS; j++){
+      i[j] = j;
+      if(fscanf(fp, "%49s", strs[j])!=1){
+         on_error("Failed to scan in a word?");
+      }
+      /* The list is lower case, so this is never a word */
+      strcpy(miss[j], strs[j]);
+      miss[j][0] = 'A' + miss[j][0] % 26;
+   }
+   fclose(fp);
+   perf_header(&p);
+
+   /* Insert, growing from empty */
+   a = assoc_init(0);
+   perf_start(&p);
+   for(j=0; j<WORDS; j++){
+      assoc_insert(&a, strs[j], &i[j]);
+   }
+   perf_stop(&p);
+   perf_report(&p, "insert", WORDS);
+
+   /* Successful lookups */
+   perf_reset(&p);
+   found = 0;
+   perf_start(&p);
+   for(r=0; r<ROUNDS; r++){
+      for(j=0; j<WORDS; j++){
+         found += assoc_lookup(a, strs[j]) != NULL;
+      }
+   }
+   perf_stop(&p);
+   perf_report(&p, "hit", (unsigned long) WORDS * ROUNDS);
+   assert(found == (unsigned long) WORDS * ROUNDS);
+
+   /* Unsuccessful lookups */
+   perf_reset(&p);
+   found = 0;
+   perf_start(&p);
+   for(r=0; r<ROUNDS; r++){
+      for(j=0; j<WORDS; j++){
+         found += assoc_lookup(a, miss[j]) != NULL;
+      }
+   }
+   perf_stop(&p);
+   perf_report(&p, "miss", (unsigned long) WORDS * ROUNDS);
+   assert(found == 0);
+   assoc_free(a);
+
+   /*
+      Growth on its own: fill each table up to its capacity
+      untimed, then time the one insertion that resizes it
+   */
+   perf_reset(&p);
+   resizes = 0;
+   a = assoc_init(0);
+   j = 0;
+   while(j<WORDS){
+      while(j<WORDS && assoc_count(a) < assoc_capacity(a)){
+         assoc_insert(&a, strs[j], &i[j]);
+         j++;
+      }
+      if(j<WORDS){
+         perf_start(&p);
+         assoc_insert(&a, strs[j], &i[j]);
+         perf_stop(&p);
+         resizes++;
+         j++;
+      }
+   }
+   /* A table that never resizes has no line to report */
+   if(resizes > 0){
+      perf_report(&p, "resize", resizes);
+   }
+   assert(assoc_count(a) == WORDS);
+   assoc_free(a);
+
+   perf_close(&p);
+   return 0;
+}
@@ -0,0 +1,151 @@
+#include "specific.h"
+#include "assoc.h"
+#include "Trace/trace.h"
+
+/*
+   Replays a captured trace against whichever backend this
+   is built with, reporting throughput and latency percentiles:
+      ./replayrealloc words.trc
+   A sample trace (insert the dictionary, then look up every
+   word reversed) can be recorded through the shim with:
+      ./replayrealloc -record words.trc
+*/
+
+#define WORDS 370119
+#define WORDLEN 50
+#define NANO 1e9
+#define PERCENT 100.0
+
+char* strduprev(char* str);
+void record(const char* path);
+void replay(const char* path);
+int ulong_compare(const void* a, const void* b);
+unsigned long percentile(unsigned long* sorted, size_t n, double p);
+
+int main(int argc, char* argv[])
+{
+
+   if(argc == 3 && strcmp(argv[1], "-record") == 0){
+      record(argv[2]);
+   }
+   else if(argc == 2){
+      replay(argv[1]);
+   }
+   else{
+      fprintf(stderr, "Usage : %s [-record] <trace file>\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   return 0;
+}
+
+void record(const char* path)
+{
+   static char strs[WORDS][WORDLEN];
+   static int i[WORDS];
+   FILE *fp;
+   tracer* t;
+   assoc* a;
+   char* rev;
+   unsigned int j;
+
+   fp = nfopen("../../Data/Words/eng_370k_shuffle.txt", "rt");
+   for(j=0; j<WORDS; j++){
+      i[j] = j;
+      if(fscanf(fp, "%49s", strs[j])!=1){
+         on_error("Failed to scan in a word?");
+      }
+   }
+   fclose(fp);
+
+   fp = nfopen((char*) path, "wb");
+   a = assoc_init(0);
+   t = trace_begin(fp, 0);
+   for(j=0; j<WORDS; j++){
+      trace_insert(t, &a, strs[j], &i[j]);
+   }
+   for(j=0; j<WORDS; j++){
+      rev = strduprev(strs[j]);
+      trace_lookup(t, a, rev);
+      free(rev);
+   }
+   printf("Recorded %lu operations to %s\n", t->records, path);
+   trace_end(t);
+   fclose(fp);
+   assoc_free(a);
+}
+
+void replay(const char* path)
+{
+   FILE *fp;
+   trace_log* l;
+   assoc* a;
+   unsigned long* lat;
+   unsigned long start, total, t0;
+   size_t n, hits, lookups;
+
+   fp = nfopen((char*) path, "rb");
+   l = trace_read(fp);
+   fclose(fp);
+   if(l->count == 0){
+      on_error("Empty trace?");
+   }
+   lat = (unsigned long*) ncalloc(l->count, sizeof(unsigned long));
+
+   a = assoc_init(l->keysize);
+   hits = lookups = 0;
+   start = trace_clock();
+   for(n=0; n<l->count; n++){
+      t0 = trace_clock();
+      if(l->ops[n].kind == TRACE_INSERT){
+         /* Any non-NULL data will do */
+         assoc_insert(&a, trace_key(l, n), &l->ops[n]);
+      }
+      else{
+         hits += assoc_lookup(a, trace_key(l, n)) != NULL;
+         lookups++;
+      }
+      lat[n] = trace_clock() - t0;
+   }
+   total = trace_clock() - start;
+
+   qsort(lat, l->count, sizeof(unsigned long), ulong_compare);
+   printf("%lu operations (%lu lookups, %lu hits), %lu keys\n",
+          (unsigned long) l->count, (unsigned long) lookups,
+          (unsigned long) hits, (unsigned long) assoc_count(a));
+   printf("Throughput %.0f ops/sec\n", l->count * NANO / total);
+   printf("Latency ns : p50 %lu  p90 %lu  p99 %lu  p99.9 %lu  max %lu\n",
+          percentile(lat, l->count, 50.0),
+          percentile(lat, l->count, 90.0),
+          percentile(lat, l->count, 99.0),
+          percentile(lat, l->count, 99.9),
+          lat[l->count - 1]);
+
+   free(lat);
+   assoc_free(a);
+   trace_log_free(l);
+}
+
+unsigned long percentile(unsigned long* sorted, size_t n, double p)
+{
+   return sorted[(size_t) ((n - 1) * p / PERCENT)];
+}
+
+int ulong_compare(const void* a, const void* b)
+{
+   unsigned long x = *(const unsigned long*) a;
+   unsigned long y = *(const unsigned long*) b;
+   return (x > y) - (x < y);
+}
+
+char* strduprev(char* str)
+{
+   char* t;
+   int i, n;
+
+   n = strlen(str);
+   t = (char*) ncalloc(n + 1, 1);
+   for(i=0; i<n; i++){
+      t[i] = str[n - i - 1];
+   }
+   return t;
+}
@@ -4,6 +4,17 @@
 #define ARRSIZE 15
 #define WORDS 370119
 #define NUMRANGE 100000
+#define FILTERBITS 8
+#define ARENACHUNK (1 << 20)
+#define SHMNAME "/testassoc"
+#define CACHESIZE 1000
+#define TTLMS 2
+#define WALNAME "testassoc.wal"
+#define WALGROUP 64
+#define LINEARNAME "testassoc.lin"
+#define LINEARMAP "testassoc.map"
+#define TOPCANDIDATES 100
+#define TOPK 10
 
 char* strduprev(char* str);
 
@@ -17,7 +28,24 @@ int main(void)
    unsigned int lngst;
    unsigned int j;
    assoc* a;
+   assoc* shared;
+   assoc *b, *both, *either, *only;
+   arena* ar;
+   assoc_allocator al;
    static int i[WORDS];
+   static int freq[WORDS];
+   static char seen[NUMRANGE];
+   char word[50], common[50];
+   int **count;
+   unsigned int distinct, words;
+   int n;
+#ifndef ASSOC_NOCACHE
+   unsigned long start;
+#endif
+#ifndef ASSOC_NOTOPK
+   void* top[TOPK];
+   unsigned long topcount[TOPK];
+#endif
 
    a = assoc_init(0);
    fp = nfopen("../../Data/Words/eng_370k_shuffle.txt", "rt");
@@ -53,19 +81,373 @@ int main(void)
    }
    assoc_free(a);
 
+   /* strs[] outlives the table, so there's no need for copies */
+   a = assoc_init(0);
+   assoc_borrow_keys(a);
+   /* Most reversed words aren't words, so filter the misses */
+   assoc_filter(a, FILTERBITS);
+   for(j=0; j<WORDS; j++){
+      assoc_insert(&a, strs[j], &i[j]);
+   }
+   assert(assoc_count(a)==WORDS);
+   for(j=0; j<WORDS; j++){
+      assert(assoc_lookup(a, strs[j])==&i[j]);
+      tstr = strduprev(strs[j]);
+      p = assoc_lookup(a, tstr);
+      assert(p==NULL || strcmp(strs[*(int*)p], tstr)==0);
+      free(tstr);
+   }
+   printf("Filter false-positive rate %.4f\n", assoc_filter_fpr(a));
+   assoc_free(a);
+
+   /* Frozen, the dictionary answers the same as it did live */
+   a = assoc_init(0);
+   for(j=0; j<WORDS; j++){
+      assoc_insert(&a, strs[j], &i[j]);
+   }
+   assoc_freeze(a);
+   assert(assoc_count(a)==WORDS);
+   for(j=0; j<WORDS; j++){
+      assert(*(int*)assoc_lookup(a, strs[j])==(int)j);
+   }
+   printf("Frozen at %.2f bits per key\n", assoc_frozen_bits(a));
+   assoc_free(a);
+
+#ifndef ASSOC_NOCACHE
+   /* A cache stays the same size, keeping the word in use */
+   a = assoc_cache_init(0, CACHESIZE);
+   for(j=0; j<WORDS; j++){
+      assoc_insert(&a, strs[j], &i[j]);
+      assert(assoc_count(a)<=CACHESIZE);
+      assert(*(int*)assoc_lookup(a, strs[0])==0);
+   }
+   assert(assoc_count(a)==CACHESIZE);
+   assert(assoc_lookup(a, strs[1])==NULL);
+   /* Expiry only happens to pairs inserted with a ttl */
+   assoc_cache_ttl(a, TTLMS);
+   assoc_insert(&a, strs[1], &i[1]);
+   start = cache_now();
+   while(cache_now() <= start + TTLMS){
+   }
+   assert(assoc_lookup(a, strs[1])==NULL);
+   assert(assoc_lookup(a, strs[0])!=NULL);
+   assert(assoc_count(a)==CACHESIZE-1);
+   assoc_free(a);
+#endif
+
    /*
       Lets choose NUMRANGE numbers at random between 0 - (NUMRANGE-1)
       and hash them.  Then assoc_count() tells us how many are unique
    */
    srand(time(NULL));
-   a = assoc_init(sizeof(int));
+   /* Throwaway table, so keep it out of the heap */
+   ar = arena_init(ARENACHUNK);
+   al = arena_allocator(ar);
+   /* Only membership matters, so a set: no data at all */
+   a = assoc_set_init_ex(sizeof(int), &al);
+   distinct = 0;
    for(j=0; j<NUMRANGE; j++){
       i[j] = rand()%NUMRANGE;
+      if(!seen[i[j]]){
+         seen[i[j]] = 1;
+         distinct++;
+      }
+      assoc_insert(&a, &i[j], NULL);
+   }
+   assert(assoc_count(a)==distinct);
+   printf("%lu unique numbers out of %d\n", (unsigned long) assoc_count(a), j);
+   for(j=0; j<NUMRANGE; j++){
+      n = j;
+      assert((assoc_lookup(a, &n) != NULL) == seen[j]);
+   }
+
+   assoc_free(a);
+   arena_free(ar);
+
+   /* NULL is ordinary data in a map, not an empty slot */
+   a = assoc_init(sizeof(int));
+   for(j=0; j<NUMRANGE; j++){
       assoc_insert(&a, &i[j], NULL);
    }
-   printf("%d unique numbers out of %d\n", assoc_count(a), j);
+   assert(assoc_count(a)==distinct);
+   assoc_free(a);
+
+   /* A reader's snapshot stays as it was while the table changes */
+   a = assoc_init(sizeof(int));
+   for(j=0; j<NUMRANGE; j++){
+      n = j;
+      assoc_insert(&a, &n, &i[j]);
+   }
+   b = assoc_snapshot(a);
+   for(n=0; n<NUMRANGE; n+=2){
+      assert(assoc_remove(a, &n)==1);
+   }
+   for(n=1; n<NUMRANGE; n+=2){
+      assoc_insert(&a, &n, &freq[n]);
+   }
+   assoc_insert(&a, &n, &i[0]);
+   assert(assoc_count(a)==NUMRANGE/2+1);
+   assert(assoc_count(b)==NUMRANGE);
+   assert(assoc_lookup(b, &n)==NULL);
+   for(n=0; n<NUMRANGE; n++){
+      assert(assoc_lookup(b, &n)==&i[n]);
+      assert(assoc_lookup(a, &n)==(n%2 ? (void*) &freq[n] : NULL));
+   }
+   assoc_free(b);
+   assoc_free(a);
+   /* Either one can go first */
+   a = assoc_init(0);
+   for(j=0; j<ARRSIZE; j++){
+      assoc_insert(&a, strs[j], &i[j]);
+   }
+   b = assoc_snapshot(a);
+   assoc_insert(&a, strs[0], &i[1]);
+   assert(assoc_remove(a, strs[1])==1);
+   assoc_free(a);
+   assert(assoc_lookup(b, strs[0])==&i[0]);
+   assert(assoc_lookup(b, strs[1])==&i[1]);
+   assoc_free(b);
+
+   /* Lots of tiny tables, only the bigger ones outgrow small */
+   for(j=1; j<=ARRSIZE; j++){
+      a = assoc_init(sizeof(int));
+      for(n=0; n<(int) j; n++){
+         assoc_insert(&a, &n, &i[n]);
+      }
+      assert(assoc_count(a)==j);
+      for(n=0; n<(int) j; n++){
+         assert(assoc_lookup(a, &n)==&i[n]);
+      }
+      assert(assoc_lookup(a, &n)==NULL);
+      /* Taking the first out leaves the rest to be found */
+      n = 0;
+      assert(assoc_remove(a, &n)==1);
+      assert(assoc_remove(a, &n)==0);
+      assert(assoc_count(a)==j-1);
+      for(n=1; n<(int) j; n++){
+         assert(assoc_lookup(a, &n)==&i[n]);
+      }
+      assoc_free(a);
+   }
+
+   /* A durable table comes back after a restart */
+   remove(WALNAME);
+   remove(WALNAME ".snap");
+   a = assoc_init(sizeof(int));
+   assert(assoc_log(&a, WALNAME, sizeof(int), WALGROUP)==0);
+   for(j=0; j<NUMRANGE; j++){
+      n = j;
+      assoc_insert(&a, &n, &i[j]);
+      /* Half of it is in the snapshot, half replayed */
+      if(j==NUMRANGE/2){
+         assoc_checkpoint(a);
+      }
+   }
+   for(n=1; n<NUMRANGE; n+=2){
+      assert(assoc_remove(a, &n)==1);
+   }
+   assoc_free(a);
+   a = assoc_init(sizeof(int));
+   assert(assoc_log(&a, WALNAME, sizeof(int), WALGROUP)==NUMRANGE/2);
+   for(n=0; n<NUMRANGE; n++){
+      p = assoc_lookup(a, &n);
+      assert(n%2 ? p==NULL : *(int*)p==i[n]);
+   }
+   assoc_free(a);
+   /* A crash part way through a record loses just that record */
+   fp = nfopen(WALNAME, "ab");
+   fputs("torn", fp);
+   fclose(fp);
+   a = assoc_init(sizeof(int));
+   assert(assoc_log(&a, WALNAME, sizeof(int), WALGROUP)==NUMRANGE/2);
+   n = 1;
+   assoc_insert(&a, &n, &i[1]);
+   assoc_free(a);
+   a = assoc_init(sizeof(int));
+   assert(assoc_log(&a, WALNAME, sizeof(int), WALGROUP)==NUMRANGE/2+1);
+   assert(*(int*)assoc_lookup(a, &n)==i[1]);
+   assoc_free(a);
+   remove(WALNAME);
+   remove(WALNAME ".snap");
+
+#ifndef ASSOC_NOFILE
+   /* Kept in a file, as if there were too many for memory */
+   remove(LINEARNAME);
+   remove(LINEARNAME ".ovf");
+   a = assoc_file_init(LINEARNAME, 0, 0);
+   for(j=0; j<WORDS; j++){
+      assoc_insert(&a, strs[j], NULL);
+   }
+   assert(assoc_count(a)==WORDS);
+   assoc_free(a);
+   a = assoc_file_init(LINEARNAME, 0, 0);
+   assert(assoc_count(a)==WORDS);
+   for(j=0; j<WORDS; j++){
+      assert(assoc_lookup(a, strs[j])==strs[j]);
+   }
+   assert(assoc_lookup(a, "ZZZZZZ")==NULL);
+   assert(assoc_remove(a, strs[0])==1);
+   assert(assoc_lookup(a, strs[0])==NULL);
+   assert(assoc_count(a)==WORDS-1);
+   assoc_free(a);
+   remove(LINEARNAME);
+   remove(LINEARNAME ".ovf");
+   /* Data is copied into the file, not pointed at */
+   remove(LINEARMAP);
+   remove(LINEARMAP ".ovf");
+   a = assoc_file_init(LINEARMAP, sizeof(int), sizeof(int));
+   for(j=0; j<NUMRANGE; j++){
+      n = j;
+      assoc_insert(&a, &n, &i[j]);
+   }
+   assoc_free(a);
+   a = assoc_file_init(LINEARMAP, sizeof(int), sizeof(int));
+   assert(assoc_count(a)==NUMRANGE);
+   for(n=0; n<NUMRANGE; n++){
+      assert(*(int*)assoc_lookup(a, &n)==i[n]);
+   }
+   assoc_free(a);
+   remove(LINEARMAP);
+   remove(LINEARMAP ".ovf");
+#endif
+
+   /*
+      Word frequencies : one probe per word, the first time
+      a word is seen it's given the next free counter
+   */
+   a = assoc_init(0);
+   fp = nfopen("../../Data/Words/p-and-p-words.txt", "rt");
+   distinct = 0;
+   lngst = 0;
+   words = 0;
+   while(fscanf(fp, "%49s", word)==1){
+      words++;
+      count = (int**) assoc_get_or_insert(&a, word, &freq[distinct]);
+      if(*count == &freq[distinct]){
+         distinct++;
+      }
+      **count += 1;
+      if((unsigned int) **count > lngst){
+         lngst = **count;
+         strcpy(common, word);
+      }
+   }
+   assert(assoc_count(a)==distinct);
+   printf("%d different words, \"%s\" appears %d times\n", distinct, common, lngst);
+
+#ifndef ASSOC_NOTOPK
+   /* Most frequent words again, in a fixed number of counters */
+   b = assoc_topk_init(0, TOPCANDIDATES);
+   assert(assoc_load_words(&b, "../../Data/Words/p-and-p-words.txt")==words);
+   assert(assoc_count(b)==TOPCANDIDATES);
+   assert(assoc_capacity(b)==TOPCANDIDATES);
+   assert(assoc_topk(b, top, topcount, TOPK)==TOPK);
+   assert(strcmp((char*) top[0], common)==0);
+   for(j=0; j<TOPK; j++){
+      /* Never an underestimate, and highest first */
+      assert(topcount[j] >= (unsigned long) *(int*)assoc_lookup(a, top[j]));
+      assert(j==0 || topcount[j] <= topcount[j-1]);
+      assert(assoc_lookup(b, top[j])==top[j]);
+   }
+   assert(assoc_lookup(b, "zzzzzz")==NULL);
+   printf("Top %d words kept in %d counters, \"%s\" counted %lu times\n", TOPK, TOPCANDIDATES, (char*) top[0], topcount[0]);
+   assoc_free(b);
+#endif
+
+   /* Worker processes would attach to one copy of the counts */
+   assoc_publish(a, SHMNAME, sizeof(int));
+   shared = assoc_attach(SHMNAME);
+   assert(assoc_count(shared)==distinct);
+   assert(*(int*)assoc_lookup(shared, common)==(int)lngst);
+   assert(assoc_lookup(shared, "zzzzzz")==NULL);
+   assoc_filter(shared, FILTERBITS);
+   assert(assoc_refresh(shared)==0);
+   /* Readers only see a change once it's republished */
+   *(int*)assoc_lookup(a, common) += 1;
+   assoc_publish(a, SHMNAME, sizeof(int));
+   assert(*(int*)assoc_lookup(shared, common)==(int)lngst);
+   assert(assoc_refresh(shared)==1);
+   assert(*(int*)assoc_lookup(shared, common)==(int)lngst+1);
+   assoc_free(shared);
+   assoc_unpublish(SHMNAME);
+
+   /* Done counting, squeeze the vocabulary */
+   assoc_compact(a);
+   assoc_filter(a, FILTERBITS);
+   rewind(fp);
+   while(fscanf(fp, "%49s", word)==1){
+      assert(assoc_lookup(a, word)!=NULL);
+   }
+   fclose(fp);
+   assert(assoc_lookup(a, "zzzzzz")==NULL);
+   printf("Compacted at %.1f bytes per key\n", assoc_compact_bytes(a));
+   assoc_free(a);
+
+   /* The same text again, keys pointing into a mapping of the file */
+   a = assoc_set_init(0);
+   assoc_borrow_keys(a);
+   j = assoc_load_words(&a, "../../Data/Words/p-and-p-words.txt");
+   assert(j==words);
+   assert(assoc_count(a)==distinct);
+   assert(assoc_lookup(a, common)!=NULL);
+   printf("Loaded %d words from a mapping\n", j);
+   assoc_free(a);
+
+   /* Comparing two vocabularies */
+   a = assoc_set_init(0);
+   assoc_load_words(&a, "../../Data/Words/p-and-p-words-uniq.txt");
+   b = assoc_set_init(0);
+   assoc_load_words(&b, "../../Data/Words/s-and-s-words-uniq.txt");
+   both = assoc_intersect(a, b);
+   either = assoc_union(a, b);
+   only = assoc_difference(a, b);
+   assert(assoc_count(both)+assoc_count(either)==
+          assoc_count(a)+assoc_count(b));
+   assert(assoc_count(only)+assoc_count(both)==assoc_count(a));
+   fp = nfopen("../../Data/Words/p-and-p-words-uniq.txt", "rt");
+   while(fscanf(fp, "%49s", word)==1){
+      assert((assoc_lookup(both, word)!=NULL)==
+             (assoc_lookup(b, word)!=NULL));
+      assert((assoc_lookup(only, word)!=NULL)==
+             (assoc_lookup(b, word)==NULL));
+      assert(assoc_lookup(either, word)!=NULL);
+   }
+   fclose(fp);
+   printf("%lu words in both novels, %lu in either, %lu only in the first\n",
+          (unsigned long) assoc_count(both),
+          (unsigned long) assoc_count(either),
+          (unsigned long) assoc_count(only));
+   assoc_free(only);
+   assoc_free(either);
+   assoc_free(both);
+   assoc_free(b);
+   assoc_free(a);
 
+#ifdef ASSOC_KINDS
+   /* Built as libassoc: every backend side by side */
+   a = assoc_set_init_kind(0, ASSOC_REALLOC, NULL);
+   b = assoc_set_init_kind(0, ASSOC_CUCKOO, NULL);
+   both = assoc_set_init_kind(0, ASSOC_HOPSCOTCH, NULL);
+   either = assoc_set_init_kind(0, ASSOC_HAMT, NULL);
+   assoc_load_words(&a, "../../Data/Words/s-and-s-words-uniq.txt");
+   assoc_load_words(&b, "../../Data/Words/s-and-s-words-uniq.txt");
+   assoc_load_words(&both, "../../Data/Words/s-and-s-words-uniq.txt");
+   assoc_load_words(&either, "../../Data/Words/s-and-s-words-uniq.txt");
+   assert(assoc_backend(a)==ASSOC_REALLOC);
+   assert(assoc_backend(b)==ASSOC_CUCKOO);
+   assert(assoc_backend(both)==ASSOC_HOPSCOTCH);
+   assert(assoc_backend(either)==ASSOC_HAMT);
+   assert(assoc_count(a)==assoc_count(b));
+   assert(assoc_count(a)==assoc_count(both));
+   assert(assoc_count(a)==assoc_count(either));
+   assert(assoc_lookup(b, "willoughby")!=NULL);
+   assert(assoc_lookup(both, "willoughby")!=NULL);
+   assert(assoc_lookup(either, "willoughby")!=NULL);
+   assoc_free(either);
+   assoc_free(both);
+   assoc_free(b);
    assoc_free(a);
+#endif
 
    return 0;
 }
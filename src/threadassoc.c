@@ -0,0 +1,272 @@
+/* pthread_barrier_t, pthread_rwlock_t and sysconf() */
+#define _POSIX_C_SOURCE 200112L
+
+#include "specific.h"
+#include "assoc.h"
+#include "Locked/locked.h"
+
+#include <math.h>
+#include <unistd.h>
+
+/*
+   Scalability of the thread-safe variants: sweeps 1..N
+   threads (N = online CPUs, or the first argument) over
+   several read/write mixes and two key distributions,
+   reporting aggregate throughput, fairness between threads
+   (Jain's index, 1.0 => all threads got the same rate) and
+   p99 latency. The table holds the whole dictionary, so
+   writes replace the data of an existing key.
+*/
+
+#define WORDS 370119
+#define WORDLEN 50
+/* Operations per thread per run */
+#define OPS 100000
+#define MAXTHREADS 64
+/* Zipf exponent, as in YCSB */
+#define ZIPFS 0.99
+#define NANO 1e9
+#define PERCENT 100
+#define P99 99.0
+#define XORSEED 0x9E3779B97F4A7C15UL
+#define XORA 13
+#define XORB 7
+#define XORC 17
+/* Top 53 bits of a random word make a double in [0, 1) */
+#define DOUBLEBITS 11
+#define DOUBLESCALE (1.0 / 9007199254740992.0)
+
+typedef struct mix {
+   const char* name;
+   int writepct;
+} mix;
+
+typedef struct variant {
+   const char* name;
+   int shared;
+} variant;
+
+typedef struct worker {
+   pthread_t thread;
+   pthread_barrier_t* start;
+   locked* table;
+   unsigned int* keys;
+   unsigned char* writes;
+   unsigned long* lat;
+   unsigned long hits;
+   double seconds;
+} worker;
+
+static char strs[WORDS][WORDLEN];
+static int data[WORDS];
+static double cdf[WORDS];
+
+void* work(void* arg);
+void run(locked* table, const mix* m, int zipf, int threads);
+void make_ops(worker* w, int seed, int writepct, int zipf);
+unsigned int zipf_key(double u);
+unsigned long next_random(unsigned long* state);
+double now(void);
+int ulong_compare(const void* a, const void* b);
+
+int main(int argc, char* argv[])
+{
+
+   static const mix mixes[] = {
+      {"read-only", 0}, {"95/5", 5}, {"50/50", 50}, {"write-heavy", 90}
+   };
+   static const variant variants[] = {
+      {"mutex", 0}, {"rwlock", 1}
+   };
+   FILE *fp;
+   assoc* a;
+   locked* table;
+   double sum;
+   int maxthreads, threads, v, m, zipf;
+   unsigned int j;
+
+   maxthreads = argc > 1 ? atoi(argv[1]) :
+                (int) sysconf(_SC_NPROCESSORS_ONLN);
+   if(maxthreads < 1 || maxthreads > MAXTHREADS){
+      on_error("Thread count out of range");
+   }
+
+   fp = nfopen("../../Data/Words/eng_370k_shuffle.txt", "rt");
+   for(j=0; j<WORDS; j++){
+      data[j] = j;
+      if(fscanf(fp, "%49s", strs[j])!=1){
+         on_error("Failed to scan in a word?");
+      }
+   }
+   fclose(fp);
+
+   /* The list is shuffled, so rank k is just word k */
+   sum = 0.0;
+   for(j=0; j<WORDS; j++){
+      sum += 1.0 / pow(j + 1.0, ZIPFS);
+      cdf[j] = sum;
+   }
+   for(j=0; j<WORDS; j++){
+      cdf[j] /= sum;
+   }
+
+   printf("%-7s %-12s %-8s %7s %12s %9s %9s\n", "variant", "mix",
+          "keys", "threads", "ops/sec", "fairness", "p99 ns");
+   for(v=0; v<(int)(sizeof(variants)/sizeof(variants[0])); v++){
+      a = assoc_init(0);
+      for(j=0; j<WORDS; j++){
+         assoc_insert(&a, strs[j], &data[j]);
+      }
+      table = locked_init(a, variants[v].shared);
+      for(m=0; m<(int)(sizeof(mixes)/sizeof(mixes[0])); m++){
+         for(zipf=0; zipf<=1; zipf++){
+            for(threads=1; threads<maxthreads; threads*=2){
+               printf("%-7s ", variants[v].name);
+               run(table, &mixes[m], zipf, threads);
+            }
+            printf("%-7s ", variants[v].name);
+            run(table, &mixes[m], zipf, maxthreads);
+         }
+      }
+      locked_free(table);
+   }
+   return 0;
+}
+
+void run(locked* table, const mix* m, int zipf, int threads)
+{
+   static worker w[MAXTHREADS];
+   pthread_barrier_t start;
+   unsigned long *all;
+   double rate, sum, squares, longest;
+   int t;
+
+   pthread_barrier_init(&start, NULL, threads);
+   for(t=0; t<threads; t++){
+      w[t].start = &start;
+      w[t].table = table;
+      make_ops(&w[t], t + 1, m->writepct, zipf);
+   }
+   for(t=0; t<threads; t++){
+      if(pthread_create(&w[t].thread, NULL, work, &w[t]) != 0){
+         on_error("Cannot create thread");
+      }
+   }
+
+   all = (unsigned long*) ncalloc(threads * OPS, sizeof(unsigned long));
+   sum = squares = longest = 0.0;
+   for(t=0; t<threads; t++){
+      pthread_join(w[t].thread, NULL);
+      rate = OPS / w[t].seconds;
+      sum += rate;
+      squares += rate * rate;
+      if(w[t].seconds > longest){
+         longest = w[t].seconds;
+      }
+      memcpy(all + t * OPS, w[t].lat, OPS * sizeof(unsigned long));
+      free(w[t].keys);
+      free(w[t].writes);
+      free(w[t].lat);
+   }
+   pthread_barrier_destroy(&start);
+
+   qsort(all, threads * OPS, sizeof(unsigned long), ulong_compare);
+   printf("%-12s %-8s %7d %12.0f %9.3f %9lu\n", m->name,
+          zipf ? "zipf" : "uniform", threads, threads * OPS / longest,
+          sum * sum / (threads * squares),
+          all[(size_t) ((threads * OPS - 1) * P99 / PERCENT)]);
+   free(all);
+}
+
+/*
+   Keys and operations are drawn before the clock starts,
+   so only the table (and its lock) is measured
+*/
+void make_ops(worker* w, int seed, int writepct, int zipf)
+{
+   unsigned long state;
+   unsigned int n;
+
+   w->keys = (unsigned int*) ncalloc(OPS, sizeof(unsigned int));
+   w->writes = (unsigned char*) ncalloc(OPS, 1);
+   w->lat = (unsigned long*) ncalloc(OPS, sizeof(unsigned long));
+   w->hits = 0;
+   state = XORSEED * seed;
+   for(n=0; n<OPS; n++){
+      if(zipf){
+         w->keys[n] = zipf_key((next_random(&state) >> DOUBLEBITS)
+                               * DOUBLESCALE);
+      }
+      else{
+         w->keys[n] = next_random(&state) % WORDS;
+      }
+      w->writes[n] = (int) (next_random(&state) % PERCENT) < writepct;
+   }
+}
+
+void* work(void* arg)
+{
+   worker* w = (worker*) arg;
+   double start, t0, t1;
+   unsigned int n, k;
+
+   pthread_barrier_wait(w->start);
+   start = t0 = now();
+   for(n=0; n<OPS; n++){
+      k = w->keys[n];
+      if(w->writes[n]){
+         locked_insert(w->table, strs[k], &data[k]);
+      }
+      else{
+         w->hits += locked_lookup(w->table, strs[k]) != NULL;
+      }
+      t1 = now();
+      w->lat[n] = (unsigned long) ((t1 - t0) * NANO);
+      t0 = t1;
+   }
+   w->seconds = t0 - start;
+   return NULL;
+}
+
+/* First rank whose cumulative probability reaches 'u' */
+unsigned int zipf_key(double u)
+{
+   unsigned int lo, hi, mid;
+
+   lo = 0;
+   hi = WORDS - 1;
+   while(lo < hi){
+      mid = lo + (hi - lo) / 2;
+      if(cdf[mid] < u){
+         lo = mid + 1;
+      }
+      else{
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+/* xorshift64, each thread has its own state */
+unsigned long next_random(unsigned long* state)
+{
+   *state ^= *state << XORA;
+   *state ^= *state >> XORB;
+   *state ^= *state << XORC;
+   return *state;
+}
+
+double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / NANO;
+}
+
+int ulong_compare(const void* a, const void* b)
+{
+   unsigned long x = *(const unsigned long*) a;
+   unsigned long y = *(const unsigned long*) b;
+   return (x > y) - (x < y);
+}